@@ -4,9 +4,14 @@ layout (location = 1) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
+// constant for the frame, uploaded once per frame (see gl_update_per_view() in vkgl-test.cpp)
+layout (std140) uniform PerView
+{
+    mat4 view;
+    mat4 projection;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
@@ -4,6 +4,8 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "shader_binary_cache.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -14,13 +16,12 @@ class Shader
 public:
     unsigned int ID;
     // constructor generates the shader on the fly
+    // deferLink: only issue the program creation, finishLink() must be called before the shader is used
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, bool deferLink = false)
+        : name(vertexPath)
     {
         // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
         std::ifstream gShaderFile;
@@ -57,44 +58,61 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
+        hasGeometry = geometryPath != nullptr;
+        // 2. load the program binary of an earlier run, compile the shaders if there is none
+        ID = glCreateProgram();
+        binaryKey = ShaderBinaryCache::key({ &vertexCode, &fragmentCode, &geometryCode });
+        fromBinary = ShaderBinaryCache::load(ID, binaryKey);
+        if(!fromBinary)
+            compileAndLink();
+        if(!deferLink)
+            finishLink();
+    }
+    // wait for the program of the constructor, falls back to the sources if the driver rejected the cached binary
+    // ------------------------------------------------------------------------
+    void finishLink()
+    {
+        if(linked)
+            return;
+
+        GLint success = 0;
+        if(fromBinary)
         {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            glGetProgramiv(ID, GL_LINK_STATUS, &success);
+            if(!success)
+            {
+                std::cout << "WARNING: program binary of " << name << " rejected by the driver, compiling the sources" << std::endl;
+                fromBinary = false;
+                compileAndLink();
+            }
         }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
+        if(!fromBinary)
+        {
+            checkCompileErrors(vertex, "VERTEX");
+            checkCompileErrors(fragment, "FRAGMENT");
+            if(hasGeometry)
+                checkCompileErrors(geometry, "GEOMETRY");
+            checkCompileErrors(ID, "PROGRAM");
+            // delete the shaders as they're linked into our program now and no longer necessary
+            glDetachShader(ID, vertex);
+            glDetachShader(ID, fragment);
+            glDeleteShader(vertex);
+            glDeleteShader(fragment);
+            if(hasGeometry)
+            {
+                glDetachShader(ID, geometry);
+                glDeleteShader(geometry);
+            }
+            vertex = fragment = geometry = 0;
 
+            glGetProgramiv(ID, GL_LINK_STATUS, &success);
+            if(success)
+                ShaderBinaryCache::store(ID, binaryKey);
+        }
+        vertexCode.clear();
+        fragmentCode.clear();
+        geometryCode.clear();
+        linked = true;
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -162,6 +180,48 @@ public:
     }
 
 private:
+    std::string name;
+    std::string vertexCode;
+    std::string fragmentCode;
+    std::string geometryCode;
+    unsigned int vertex = 0, fragment = 0, geometry = 0;
+    bool hasGeometry = false;
+    uint64_t binaryKey = 0;
+    bool fromBinary = false;
+    bool linked = false;
+
+    // compile the shaders & link the program, the status is checked in finishLink()
+    // ------------------------------------------------------------------------
+    void compileAndLink()
+    {
+        const char* vShaderCode = vertexCode.c_str();
+        const char * fShaderCode = fragmentCode.c_str();
+        // vertex shader
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        // fragment Shader
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &fShaderCode, NULL);
+        glCompileShader(fragment);
+        // if geometry shader is given, compile geometry shader
+        if(hasGeometry)
+        {
+            const char * gShaderCode = geometryCode.c_str();
+            geometry = glCreateShader(GL_GEOMETRY_SHADER);
+            glShaderSource(geometry, 1, &gShaderCode, NULL);
+            glCompileShader(geometry);
+        }
+        // shader Program
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, fragment);
+        if(hasGeometry)
+            glAttachShader(ID, geometry);
+        if(ShaderBinaryCache::enabled())
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(ID);
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
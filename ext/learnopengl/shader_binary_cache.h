@@ -0,0 +1,141 @@
+#ifndef SHADER_BINARY_CACHE_H
+#define SHADER_BINARY_CACHE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// GL program binary cache of the Shader classes (shader_m.h, shader.h):
+// a linked program is stored as <directory>/<key>.glprog (glGetProgramBinary), the key hashes the shader sources
+// together with GL_RENDERER & GL_VERSION, so another GPU or driver never loads a foreign binary. The driver may still
+// reject a binary (glProgramBinary() leaves GL_LINK_STATUS false), the Shader then compiles the sources instead.
+class ShaderBinaryCache
+{
+public:
+    // nullptr disables the cache
+    static void setDirectory(const char* dir)
+    {
+        directory = dir ? dir : "";
+        if (!directory.empty())
+        {
+            std::error_code ec;
+            std::filesystem::create_directories(directory, ec);
+        }
+    }
+    // ------------------------------------------------------------------------
+    static bool enabled()
+    {
+        // GL_NUM_PROGRAM_BINARY_FORMATS can be 0, binaries are not supported at all then
+        GLint numFormats = 0;
+        if (!directory.empty() && glProgramBinary)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+        return numFormats > 0;
+    }
+    // ------------------------------------------------------------------------
+    static uint64_t key(const std::vector<const std::string*>& sources)
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        auto add = [&hash](const char* data, size_t size)
+        {
+            for (size_t i = 0; i < size; ++i)
+            {
+                hash ^= (unsigned char)data[i];
+                hash *= 0x100000001b3ull;
+            }
+            // separator, so that moving text between two sources changes the key
+            hash ^= 0xff;
+            hash *= 0x100000001b3ull;
+        };
+        for (const std::string* source : sources)
+            add(source->data(), source->size());
+        for (GLenum name : { GL_RENDERER, GL_VERSION })
+        {
+            const char* str = (const char*)glGetString(name);
+            add(str ? str : "", str ? std::strlen(str) : 0);
+        }
+        return hash;
+    }
+    // issues glProgramBinary() for the cached binary, false if there is none (the link status is checked by the caller)
+    // ------------------------------------------------------------------------
+    static bool load(GLuint program, uint64_t key)
+    {
+        if (!enabled())
+            return false;
+
+        std::ifstream file(path(key), std::ios::binary | std::ios::ate);
+        if (!file)
+            return false;
+
+        // the binary size comes from disk, a corrupt or truncated file must not trigger a huge allocation
+        const std::streamoff fileSize = file.tellg();
+        FileHeader header;
+        if (fileSize < (std::streamoff)sizeof(header) || !file.seekg(0) || !file.read((char*)&header, sizeof(header)) ||
+            header.magic != FILE_MAGIC || header.size == 0 || header.size > (uint64_t)(fileSize - sizeof(header)))
+            return false;
+
+        std::vector<char> binary(header.size);
+        if (!file.read(binary.data(), binary.size()))
+            return false;
+
+        glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+        return true;
+    }
+    // the program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    // ------------------------------------------------------------------------
+    static void store(GLuint program, uint64_t key)
+    {
+        if (!enabled())
+            return;
+
+        GLint size = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+        if (size <= 0)
+            return;
+
+        FileHeader header = { FILE_MAGIC, 0, 0 };
+        std::vector<char> binary(size);
+        glGetProgramBinary(program, size, &size, &header.format, binary.data());
+        header.size = (uint32_t)size;
+
+        // write to a temporary file first, so that a crash never leaves a truncated binary behind
+        const std::string filePath = path(key);
+        const std::string tmpPath = filePath + ".tmp";
+        bool ok = false;
+        {
+            std::ofstream file(tmpPath, std::ios::binary);
+            ok = file && file.write((const char*)&header, sizeof(header)) && file.write(binary.data(), size);
+        }
+        std::error_code ec;
+        if (ok)
+            std::filesystem::rename(tmpPath, filePath, ec);
+        if (!ok || ec)
+            std::filesystem::remove(tmpPath, ec);
+    }
+
+private:
+    struct FileHeader
+    {
+        uint32_t magic;
+        GLenum format;
+        uint32_t size;
+    };
+
+    static constexpr uint32_t FILE_MAGIC = 0x50474756; // "VGGP"
+
+    static inline std::string directory;
+
+    static std::string path(uint64_t key)
+    {
+        std::ostringstream name;
+        name << directory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".glprog";
+        return name.str();
+    }
+};
+#endif
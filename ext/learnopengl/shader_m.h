@@ -4,22 +4,27 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "shader_binary_cache.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 
 class Shader
 {
 public:
     unsigned int ID;
     // constructor generates the shader on the fly
+    // deferLink: only issue the program creation, finishLink() must be called before the shader is used. Drivers that
+    // compile asynchronously (GL_KHR_parallel_shader_compile or a threaded driver) do the work in the meantime.
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath)
+    Shader(const char* vertexPath, const char* fragmentPath, bool deferLink = false)
+        : name(vertexPath)
     {
         // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
         // ensure ifstream objects can throw exceptions:
@@ -45,30 +50,60 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // shader Program
+        // 2. load the program binary of an earlier run, compile the shaders if there is none
         ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+        binaryKey = ShaderBinaryCache::key({ &vertexCode, &fragmentCode });
+        fromBinary = ShaderBinaryCache::load(ID, binaryKey);
+        if (!fromBinary)
+            compileAndLink();
+        if (!deferLink)
+            finishLink();
+    }
+    // wait for the program of the constructor, falls back to the sources if the driver rejected the cached binary
+    // ------------------------------------------------------------------------
+    void finishLink()
+    {
+        if (linked)
+            return;
 
+        GLint success = 0;
+        if (fromBinary)
+        {
+            glGetProgramiv(ID, GL_LINK_STATUS, &success);
+            if (!success)
+            {
+                std::cout << "WARNING: program binary of " << name << " rejected by the driver, compiling the sources" << std::endl;
+                fromBinary = false;
+                compileAndLink();
+            }
+        }
+        if (!fromBinary)
+        {
+            checkCompileErrors(vertex, "VERTEX");
+            checkCompileErrors(fragment, "FRAGMENT");
+            checkCompileErrors(ID, "PROGRAM");
+            // delete the shaders as they're linked into our program now and no longer necessary
+            glDetachShader(ID, vertex);
+            glDetachShader(ID, fragment);
+            glDeleteShader(vertex);
+            glDeleteShader(fragment);
+            vertex = fragment = 0;
+
+            glGetProgramiv(ID, GL_LINK_STATUS, &success);
+            if (success)
+                ShaderBinaryCache::store(ID, binaryKey);
+        }
+        vertexCode.clear();
+        fragmentCode.clear();
+        linked = true;
+        // resolve the uniform locations once, the set*() functions look them up in this cache instead of the GL
+        cacheUniformLocations();
+    }
+    // true if the program came from the binary cache
+    // ------------------------------------------------------------------------
+    bool loadedFromBinary() const
+    {
+        return fromBinary;
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -76,66 +111,148 @@ public:
     { 
         glUseProgram(ID); 
     }
+    // cached location of a uniform (-1 if it is not active, e.g. optimized out or a member of a uniform block)
+    // ------------------------------------------------------------------------
+    GLint getUniformLocation(const std::string &name) const
+    {
+        const auto it = uniformLocations.find(name);
+        return it != uniformLocations.end() ? it->second : -1;
+    }
+    // assign a uniform block of the program to a GL_UNIFORM_BUFFER binding point
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const std::string &name, GLuint binding) const
+    {
+        const GLuint index = glGetUniformBlockIndex(ID, name.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(getUniformLocation(name), (int)value); 
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(getUniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(getUniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(getUniformLocation(name), 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(getUniformLocation(name), x, y); 
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(getUniformLocation(name), 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(getUniformLocation(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(getUniformLocation(name), 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) const
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(getUniformLocation(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+    }
+    // per-draw uniforms: resolve the location once with getUniformLocation(), no lookup at all
+    // ------------------------------------------------------------------------
+    void setMat4(GLint location, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    std::unordered_map<std::string, GLint> uniformLocations;
+
+    std::string name;
+    std::string vertexCode;
+    std::string fragmentCode;
+    unsigned int vertex = 0, fragment = 0;
+    uint64_t binaryKey = 0;
+    bool fromBinary = false;
+    bool linked = false;
+
+    // compile the shaders & link the program, the status is checked in finishLink()
+    // ------------------------------------------------------------------------
+    void compileAndLink()
+    {
+        const char* vShaderCode = vertexCode.c_str();
+        const char * fShaderCode = fragmentCode.c_str();
+        // vertex shader
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        // fragment Shader
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &fShaderCode, NULL);
+        glCompileShader(fragment);
+        // shader Program
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, fragment);
+        if (ShaderBinaryCache::enabled())
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(ID);
+    }
+
+    // query the locations of all active uniforms of the linked program
+    // ------------------------------------------------------------------------
+    void cacheUniformLocations()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::vector<GLchar> nameBuf(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuf.size(), &length, &size, &type, nameBuf.data());
+
+            const std::string uniformName(nameBuf.data(), length);
+            const GLint location = glGetUniformLocation(ID, uniformName.c_str());
+            // members of uniform blocks have no location
+            if (location < 0)
+                continue;
+
+            uniformLocations[uniformName] = location;
+            // arrays are reported as "name[0]", the GL accepts plain "name" as well
+            if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+                uniformLocations[uniformName.substr(0, uniformName.size() - 3)] = location;
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -32,6 +32,24 @@
 #include "sized-internalformats.h"
 #include "interop.h"
 
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+/* for the error paths, a handle that GL imported belongs to GL */
+static void
+close_interop_handle(VkInteropHandle handle)
+{
+	if (handle == INVALID_HANDLE_VALUE)
+		return;
+
+#ifdef WIN32
+	CloseHandle(handle);
+#else
+	close(handle);
+#endif
+}
+
 GLuint
 gl_get_target(const struct vk_image_props *props)
 {
@@ -79,7 +97,7 @@ gl_create_mem_obj_from_vk_mem(struct vk_ctx *ctx,
 bool
 gl_gen_tex_from_mem_obj(const struct vk_image_props *props,
 			GLenum tex_storage_format,
-			GLuint mem_obj, uint32_t offset,
+			GLuint mem_obj, GLuint64 offset,
 			GLuint *tex)
 {
 	GLint filter;
@@ -152,13 +170,13 @@ bool
 gl_gen_buf_from_mem_obj(GLuint mem_obj,
 			GLenum gl_target,
 			size_t sz,
-			uint32_t offset,
+			GLuint64 offset,
 			GLuint *bo)
 {
 	glGenBuffers(1, bo);
 	glBindBuffer(gl_target, *bo);
 
-	glBufferStorageMemEXT(gl_target, sz, mem_obj, 0);
+	glBufferStorageMemEXT(gl_target, sz, mem_obj, offset);
 
 	glBindBuffer(gl_target, 0);
 
@@ -210,6 +228,80 @@ gl_create_semaphores_from_vk(const struct vk_ctx *ctx,
 	return glGetError() == GL_NO_ERROR;
 }
 
+bool
+gl_create_timeline_from_vk(const struct vk_ctx *ctx,
+			   const struct vk_timeline *vk_tl,
+			   struct gl_ext_semaphores *gl_smps)
+{
+	VkInteropHandle fd_gl_ready = INVALID_HANDLE_VALUE;
+	VkInteropHandle fd_vk_done = INVALID_HANDLE_VALUE;
+	VkSemaphoreGetInteropHandleInfo sem_fd_info;
+	const GLint type = GL_SEMAPHORE_TYPE_TIMELINE_NV;
+
+	memset(gl_smps, 0, sizeof *gl_smps);
+
+	/* the GL semaphores must be timeline semaphores before the import */
+	if (!GLAD_GL_NV_timeline_semaphore)
+		return false;
+
+	glCreateSemaphoresNV(1, &gl_smps->vk_frame_done);
+	glCreateSemaphoresNV(1, &gl_smps->gl_frame_ready);
+	glSemaphoreParameterivNV(gl_smps->vk_frame_done, GL_SEMAPHORE_TYPE_NV, &type);
+	glSemaphoreParameterivNV(gl_smps->gl_frame_ready, GL_SEMAPHORE_TYPE_NV, &type);
+
+	memset(&sem_fd_info, 0, sizeof sem_fd_info);
+	sem_fd_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_INTEROP_HANDLE_INFO;
+	sem_fd_info.semaphore = vk_tl->vk_frame_ready;
+	sem_fd_info.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_BIT;
+
+	if (vkGetSemaphoreInteropHandle(ctx->dev, &sem_fd_info, &fd_vk_done) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to get the Vulkan timeline semaphore FD\n");
+		goto fail;
+	}
+
+	sem_fd_info.semaphore = vk_tl->gl_frame_done;
+	if (vkGetSemaphoreInteropHandle(ctx->dev, &sem_fd_info, &fd_gl_ready) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to get the Vulkan timeline semaphore FD\n");
+		goto fail;
+	}
+
+	glImportSemaphore(gl_smps->vk_frame_done,
+			       GL_INTEROP_HANDLE_TYPE,
+			       fd_vk_done);
+	fd_vk_done = INVALID_HANDLE_VALUE;
+
+	glImportSemaphore(gl_smps->gl_frame_ready,
+			       GL_INTEROP_HANDLE_TYPE,
+			       fd_gl_ready);
+	fd_gl_ready = INVALID_HANDLE_VALUE;
+
+	if (!glIsSemaphoreEXT(gl_smps->vk_frame_done) ||
+	    !glIsSemaphoreEXT(gl_smps->gl_frame_ready) ||
+	    glGetError() != GL_NO_ERROR) {
+		fprintf(stderr, "Failed to import the Vulkan timeline semaphores\n");
+		goto fail;
+	}
+
+	return true;
+
+fail:
+	close_interop_handle(fd_vk_done);
+	close_interop_handle(fd_gl_ready);
+	gl_destroy_semaphores(gl_smps);
+	return false;
+}
+
+void
+gl_destroy_semaphores(struct gl_ext_semaphores *gl_smps)
+{
+	if (gl_smps->vk_frame_done)
+		glDeleteSemaphoresEXT(1, &gl_smps->vk_frame_done);
+	if (gl_smps->gl_frame_ready)
+		glDeleteSemaphoresEXT(1, &gl_smps->gl_frame_ready);
+
+	memset(gl_smps, 0, sizeof *gl_smps);
+}
+
 GLenum
 gl_get_layout_from_vk(const VkImageLayout vk_layout)
 {
@@ -242,8 +334,9 @@ gl_check_vk_compatibility(const struct vk_ctx *ctx)
 	GLubyte deviceUUID[GL_UUID_SIZE_EXT];
 	GLubyte driverUUID[GL_UUID_SIZE_EXT];
 
-	/* FIXME: we select the first device so make sure you've
-	 * exported VK_ICD_FILENAMES */
+	/* the Vulkan device is selected by these UUIDs (see
+	 * gl_get_device_uuids()), a mismatch means that no device drives
+	 * the GL context or that another one was forced */
 	glGetUnsignedBytei_vEXT(GL_DEVICE_UUID_EXT, 0, deviceUUID);
 	glGetUnsignedBytevEXT(GL_DRIVER_UUID_EXT, driverUUID);
 
@@ -264,8 +357,9 @@ vk_check_gl_compatibility(struct vk_ctx *ctx)
 	GLubyte deviceUUID[GL_UUID_SIZE_EXT];
 	GLubyte driverUUID[GL_UUID_SIZE_EXT];
 
-	/* FIXME: we select the first device so make sure you've
-	 * exported VK_ICD_FILENAMES */
+	/* the Vulkan device is selected by these UUIDs (see
+	 * gl_get_device_uuids()), a mismatch means that no device drives
+	 * the GL context or that another one was forced */
 	glGetUnsignedBytei_vEXT(GL_DEVICE_UUID_EXT, 0, deviceUUID);
 	glGetUnsignedBytevEXT(GL_DRIVER_UUID_EXT, driverUUID);
 
@@ -277,3 +371,22 @@ vk_check_gl_compatibility(struct vk_ctx *ctx)
 
 	return glGetError() == GL_NO_ERROR;
 }
+
+bool
+gl_get_device_uuids(uint8_t *deviceUUID, uint8_t *driverUUID)
+{
+	GLint num_devices = 0;
+
+	if (!glGetUnsignedBytei_vEXT || !glGetUnsignedBytevEXT)
+		return false;
+
+	/* GL_DEVICE_UUID_EXT index 0, like the compatibility checks */
+	glGetIntegerv(GL_NUM_DEVICE_UUIDS_EXT, &num_devices);
+	if (num_devices < 1)
+		return false;
+
+	glGetUnsignedBytei_vEXT(GL_DEVICE_UUID_EXT, 0, deviceUUID);
+	glGetUnsignedBytevEXT(GL_DRIVER_UUID_EXT, driverUUID);
+
+	return glGetError() == GL_NO_ERROR;
+}
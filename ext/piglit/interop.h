@@ -77,14 +77,14 @@ gl_create_mem_obj_from_vk_mem(struct vk_ctx *ctx,
 bool
 gl_gen_tex_from_mem_obj(const struct vk_image_props *props,
 			GLenum gl_format,
-			GLuint mem_obj, uint32_t offset,
+			GLuint mem_obj, GLuint64 offset,
 			GLuint *tex);
 
 bool
 gl_gen_buf_from_mem_obj(GLuint mem_obj,
 			GLenum gl_target,
 			size_t sz,
-			uint32_t offset,
+			GLuint64 offset,
 			GLuint *bo);
 
 bool
@@ -92,12 +92,29 @@ gl_create_semaphores_from_vk(const struct vk_ctx *ctx,
 			     const struct vk_semaphores *vk_smps,
 			     struct gl_ext_semaphores *gl_smps);
 
+/* requires GL_NV_timeline_semaphore, the values are set with
+ * glSemaphoreParameterui64vEXT(GL_TIMELINE_SEMAPHORE_VALUE_NV) before
+ * every glSignalSemaphoreEXT() / glWaitSemaphoreEXT() */
+bool
+gl_create_timeline_from_vk(const struct vk_ctx *ctx,
+			   const struct vk_timeline *vk_tl,
+			   struct gl_ext_semaphores *gl_smps);
+
+/* deletes the GL semaphores that exist (0 names are skipped) */
+void
+gl_destroy_semaphores(struct gl_ext_semaphores *gl_smps);
+
 GLenum
 gl_get_layout_from_vk(const VkImageLayout vk_layout);
 
 bool
 gl_check_vk_compatibility(const struct vk_ctx *ctx);
 
+/* the device & driver UUID of the current GL context (GL_EXT_memory_object),
+ * false if GL doesn't report them */
+bool
+gl_get_device_uuids(uint8_t *deviceUUID, uint8_t *driverUUID);
+
 #if __cplusplus
 } // extern "C"
 #endif
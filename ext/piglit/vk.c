@@ -32,8 +32,10 @@
 #include "piglit-util.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <malloc.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #if WIN32
@@ -147,64 +149,315 @@ create_instance(bool enable_layers)
 	return inst;
 }
 
+static bool
+has_device_extension(VkPhysicalDevice pdev, const char *name)
+{
+	VkExtensionProperties *exts;
+	uint32_t num_exts = 0;
+	uint32_t i;
+	bool found = false;
+
+	if (vkEnumerateDeviceExtensionProperties(pdev, 0, &num_exts, 0) != VK_SUCCESS)
+		return false;
+
+	exts = (VkExtensionProperties*)malloc(num_exts * sizeof *exts);
+	if (!exts)
+		return false;
+
+	if (vkEnumerateDeviceExtensionProperties(pdev, 0, &num_exts, exts) == VK_SUCCESS) {
+		for (i = 0; i < num_exts; i++) {
+			if (strcmp(exts[i].extensionName, name) == 0) {
+				found = true;
+				break;
+			}
+		}
+	}
+
+	free(exts);
+	return found;
+}
+
+static bool
+supports_timeline_semaphores(VkPhysicalDevice pdev)
+{
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR tl_feats;
+	VkPhysicalDeviceFeatures2 feats2;
+
+	if (!has_device_extension(pdev, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+		return false;
+
+	memset(&tl_feats, 0, sizeof tl_feats);
+	tl_feats.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+	memset(&feats2, 0, sizeof feats2);
+	feats2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	feats2.pNext = &tl_feats;
+
+	vkGetPhysicalDeviceFeatures2(pdev, &feats2);
+	return tl_feats.timelineSemaphore;
+}
+
+static void
+fill_uuid(VkPhysicalDevice pdev, uint8_t *deviceUUID, uint8_t *driverUUID)
+{
+	VkPhysicalDeviceIDProperties devProp;
+	VkPhysicalDeviceProperties2 prop2;
+
+	memset(&devProp, 0, sizeof devProp);
+	devProp.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+	memset(&prop2, 0, sizeof prop2);
+	prop2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	prop2.pNext = &devProp;
+
+	vkGetPhysicalDeviceProperties2(pdev, &prop2);
+	memcpy(deviceUUID, devProp.deviceUUID, VK_UUID_SIZE);
+	memcpy(driverUUID, devProp.driverUUID, VK_UUID_SIZE);
+}
+
+/* the best graphics queue family of pdev, -1 if there is none: compute
+ * support, timestamps (GPU timers) and more than one queue score higher,
+ * the lowest index wins a tie */
+static int
+select_queue_family(VkPhysicalDevice pdev, int *score)
+{
+	VkQueueFamilyProperties *fam_props;
+	uint32_t prop_count = 0;
+	uint32_t i;
+	int best = -1;
+	int best_score = -1;
+
+	vkGetPhysicalDeviceQueueFamilyProperties(pdev, &prop_count, 0);
+
+	fam_props = (VkQueueFamilyProperties*)malloc(prop_count * sizeof *fam_props);
+	if (!fam_props)
+		return -1;
+	vkGetPhysicalDeviceQueueFamilyProperties(pdev, &prop_count, fam_props);
+
+	for (i = 0; i < prop_count; i++) {
+		int s = 0;
+
+		if (!(fam_props[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) ||
+		    fam_props[i].queueCount == 0)
+			continue;
+
+		if (fam_props[i].queueFlags & VK_QUEUE_COMPUTE_BIT)
+			s += 4;
+		if (fam_props[i].timestampValidBits > 0)
+			s += 2;
+		if (fam_props[i].queueCount > 1)
+			s += 1;
+
+		if (s > best_score) {
+			best = (int)i;
+			best_score = s;
+		}
+	}
+	free(fam_props);
+
+	if (score)
+		*score = best_score;
+	return best;
+}
+
+static const char *
+device_type_name(VkPhysicalDeviceType type)
+{
+	switch (type) {
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+		return "discrete";
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+		return "integrated";
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+		return "virtual";
+	case VK_PHYSICAL_DEVICE_TYPE_CPU:
+		return "cpu";
+	default:
+		return "other";
+	}
+}
+
+/* -1 if pdev can't be used at all (no graphics queue, no external
+ * memory / semaphores), otherwise a hardware device beats a software one
+ * and the queue family score of select_queue_family() breaks a tie.
+ * The UUID match with the GL context is scored by the caller. */
+static int
+score_physical_device(VkPhysicalDevice pdev,
+		      const VkPhysicalDeviceProperties *props)
+{
+	int qfam_score;
+
+	if (select_queue_family(pdev, &qfam_score) < 0)
+		return -1;
+
+	if (!has_device_extension(pdev, VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME) ||
+	    !has_device_extension(pdev, VK_KHR_EXTERNAL_SEMAPHORE_EXTENSION_NAME) ||
+	    !has_device_extension(pdev, VK_KHR_EXTERNAL_MEMORY_SYSTEM_HANDLE_EXTENSION_NAME) ||
+	    !has_device_extension(pdev, VK_KHR_EXTERNAL_SEMAPHORE_SYSTEM_HANDLE_EXTENSION_NAME))
+		return -1;
+
+	switch (props->deviceType) {
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+		return 400 + qfam_score;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+		return 300 + qfam_score;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+		return 200 + qfam_score;
+	case VK_PHYSICAL_DEVICE_TYPE_CPU:
+		return 100 + qfam_score;
+	default:
+		return qfam_score;
+	}
+}
+
+/* true if pdev (at index idx) is the one named by ctx->pdev_override:
+ * its index or a substring of its name */
+static bool
+matches_device_override(const struct vk_ctx *ctx, uint32_t idx,
+			const VkPhysicalDeviceProperties *props)
+{
+	const char *ovr = ctx->pdev_override;
+	char *end;
+	long n;
+
+	n = strtol(ovr, &end, 10);
+	if (end != ovr && *end == '\0')
+		return n >= 0 && (uint32_t)n == idx;
+
+	return strstr(props->deviceName, ovr) != NULL;
+}
+
+/* Picks the device that drives the GL context (deviceUUID & driverUUID
+ * equal ctx->match_*UUID), on machines with several ICDs (e.g. lavapipe
+ * next to a hardware driver) the first enumerated device is often a
+ * different one. Without a match the best scored device is used, the
+ * interop then fails in vk_check_gl_compatibility(). ctx->pdev_override
+ * bypasses the scoring. Every candidate and the decision are logged. */
 static VkPhysicalDevice
-select_physical_device(VkInstance inst)
+select_physical_device(struct vk_ctx *ctx)
 {
-	VkResult res = VK_SUCCESS;
-	uint32_t dev_count = 0;
 	VkPhysicalDevice *pdevices;
-	VkPhysicalDevice pdevice0;
+	VkPhysicalDevice pdev = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties props;
+	uint8_t deviceUUID[VK_UUID_SIZE];
+	uint8_t driverUUID[VK_UUID_SIZE];
+	uint32_t dev_count = 0;
+	uint32_t i;
+	int best = -1;
+	int best_score = -1;
+	bool best_match = false;
+	const char *reason;
 
-	if ((res =
-	     vkEnumeratePhysicalDevices(inst, &dev_count, 0)) != VK_SUCCESS)
+	if (vkEnumeratePhysicalDevices(ctx->inst, &dev_count, 0) != VK_SUCCESS ||
+	    dev_count == 0)
 		return VK_NULL_HANDLE;
 
 	pdevices = (VkPhysicalDevice*)malloc(dev_count * sizeof(VkPhysicalDevice));
-	if (vkEnumeratePhysicalDevices(inst, &dev_count, pdevices) !=
-	    VK_SUCCESS)
+	if (!pdevices)
+		return VK_NULL_HANDLE;
+
+	if (vkEnumeratePhysicalDevices(ctx->inst, &dev_count, pdevices) !=
+	    VK_SUCCESS) {
+		free(pdevices);
+		return VK_NULL_HANDLE;
+	}
+
+	for (i = 0; i < dev_count; i++) {
+		bool match = false;
+		int score;
+
+		vkGetPhysicalDeviceProperties(pdevices[i], &props);
+		score = score_physical_device(pdevices[i], &props);
+
+		if (ctx->match_uuids) {
+			fill_uuid(pdevices[i], deviceUUID, driverUUID);
+			match = memcmp(deviceUUID, ctx->match_deviceUUID, VK_UUID_SIZE) == 0 &&
+				memcmp(driverUUID, ctx->match_driverUUID, VK_UUID_SIZE) == 0;
+		}
+
+		printf("VK device %u: %s (%s), GL UUID match: %s, score: %d\n",
+		       i, props.deviceName, device_type_name(props.deviceType),
+		       !ctx->match_uuids ? "n/a" : match ? "yes" : "no", score);
+
+		if (ctx->pdev_override) {
+			if (best < 0 && matches_device_override(ctx, i, &props)) {
+				best = (int)i;
+				best_match = match;
+			}
+			continue;
+		}
+
+		if (score < 0)
+			continue;
+
+		/* the GL context's device beats any score */
+		if (match && !best_match) {
+			best = (int)i;
+			best_score = score;
+			best_match = true;
+		} else if (match == best_match && score > best_score) {
+			best = (int)i;
+			best_score = score;
+		}
+	}
+
+	if (best < 0) {
+		if (ctx->pdev_override)
+			fprintf(stderr, "No Vulkan device matches \"%s\".\n",
+				ctx->pdev_override);
+		free(pdevices);
 		return VK_NULL_HANDLE;
+	}
 
-	pdevice0 = pdevices[0];
+	pdev = pdevices[best];
 	free(pdevices);
 
-	return pdevice0;
+	if (ctx->pdev_override)
+		reason = "override";
+	else if (best_match)
+		reason = "matches the GL context's device & driver UUID";
+	else if (ctx->match_uuids)
+		reason = "highest score, no device matches the GL context's UUIDs";
+	else
+		reason = "highest score";
+
+	vkGetPhysicalDeviceProperties(pdev, &props);
+	printf("VK device selected: %d %s (%s), queue family %d\n",
+	       best, props.deviceName, reason, select_queue_family(pdev, NULL));
+
+	if (ctx->match_uuids && !best_match)
+		fprintf(stderr, "WARNING: the Vulkan device doesn't drive the GL context, the interop will fail.\n");
+
+	return pdev;
 }
 
+static PFN_vkWaitSemaphoresKHR pfn_vkWaitSemaphoresKHR;
+static PFN_vkSignalSemaphoreKHR pfn_vkSignalSemaphoreKHR;
+static PFN_vkCreateRenderPass2KHR pfn_vkCreateRenderPass2KHR;
+
 static VkDevice
 create_device(struct vk_ctx *ctx, VkPhysicalDevice pdev)
 {
-    const char* deviceExtensions[] = {
+    const char* deviceExtensions[8] = {
         VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME,
         VK_KHR_EXTERNAL_SEMAPHORE_EXTENSION_NAME,
         VK_KHR_EXTERNAL_MEMORY_SYSTEM_HANDLE_EXTENSION_NAME,
         VK_KHR_EXTERNAL_SEMAPHORE_SYSTEM_HANDLE_EXTENSION_NAME,
         //VK_EXT_DEPTH_CLIP_CONTROL_EXTENSION_NAME
     };
+    uint32_t num_extensions = 4; /* optional extensions are appended below */
 
     //const char* deviceLayers[] = {
     //};
 
 	VkDeviceQueueCreateInfo dev_queue_info;
 	VkDeviceCreateInfo dev_info;
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR tl_feats;
 	VkDevice dev;
-	uint32_t prop_count;
-	VkQueueFamilyProperties *fam_props;
-	uint32_t i;
 	float qprio = 1;
 
-	ctx->qfam_idx = -1;
-	vkGetPhysicalDeviceQueueFamilyProperties(pdev, &prop_count, 0);
-
-	fam_props = (VkQueueFamilyProperties*)malloc(prop_count * sizeof *fam_props);
-	vkGetPhysicalDeviceQueueFamilyProperties(pdev, &prop_count, fam_props);
-
-	for (i = 0; i < prop_count; i++) {
-		if (fam_props[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-			ctx->qfam_idx = i;
-			break;
-		}
-	}
-	free(fam_props);
+	if ((ctx->qfam_idx = select_queue_family(pdev, NULL)) < 0)
+		return VK_NULL_HANDLE;
 
 	memset(&dev_queue_info, 0, sizeof dev_queue_info);
 	dev_queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
@@ -216,33 +469,155 @@ create_device(struct vk_ctx *ctx, VkPhysicalDevice pdev)
 	dev_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	dev_info.queueCreateInfoCount = 1;
 	dev_info.pQueueCreateInfos = &dev_queue_info;
-	dev_info.enabledExtensionCount = ARRAY_SIZE(deviceExtensions);
-	dev_info.ppEnabledExtensionNames = deviceExtensions;
     //dev_info.enabledLayerCount = ARRAY_SIZE(deviceLayers);
     //dev_info.ppEnabledLayerNames = deviceLayers;
 
+	ctx->has_timeline_semaphores = supports_timeline_semaphores(pdev);
+	if (ctx->has_timeline_semaphores) {
+		memset(&tl_feats, 0, sizeof tl_feats);
+		tl_feats.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		tl_feats.timelineSemaphore = VK_TRUE;
+		dev_info.pNext = &tl_feats;
+		deviceExtensions[num_extensions++] = VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME;
+	}
+
+	/* multiview & maintenance2 (required by create_renderpass2) are
+	 * core in Vulkan 1.1 */
+	ctx->has_depth_stencil_resolve =
+		has_device_extension(pdev, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME) &&
+		has_device_extension(pdev, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+	if (ctx->has_depth_stencil_resolve) {
+		deviceExtensions[num_extensions++] = VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME;
+		deviceExtensions[num_extensions++] = VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME;
+	}
+
+	ctx->has_memory_budget =
+		has_device_extension(pdev, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (ctx->has_memory_budget)
+		deviceExtensions[num_extensions++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+
+	assert(num_extensions <= ARRAY_SIZE(deviceExtensions));
+	dev_info.enabledExtensionCount = num_extensions;
+	dev_info.ppEnabledExtensionNames = deviceExtensions;
+
 	if (vkCreateDevice(pdev, &dev_info, 0, &dev) != VK_SUCCESS)
 		return VK_NULL_HANDLE;
 
+	if (ctx->has_depth_stencil_resolve) {
+		pfn_vkCreateRenderPass2KHR = (PFN_vkCreateRenderPass2KHR)
+			vkGetDeviceProcAddr(dev, "vkCreateRenderPass2KHR");
+		if (!pfn_vkCreateRenderPass2KHR)
+			ctx->has_depth_stencil_resolve = false;
+	}
+
+	if (ctx->has_timeline_semaphores) {
+		pfn_vkWaitSemaphoresKHR = (PFN_vkWaitSemaphoresKHR)
+			vkGetDeviceProcAddr(dev, "vkWaitSemaphoresKHR");
+		pfn_vkSignalSemaphoreKHR = (PFN_vkSignalSemaphoreKHR)
+			vkGetDeviceProcAddr(dev, "vkSignalSemaphoreKHR");
+		if (!pfn_vkWaitSemaphoresKHR || !pfn_vkSignalSemaphoreKHR)
+			ctx->has_timeline_semaphores = false;
+	}
+
 	return dev;
 }
 
-static void
-fill_uuid(VkPhysicalDevice pdev, uint8_t *deviceUUID, uint8_t *driverUUID)
+/* header of the on-disk pipeline cache file, followed by data_size bytes
+ * returned by vkGetPipelineCacheData() */
+struct pipeline_cache_file_header
 {
-	VkPhysicalDeviceIDProperties devProp;
-	VkPhysicalDeviceProperties2 prop2;
+	uint32_t magic;
+	uint32_t version;
+	uint8_t deviceUUID[VK_UUID_SIZE];
+	uint8_t driverUUID[VK_UUID_SIZE];
+	uint64_t data_size;
+};
 
-	memset(&devProp, 0, sizeof devProp);
-	devProp.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+#define PIPELINE_CACHE_FILE_MAGIC 0x504b4756 /* "VGKP" */
 
-	memset(&prop2, 0, sizeof prop2);
-	prop2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
-	prop2.pNext = &devProp;
+static void *
+load_pipeline_cache_data(struct vk_ctx *ctx, size_t *size)
+{
+	struct pipeline_cache_file_header hdr;
+	void *data = NULL;
+	long file_size;
+	FILE *fp;
+
+	*size = 0;
+
+	if (!ctx->pipeline_cache_file)
+		return NULL;
+
+	/* no cache file yet: cold start */
+	if (!(fp = fopen(ctx->pipeline_cache_file, "rb")))
+		return NULL;
+
+	/* the data size is checked against the file, a corrupt header
+	 * must not make us allocate a huge buffer */
+	if (fseek(fp, 0, SEEK_END) != 0 ||
+	    (file_size = ftell(fp)) < (long)sizeof hdr ||
+	    fseek(fp, 0, SEEK_SET) != 0 ||
+	    fread(&hdr, sizeof hdr, 1, fp) != 1 ||
+	    hdr.magic != PIPELINE_CACHE_FILE_MAGIC ||
+	    hdr.version != VK_PIPELINE_CACHE_FILE_VERSION ||
+	    hdr.data_size == 0 ||
+	    hdr.data_size > (uint64_t)file_size - sizeof hdr) {
+		fprintf(stderr, "Ignoring invalid pipeline cache file %s.\n",
+			ctx->pipeline_cache_file);
+		goto out;
+	}
 
-	vkGetPhysicalDeviceProperties2(pdev, &prop2);
-	memcpy(deviceUUID, devProp.deviceUUID, VK_UUID_SIZE);
-	memcpy(driverUUID, devProp.driverUUID, VK_UUID_SIZE);
+	/* the cache data is only valid for the device & driver that
+	 * produced it */
+	if (memcmp(hdr.deviceUUID, ctx->deviceUUID, VK_UUID_SIZE) != 0 ||
+	    memcmp(hdr.driverUUID, ctx->driverUUID, VK_UUID_SIZE) != 0) {
+		fprintf(stderr, "Ignoring pipeline cache file %s of a different device/driver.\n",
+			ctx->pipeline_cache_file);
+		goto out;
+	}
+
+	if (!(data = malloc((size_t)hdr.data_size)))
+		goto out;
+
+	if (fread(data, 1, (size_t)hdr.data_size, fp) != hdr.data_size) {
+		fprintf(stderr, "Failed to read pipeline cache file %s.\n",
+			ctx->pipeline_cache_file);
+		free(data);
+		data = NULL;
+		goto out;
+	}
+
+	*size = (size_t)hdr.data_size;
+
+out:
+	fclose(fp);
+	return data;
+}
+
+static VkPipelineCache
+create_pipeline_cache(struct vk_ctx *ctx)
+{
+	VkPipelineCacheCreateInfo cache_info;
+	VkPipelineCache cache;
+	size_t data_size;
+	void *data;
+
+	data = load_pipeline_cache_data(ctx, &data_size);
+
+	memset(&cache_info, 0, sizeof cache_info);
+	cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cache_info.initialDataSize = data_size;
+	cache_info.pInitialData = data;
+
+	if (vkCreatePipelineCache(ctx->dev, &cache_info, 0, &cache) != VK_SUCCESS) {
+		cache = VK_NULL_HANDLE;
+		data_size = 0;
+	}
+
+	free(data);
+
+	ctx->pipeline_cache_loaded_size = data_size;
+	return cache;
 }
 
 static VkCommandPool
@@ -441,10 +816,131 @@ get_pipeline_stage_flags(const VkImageLayout layout)
 	return 0;
 }
 
+static void
+fill_attachment2(const struct vk_image_props *props,
+		 bool is_depth,
+		 VkAttachmentDescription2KHR *att_dsc)
+{
+	VkAttachmentLoadOp load_op =
+		props->in_layout != VK_IMAGE_LAYOUT_UNDEFINED ?
+		VK_ATTACHMENT_LOAD_OP_LOAD :
+		VK_ATTACHMENT_LOAD_OP_CLEAR;
+
+	memset(att_dsc, 0, sizeof *att_dsc);
+	att_dsc->sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2_KHR;
+	att_dsc->format = props->format;
+	att_dsc->samples = get_num_samples(props->num_samples);
+	att_dsc->loadOp = load_op;
+	att_dsc->storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	att_dsc->stencilLoadOp = is_depth ? load_op : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	att_dsc->stencilStoreOp = is_depth ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	att_dsc->initialLayout = props->in_layout;
+	att_dsc->finalLayout = props->end_layout;
+}
+
+/* multisampled color & depth attachments that are resolved into single
+ * sample attachments at the end of the subpass, the depth resolve
+ * (sample 0) requires VK_KHR_depth_stencil_resolve */
+static VkRenderPass
+create_resolve_renderpass(struct vk_ctx *ctx,
+			  struct vk_image_props *color_img_props,
+			  struct vk_image_props *depth_img_props,
+			  struct vk_image_props *resolve_color_img_props,
+			  struct vk_image_props *resolve_depth_img_props)
+{
+	VkAttachmentDescription2KHR att_dsc[4];
+	VkAttachmentReference2KHR att_rfc[4];
+	VkSubpassDescriptionDepthStencilResolveKHR ds_resolve;
+	VkSubpassDescription2KHR subpass_dsc;
+	VkRenderPassCreateInfo2KHR rpass_info;
+	VkRenderPass rpass;
+	uint32_t i;
+
+	assert(ctx->has_depth_stencil_resolve);
+
+	fill_attachment2(color_img_props, false, &att_dsc[0]);
+	fill_attachment2(depth_img_props, true, &att_dsc[1]);
+	fill_attachment2(resolve_color_img_props, false, &att_dsc[2]);
+	fill_attachment2(resolve_depth_img_props, true, &att_dsc[3]);
+
+	/* the resolve overwrites every pixel of the render area */
+	att_dsc[2].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	att_dsc[3].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	att_dsc[3].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+	memset(att_rfc, 0, sizeof att_rfc);
+	for (i = 0; i < 4; i++) {
+		bool is_depth = (i % 2) == 1;
+
+		att_rfc[i].sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2_KHR;
+		att_rfc[i].attachment = i;
+		att_rfc[i].layout = is_depth ?
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL :
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		att_rfc[i].aspectMask = is_depth ?
+			get_aspect_from_depth_format(att_dsc[i].format) :
+			VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+
+	/* sample 0 is the only resolve mode every implementation supports */
+	memset(&ds_resolve, 0, sizeof ds_resolve);
+	ds_resolve.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_DEPTH_STENCIL_RESOLVE_KHR;
+	ds_resolve.depthResolveMode = VK_RESOLVE_MODE_SAMPLE_ZERO_BIT_KHR;
+	ds_resolve.stencilResolveMode = VK_RESOLVE_MODE_SAMPLE_ZERO_BIT_KHR;
+	ds_resolve.pDepthStencilResolveAttachment = &att_rfc[3];
+
+	memset(&subpass_dsc, 0, sizeof subpass_dsc);
+	subpass_dsc.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2_KHR;
+	subpass_dsc.pNext = &ds_resolve;
+	subpass_dsc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass_dsc.colorAttachmentCount = 1;
+	subpass_dsc.pColorAttachments = &att_rfc[0];
+	subpass_dsc.pDepthStencilAttachment = &att_rfc[1];
+	subpass_dsc.pResolveAttachments = &att_rfc[2];
+
+	memset(&rpass_info, 0, sizeof rpass_info);
+	rpass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2_KHR;
+	rpass_info.attachmentCount = 4;
+	rpass_info.pAttachments = att_dsc;
+	rpass_info.subpassCount = 1;
+	rpass_info.pSubpasses = &subpass_dsc;
+
+	if (pfn_vkCreateRenderPass2KHR(ctx->dev, &rpass_info, 0, &rpass) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to create resolve renderpass.\n");
+		rpass = VK_NULL_HANDLE;
+	}
+
+	return rpass;
+}
+
+static bool
+create_resolve_view(struct vk_ctx *ctx,
+		    struct vk_image_att *att,
+		    VkImageAspectFlags aspect_mask)
+{
+	VkImageViewCreateInfo view_info;
+
+	if (att->obj.img_view != VK_NULL_HANDLE)
+		return true; /* shared by several renderers */
+
+	memset(&view_info, 0, sizeof view_info);
+	view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	view_info.image = att->obj.img;
+	view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	view_info.format = att->props.format;
+	view_info.subresourceRange.aspectMask = aspect_mask;
+	view_info.subresourceRange.levelCount = 1;
+	view_info.subresourceRange.layerCount = 1;
+
+	return vkCreateImageView(ctx->dev, &view_info, 0, &att->obj.img_view) == VK_SUCCESS;
+}
+
 static void
 create_framebuffer(struct vk_ctx *ctx,
 		   struct vk_image_att *color_att,
 		   struct vk_image_att *depth_att,
+		   struct vk_image_att *resolve_color_att,
+		   struct vk_image_att *resolve_depth_att,
 		   struct vk_renderer *renderer)
 {
 	VkImageSubresourceRange sr;
@@ -452,7 +948,8 @@ create_framebuffer(struct vk_ctx *ctx,
 	VkImageViewCreateInfo depth_info;
 	VkFramebufferCreateInfo fb_info;
 	VkImageViewType view_type = get_image_view_type(&color_att->props);
-	VkImageView atts[2];
+	VkImageView atts[4];
+	uint32_t num_atts = depth_att ? 2 : 1;
 
 	if (!color_att->obj.img || (depth_att && !depth_att->obj.img)) {
 		fprintf(stderr, "Invalid framebuffer attachment image.\n");
@@ -486,7 +983,9 @@ create_framebuffer(struct vk_ctx *ctx,
 	color_info.format = color_att->props.format;
 	color_info.subresourceRange = sr;
 
-	if (vkCreateImageView(ctx->dev, &color_info, 0, &color_att->obj.img_view) != VK_SUCCESS) {
+	/* the attachments may be shared by several renderers */
+	if (color_att->obj.img_view == VK_NULL_HANDLE &&
+	    vkCreateImageView(ctx->dev, &color_info, 0, &color_att->obj.img_view) != VK_SUCCESS) {
 		fprintf(stderr, "Failed to create color image view for framebuffer.\n");
 		vk_destroy_ext_image(ctx, &color_att->obj);
 		goto fail;
@@ -509,7 +1008,8 @@ create_framebuffer(struct vk_ctx *ctx,
 		depth_info.format = depth_att->props.format;
 		depth_info.subresourceRange = sr;
 
-		if (vkCreateImageView(ctx->dev, &depth_info, 0, &depth_att->obj.img_view) != VK_SUCCESS) {
+		if (depth_att->obj.img_view == VK_NULL_HANDLE &&
+		    vkCreateImageView(ctx->dev, &depth_info, 0, &depth_att->obj.img_view) != VK_SUCCESS) {
 			fprintf(stderr, "Failed to create depth image view for framebuffer.\n");
 			vk_destroy_ext_image(ctx, &depth_att->obj);
 			goto fail;
@@ -521,13 +1021,29 @@ create_framebuffer(struct vk_ctx *ctx,
 	if (depth_att)
 		atts[1] = depth_att->obj.img_view;
 
+	/* resolve attachments follow the multisampled ones, see
+	 * create_resolve_renderpass() */
+	if (resolve_color_att) {
+		assert(depth_att && resolve_depth_att);
+
+		if (!create_resolve_view(ctx, resolve_color_att, VK_IMAGE_ASPECT_COLOR_BIT) ||
+		    !create_resolve_view(ctx, resolve_depth_att,
+					 get_aspect_from_depth_format(resolve_depth_att->props.format))) {
+			fprintf(stderr, "Failed to create resolve image views for framebuffer.\n");
+			goto fail;
+		}
+
+		atts[num_atts++] = resolve_color_att->obj.img_view;
+		atts[num_atts++] = resolve_depth_att->obj.img_view;
+	}
+
 	memset(&fb_info, 0, sizeof fb_info);
 	fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 	fb_info.renderPass = renderer->draw_renderpass;
 	fb_info.width = color_att->props.w;
 	fb_info.height = color_att->props.h;
 	fb_info.layers = color_att->props.num_layers ? color_att->props.num_layers : 1;
-	fb_info.attachmentCount = depth_att ? 2 : 1;
+	fb_info.attachmentCount = num_atts;
 	fb_info.pAttachments = atts;
 
 	if (vkCreateFramebuffer(ctx->dev, &fb_info, 0, &renderer->fb) != VK_SUCCESS)
@@ -572,7 +1088,7 @@ create_pipeline(struct vk_ctx *ctx,
 		struct vk_renderer *renderer)
 {
 	VkVertexInputBindingDescription vert_bind_dsc[1];
-	VkVertexInputAttributeDescription vert_att_dsc[1];
+	VkVertexInputAttributeDescription vert_att_dsc[VK_MAX_VERTEX_ATTRIBS];
 
 	VkPipelineColorBlendAttachmentState cb_att_state[1];
 	VkPipelineVertexInputStateCreateInfo vert_input_info;
@@ -582,6 +1098,7 @@ create_pipeline(struct vk_ctx *ctx,
 	VkPipelineMultisampleStateCreateInfo ms_info;
 	VkPipelineDepthStencilStateCreateInfo ds_info;
 	VkPipelineColorBlendStateCreateInfo cb_info;
+	VkPipelineDynamicStateCreateInfo dyn_info;
 	VkPipelineShaderStageCreateInfo sdr_stages[2];
 	VkPipelineLayoutCreateInfo layout_info;
 	VkGraphicsPipelineCreateInfo pipeline_info;
@@ -591,27 +1108,57 @@ create_pipeline(struct vk_ctx *ctx,
 
 	VkStencilOpState front;
 	VkStencilOpState back;
+	VkDynamicState dyn_states[] = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR,
+	};
 	int i;
 	VkPipelineLayout pipeline_layout;
 	uint32_t stride;
-
-	/* format of vertex attributes:
-	 * we have 2D vectors so we need a RG format:
-	 * R for x, G for y
-	 * the stride (distance between 2 consecutive elements)
-	 * must be 8 because we use 32 bit floats and
-	 * 32bits = 8bytes */
-	format = VK_FORMAT_R32G32_SFLOAT;
-	vkGetPhysicalDeviceFormatProperties(ctx->pdev, format, &fmt_props);
-	assert(fmt_props.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT);
-	stride = 8;
+	uint32_t num_attribs;
+	static const VkFormat float_formats[] = {
+		VK_FORMAT_R32_SFLOAT,
+		VK_FORMAT_R32G32_SFLOAT,
+		VK_FORMAT_R32G32B32_SFLOAT,
+		VK_FORMAT_R32G32B32A32_SFLOAT,
+	};
 
 	/* VkVertexInputAttributeDescription */
 	memset(&vert_att_dsc, 0, sizeof vert_att_dsc);
-	vert_att_dsc[0].location = 0;
-	vert_att_dsc[0].binding = 0;
-	vert_att_dsc[0].format = format; /* see comment */
-	vert_att_dsc[0].offset = 0;
+
+	num_attribs = renderer->vertex_info.num_attribs;
+	if (num_attribs == 0) {
+		/* format of vertex attributes:
+		 * we have 2D vectors so we need a RG format:
+		 * R for x, G for y
+		 * the stride (distance between 2 consecutive elements)
+		 * must be 8 because we use 32 bit floats and
+		 * 32bits = 8bytes */
+		format = VK_FORMAT_R32G32_SFLOAT;
+		vkGetPhysicalDeviceFormatProperties(ctx->pdev, format, &fmt_props);
+		assert(fmt_props.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT);
+		stride = 8;
+
+		vert_att_dsc[0].location = 0;
+		vert_att_dsc[0].binding = 0;
+		vert_att_dsc[0].format = format; /* see comment */
+		vert_att_dsc[0].offset = 0;
+		num_attribs = 1;
+	} else {
+		/* interleaved float attributes, e.g. vec3 position + vec2 uv */
+		assert(num_attribs <= VK_MAX_VERTEX_ATTRIBS);
+		stride = 0;
+		for (i = 0; i < (int)num_attribs; i++) {
+			uint32_t n = renderer->vertex_info.attrib_components[i];
+			assert(n >= 1 && n <= 4);
+
+			vert_att_dsc[i].location = i;
+			vert_att_dsc[i].binding = 0;
+			vert_att_dsc[i].format = float_formats[n - 1];
+			vert_att_dsc[i].offset = stride;
+			stride += n * sizeof(float);
+		}
+	}
 
 	/* VkVertexInputBindingDescription */
 	memset(&vert_bind_dsc, 0, sizeof vert_bind_dsc);
@@ -627,7 +1174,7 @@ create_pipeline(struct vk_ctx *ctx,
 	vert_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	vert_input_info.vertexBindingDescriptionCount = use_vbo ? 1 : 0;
 	vert_input_info.pVertexBindingDescriptions = vert_bind_dsc;
-	vert_input_info.vertexAttributeDescriptionCount = use_vbo ? 1 : 0;
+	vert_input_info.vertexAttributeDescriptionCount = use_vbo ? num_attribs : 0;
 	vert_input_info.pVertexAttributeDescriptions = vert_att_dsc;
 
 	/* VkPipelineInputAssemblyStateCreateInfo */
@@ -657,6 +1204,13 @@ create_pipeline(struct vk_ctx *ctx,
 	viewport_info.scissorCount = 1;
 	viewport_info.pScissors = &scissor;
 
+	/* set by begin_renderpass(), the render area may be smaller than the
+	 * framebuffer (see vk_recreate_framebuffer()) */
+	memset(&dyn_info, 0, sizeof dyn_info);
+	dyn_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dyn_info.dynamicStateCount = ARRAY_SIZE(dyn_states);
+	dyn_info.pDynamicStates = dyn_states;
+
 	/* VkPipelineRasterizationStateCreateInfo */
 	memset(&rs_info, 0, sizeof rs_info);
 	rs_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -750,6 +1304,10 @@ create_pipeline(struct vk_ctx *ctx,
 	layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	layout_info.pushConstantRangeCount = 1;
 	layout_info.pPushConstantRanges = pc_range;
+	if (renderer->desc_set_layout != VK_NULL_HANDLE) {
+		layout_info.setLayoutCount = 1;
+		layout_info.pSetLayouts = &renderer->desc_set_layout;
+	}
 
 	if (vkCreatePipelineLayout(ctx->dev, &layout_info, 0, &pipeline_layout) != VK_SUCCESS) {
 		fprintf(stderr, "Failed to create pipeline layout\n");
@@ -771,10 +1329,11 @@ create_pipeline(struct vk_ctx *ctx,
 	pipeline_info.pMultisampleState = &ms_info;
 	pipeline_info.pDepthStencilState = &ds_info;
 	pipeline_info.pColorBlendState = &cb_info;
+	pipeline_info.pDynamicState = &dyn_info;
 	pipeline_info.stageCount = 2;
 	pipeline_info.pStages = sdr_stages;
 
-	if (vkCreateGraphicsPipelines(ctx->dev, 0, 1,
+	if (vkCreateGraphicsPipelines(ctx->dev, ctx->pipeline_cache, 1,
 				      &pipeline_info, 0, &renderer->pipeline) !=
 			VK_SUCCESS) {
 		fprintf(stderr, "Failed to create graphics pipeline.\n");
@@ -782,6 +1341,82 @@ create_pipeline(struct vk_ctx *ctx,
 	}
 }
 
+/* a pool with a single set of the renderer's layout */
+static bool
+allocate_descriptor_set(struct vk_ctx *ctx,
+			struct vk_renderer *renderer,
+			VkDescriptorPool *desc_pool,
+			VkDescriptorSet *desc_set)
+{
+	VkDescriptorPoolSize pool_size;
+	VkDescriptorPoolCreateInfo pool_info;
+	VkDescriptorSetAllocateInfo set_alloc_info;
+
+	memset(&pool_size, 0, sizeof pool_size);
+	pool_size.type = renderer->desc_type;
+	pool_size.descriptorCount = 1;
+
+	memset(&pool_info, 0, sizeof pool_info);
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.maxSets = 1;
+	pool_info.poolSizeCount = 1;
+	pool_info.pPoolSizes = &pool_size;
+
+	if (vkCreateDescriptorPool(ctx->dev, &pool_info, 0,
+				   desc_pool) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to create descriptor pool.\n");
+		return false;
+	}
+
+	memset(&set_alloc_info, 0, sizeof set_alloc_info);
+	set_alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	set_alloc_info.descriptorPool = *desc_pool;
+	set_alloc_info.descriptorSetCount = 1;
+	set_alloc_info.pSetLayouts = &renderer->desc_set_layout;
+
+	if (vkAllocateDescriptorSets(ctx->dev, &set_alloc_info,
+				     desc_set) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to allocate descriptor set.\n");
+		vkDestroyDescriptorPool(ctx->dev, *desc_pool, 0);
+		*desc_pool = VK_NULL_HANDLE;
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+create_descriptor_set(struct vk_ctx *ctx,
+		      VkDescriptorType desc_type,
+		      struct vk_renderer *renderer)
+{
+	VkDescriptorSetLayoutBinding binding;
+	VkDescriptorSetLayoutCreateInfo set_layout_info;
+
+	renderer->desc_type = desc_type;
+
+	/* a single buffer at set = 0, binding = 0, read by the vertex shader */
+	memset(&binding, 0, sizeof binding);
+	binding.binding = 0;
+	binding.descriptorType = desc_type;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	memset(&set_layout_info, 0, sizeof set_layout_info);
+	set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	set_layout_info.bindingCount = 1;
+	set_layout_info.pBindings = &binding;
+
+	if (vkCreateDescriptorSetLayout(ctx->dev, &set_layout_info, 0,
+					&renderer->desc_set_layout) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to create descriptor set layout.\n");
+		return false;
+	}
+
+	return allocate_descriptor_set(ctx, renderer, &renderer->desc_pool,
+				       &renderer->desc_set);
+}
+
 static VkCommandBuffer
 create_cmd_buf(VkDevice dev, VkCommandPool cmd_pool)
 {
@@ -800,99 +1435,548 @@ create_cmd_buf(VkDevice dev, VkCommandPool cmd_pool)
 	return cmd_buf;
 }
 
-static uint32_t
-get_memory_type_idx(VkPhysicalDevice pdev,
-		    const VkMemoryRequirements *mem_reqs,
-		    VkMemoryPropertyFlagBits prop_flags)
+static bool
+create_frames(struct vk_ctx *ctx)
 {
-	VkPhysicalDeviceMemoryProperties pdev_mem_props;
+	VkFenceCreateInfo fence_info;
 	uint32_t i;
 
-	vkGetPhysicalDeviceMemoryProperties(pdev, &pdev_mem_props);
+	/* The fences start signaled, so that the first vk_acquire_frame()
+	 * of every ring slot does not block. */
+	memset(&fence_info, 0, sizeof fence_info);
+	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-	for (i = 0; i < pdev_mem_props.memoryTypeCount; i++) {
-		const VkMemoryType *type = &pdev_mem_props.memoryTypes[i];
+	for (i = 0; i < ctx->num_frames_in_flight; i++) {
+		struct vk_frame *frame = &ctx->frames[i];
 
-		if ((mem_reqs->memoryTypeBits & (1 << i)) &&
-		    (type->propertyFlags & prop_flags) == prop_flags) {
-			return i;
-			break;
+		if ((frame->cmd_buf = create_cmd_buf(ctx->dev, ctx->cmd_pool)) ==
+				VK_NULL_HANDLE) {
+			fprintf(stderr, "Failed to create frame command buffer.\n");
+			return false;
+		}
+
+		if (vkCreateFence(ctx->dev, &fence_info, 0, &frame->fence) != VK_SUCCESS) {
+			fprintf(stderr, "Failed to create frame fence.\n");
+			return false;
+		}
+
+		if (!vk_create_semaphores(ctx, &frame->semaphores)) {
+			fprintf(stderr, "Failed to create frame semaphores.\n");
+			return false;
 		}
 	}
-	return UINT32_MAX;
+
+	return true;
 }
 
-static VkSampleCountFlagBits
-get_num_samples(uint32_t num_samples)
+/* device memory allocator, see struct vk_mem_allocator */
+
+struct vk_mem_range
 {
-	switch(num_samples) {
-	case 64:
-		return VK_SAMPLE_COUNT_64_BIT;
-	case 32:
-		return VK_SAMPLE_COUNT_32_BIT;
-	case 16:
-		return VK_SAMPLE_COUNT_16_BIT;
-	case 8:
-		return VK_SAMPLE_COUNT_8_BIT;
-	case 4:
-		return VK_SAMPLE_COUNT_4_BIT;
-	case 2:
-		return VK_SAMPLE_COUNT_2_BIT;
-	case 1:
-		break;
-	default:
-		fprintf(stderr, "Invalid number of samples in VkSampleCountFlagBits. Using one sample.\n");
-		break;
-	}
-	return VK_SAMPLE_COUNT_1_BIT;
-}
+	VkDeviceSize offset;
+	VkDeviceSize size;
+};
 
-static VkDeviceMemory
-alloc_memory(struct vk_ctx *ctx,
-	     bool is_external,
-	     const VkMemoryRequirements *mem_reqs,
-	     VkImage image,
-	     VkBuffer buffer,
-	     VkMemoryPropertyFlags prop_flags)
+struct vk_mem_block
 {
-	VkExportMemoryAllocateInfo exp_mem_info;
-	VkMemoryAllocateInfo mem_alloc_info;
 	VkDeviceMemory mem;
+	VkDeviceSize size;
+	uint32_t type_idx;
+
+	/* only internal, non-dedicated blocks are shared by several
+	 * resources, linear ones (buffers) are kept apart from optimal ones
+	 * (images), so bufferImageGranularity never matters */
+	bool shared;
+	bool linear;
+
+	/* host-visible blocks are mapped for their whole lifetime */
+	void *map;
+
+	/* sorted by offset, neighbouring free ranges are merged */
+	struct vk_mem_range *free_ranges;
+	uint32_t num_free_ranges;
+	uint32_t max_free_ranges;
+
+	uint32_t num_resources;
+	struct vk_mem_block *next;
+};
+
+static int
+count_bits(uint32_t bits)
+{
+	int n = 0;
+
+	for (; bits; bits &= bits - 1)
+		n++;
+	return n;
+}
+
+static void
+mem_init(struct vk_ctx *ctx)
+{
+	VkPhysicalDeviceProperties pdev_props;
+
+	memset(&ctx->mem, 0, sizeof ctx->mem);
+
+	vkGetPhysicalDeviceMemoryProperties(ctx->pdev, &ctx->mem.props);
+	vkGetPhysicalDeviceProperties(ctx->pdev, &pdev_props);
+
+	ctx->mem.granularity = pdev_props.limits.bufferImageGranularity;
+	ctx->mem.max_blocks = pdev_props.limits.maxMemoryAllocationCount;
+}
+
+struct heap_budgets
+{
+	VkDeviceSize budget[VK_MAX_MEMORY_HEAPS];
+	VkDeviceSize usage[VK_MAX_MEMORY_HEAPS];
+};
+
+/* budget & usage of every heap for the whole process (one query), without
+ * VK_EXT_memory_budget only the blocks of ctx are known */
+static void
+get_heap_budgets(struct vk_ctx *ctx, struct heap_budgets *budgets)
+{
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_props;
+	VkPhysicalDeviceMemoryProperties2 props2;
+	uint32_t i;
+
+	if (ctx->has_memory_budget) {
+		memset(&budget_props, 0, sizeof budget_props);
+		budget_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		memset(&props2, 0, sizeof props2);
+		props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		props2.pNext = &budget_props;
+
+		vkGetPhysicalDeviceMemoryProperties2(ctx->pdev, &props2);
+		memcpy(budgets->budget, budget_props.heapBudget, sizeof budgets->budget);
+		memcpy(budgets->usage, budget_props.heapUsage, sizeof budgets->usage);
+		return;
+	}
+
+	for (i = 0; i < ctx->mem.props.memoryHeapCount; i++) {
+		budgets->budget[i] = ctx->mem.props.memoryHeaps[i].size / 10 * 8;
+		budgets->usage[i] = ctx->mem.heap_allocated[i];
+	}
+}
+
+/* the memory type for a new block of block_size bytes, UINT32_MAX if no
+ * type has the required flags: a heap with room in its budget beats more
+ * of the preferred flags, fewer unrequested flags (e.g. HOST_CACHED for
+ * write-only buffers) break a tie */
+static uint32_t
+select_memory_type(struct vk_ctx *ctx,
+		   const struct heap_budgets *budgets,
+		   uint32_t type_bits,
+		   VkMemoryPropertyFlags required,
+		   VkMemoryPropertyFlags preferred,
+		   VkDeviceSize block_size)
+{
+	const VkPhysicalDeviceMemoryProperties *props = &ctx->mem.props;
+	uint32_t best = UINT32_MAX;
+	int best_score = INT_MIN;
+	uint32_t i;
+
+	for (i = 0; i < props->memoryTypeCount; i++) {
+		VkMemoryPropertyFlags flags = props->memoryTypes[i].propertyFlags;
+		uint32_t heap = props->memoryTypes[i].heapIndex;
+		int score = 0;
+
+		if (!(type_bits & (1u << i)) ||
+		    (flags & required) != required ||
+		    (flags & VK_MEMORY_PROPERTY_PROTECTED_BIT))
+			continue;
+
+		if (budgets->usage[heap] + block_size <= budgets->budget[heap])
+			score += 1000;
+
+		score += 10 * count_bits(flags & preferred);
+		score -= count_bits(flags & ~(required | preferred));
+
+		if (score > best_score) {
+			best = i;
+			best_score = score;
+		}
+	}
+
+	return best;
+}
+
+static bool
+mem_block_insert_range(struct vk_mem_block *block, uint32_t idx,
+		       VkDeviceSize offset, VkDeviceSize size)
+{
+	if (block->num_free_ranges == block->max_free_ranges) {
+		uint32_t max = block->max_free_ranges ? block->max_free_ranges * 2 : 8;
+		struct vk_mem_range *ranges = (struct vk_mem_range*)
+			realloc(block->free_ranges, max * sizeof *ranges);
+
+		if (!ranges)
+			return false;
+		block->free_ranges = ranges;
+		block->max_free_ranges = max;
+	}
+
+	memmove(&block->free_ranges[idx + 1], &block->free_ranges[idx],
+		(block->num_free_ranges - idx) * sizeof *block->free_ranges);
+	block->free_ranges[idx].offset = offset;
+	block->free_ranges[idx].size = size;
+	block->num_free_ranges++;
+	return true;
+}
+
+static void
+mem_block_remove_range(struct vk_mem_block *block, uint32_t idx)
+{
+	block->num_free_ranges--;
+	memmove(&block->free_ranges[idx], &block->free_ranges[idx + 1],
+		(block->num_free_ranges - idx) * sizeof *block->free_ranges);
+}
+
+/* first fit, the alignment padding in front of the range stays free */
+static bool
+mem_block_reserve(struct vk_mem_block *block, VkDeviceSize size,
+		  VkDeviceSize alignment, VkDeviceSize *offset)
+{
+	uint32_t i;
+
+	if (alignment == 0)
+		alignment = 1;
+
+	for (i = 0; i < block->num_free_ranges; i++) {
+		struct vk_mem_range *range = &block->free_ranges[i];
+		VkDeviceSize start = (range->offset + alignment - 1) / alignment * alignment;
+		VkDeviceSize end = range->offset + range->size;
+
+		if (start + size > end)
+			continue;
+
+		if (start > range->offset && start + size < end) {
+			/* split: the padding stays at i, the rest goes to i + 1 */
+			if (!mem_block_insert_range(block, i + 1, start + size,
+						    end - (start + size)))
+				return false;
+			block->free_ranges[i].size = start - block->free_ranges[i].offset;
+		} else if (start > range->offset) {
+			range->size = start - range->offset;
+		} else if (start + size < end) {
+			range->offset = start + size;
+			range->size = end - range->offset;
+		} else {
+			mem_block_remove_range(block, i);
+		}
+
+		*offset = start;
+		return true;
+	}
+
+	return false;
+}
+
+static void
+mem_block_release(struct vk_mem_block *block, VkDeviceSize offset,
+		  VkDeviceSize size)
+{
+	struct vk_mem_range *prev, *next;
+	uint32_t i;
+
+	for (i = 0; i < block->num_free_ranges; i++) {
+		if (block->free_ranges[i].offset > offset)
+			break;
+	}
+
+	prev = i > 0 ? &block->free_ranges[i - 1] : NULL;
+	next = i < block->num_free_ranges ? &block->free_ranges[i] : NULL;
+
+	if (prev && prev->offset + prev->size != offset)
+		prev = NULL;
+	if (next && offset + size != next->offset)
+		next = NULL;
+
+	if (prev && next) {
+		prev->size += size + next->size;
+		mem_block_remove_range(block, i);
+	} else if (prev) {
+		prev->size += size;
+	} else if (next) {
+		next->offset = offset;
+		next->size += size;
+	} else if (!mem_block_insert_range(block, i, offset, size)) {
+		/* only costs the range until the block is destroyed */
+		fprintf(stderr, "Failed to track a free Vulkan memory range.\n");
+	}
+}
+
+static void
+mem_block_destroy(struct vk_ctx *ctx, struct vk_mem_block *block)
+{
+	struct vk_mem_block **link;
+	uint32_t heap = ctx->mem.props.memoryTypes[block->type_idx].heapIndex;
+
+	for (link = &ctx->mem.blocks; *link; link = &(*link)->next) {
+		if (*link == block) {
+			*link = block->next;
+			break;
+		}
+	}
+
+	if (block->map)
+		vkUnmapMemory(ctx->dev, block->mem);
+	vkFreeMemory(ctx->dev, block->mem, 0);
+
+	ctx->mem.num_blocks--;
+	ctx->mem.heap_allocated[heap] -= block->size;
+
+	free(block->free_ranges);
+	free(block);
+}
+
+static struct vk_mem_block *
+mem_block_create(struct vk_ctx *ctx, const struct heap_budgets *budgets,
+		 uint32_t type_idx, VkDeviceSize size,
+		 bool is_external, VkImage ded_image, VkBuffer ded_buffer)
+{
+	VkExportMemoryAllocateInfo exp_mem_info;
 	VkMemoryDedicatedAllocateInfoKHR ded_info;
+	VkMemoryAllocateInfo mem_alloc_info;
+	const VkMemoryType *type = &ctx->mem.props.memoryTypes[type_idx];
+	struct vk_mem_block *block;
+	const void *pnext = NULL;
+	VkDeviceSize budget = budgets->budget[type->heapIndex];
+	VkDeviceSize usage = budgets->usage[type->heapIndex];
+
+	if (ctx->mem.num_blocks >= ctx->mem.max_blocks) {
+		fprintf(stderr, "Out of Vulkan memory allocations (maxMemoryAllocationCount: %u).\n",
+			ctx->mem.max_blocks);
+		return NULL;
+	}
+
+	if (usage + size > budget)
+		fprintf(stderr, "WARNING: Vulkan memory heap %u over budget (%.1f + %.1f of %.1f MiB).\n",
+			type->heapIndex, usage / 1048576.0, size / 1048576.0,
+			budget / 1048576.0);
+
+	if (ded_image != VK_NULL_HANDLE || ded_buffer != VK_NULL_HANDLE) {
+		memset(&ded_info, 0, sizeof ded_info);
+		ded_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+		ded_info.image = ded_image;
+		ded_info.buffer = ded_buffer;
+		pnext = &ded_info;
+	}
 
 	if (is_external) {
 		memset(&exp_mem_info, 0, sizeof exp_mem_info);
 		exp_mem_info.sType = VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO;
+		exp_mem_info.pNext = pnext;
 		exp_mem_info.handleTypes =
 			VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_BIT;
+		pnext = &exp_mem_info;
 	}
 
+	if (!(block = (struct vk_mem_block*)calloc(1, sizeof *block)))
+		return NULL;
+
+	block->size = size;
+	block->type_idx = type_idx;
+	if (!mem_block_insert_range(block, 0, 0, size))
+		goto fail;
+
 	memset(&mem_alloc_info, 0, sizeof mem_alloc_info);
 	mem_alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	mem_alloc_info.pNext = is_external ? &exp_mem_info : 0;
-	mem_alloc_info.allocationSize = mem_reqs->size;
-	mem_alloc_info.memoryTypeIndex =
-		get_memory_type_idx(ctx->pdev, mem_reqs, prop_flags);
+	mem_alloc_info.pNext = pnext;
+	mem_alloc_info.allocationSize = size;
+	mem_alloc_info.memoryTypeIndex = type_idx;
+
+	if (vkAllocateMemory(ctx->dev, &mem_alloc_info, 0, &block->mem) !=
+	    VK_SUCCESS)
+		goto fail;
+
+	if ((type->propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+	    vkMapMemory(ctx->dev, block->mem, 0, VK_WHOLE_SIZE, 0, &block->map) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to map Vulkan memory block.\n");
+		vkFreeMemory(ctx->dev, block->mem, 0);
+		goto fail;
+	}
+
+	block->next = ctx->mem.blocks;
+	ctx->mem.blocks = block;
+	ctx->mem.num_blocks++;
+	ctx->mem.heap_allocated[type->heapIndex] += size;
+
+	return block;
 
-	if (mem_alloc_info.memoryTypeIndex == UINT32_MAX) {
+fail:
+	free(block->free_ranges);
+	free(block);
+	return NULL;
+}
+
+/* binds nothing, fills mobj with the memory range (mem, offset, mem_sz) of
+ * a resource with the given requirements: internal resources up to half a
+ * block share VK_MEM_BLOCK_SIZE blocks, the others get a block of their
+ * own (exported, dedicated or large) */
+static bool
+mem_alloc(struct vk_ctx *ctx,
+	  const VkMemoryRequirements *reqs,
+	  VkMemoryPropertyFlags required,
+	  VkMemoryPropertyFlags preferred,
+	  bool is_external,
+	  bool is_linear,
+	  VkImage ded_image,
+	  VkBuffer ded_buffer,
+	  struct vk_mem_obj *mobj)
+{
+	const bool shared = !is_external && ded_image == VK_NULL_HANDLE &&
+			    ded_buffer == VK_NULL_HANDLE &&
+			    reqs->size <= VK_MEM_BLOCK_SIZE / 2;
+	const VkPhysicalDeviceMemoryProperties *props = &ctx->mem.props;
+	struct vk_mem_block *block;
+	struct heap_budgets budgets;
+	VkDeviceSize offset = 0;
+	uint32_t type_idx;
+
+	mobj->mem = VK_NULL_HANDLE;
+	mobj->mem_sz = 0;
+	mobj->offset = 0;
+	mobj->dedicated = ded_image != VK_NULL_HANDLE || ded_buffer != VK_NULL_HANDLE;
+	mobj->sub_allocated = false;
+	mobj->block = NULL;
+
+	/* one budget query for the whole allocation */
+	get_heap_budgets(ctx, &budgets);
+
+	type_idx = select_memory_type(ctx, &budgets, reqs->memoryTypeBits, required, preferred,
+				      shared ? VK_MEM_BLOCK_SIZE : reqs->size);
+	if (type_idx == UINT32_MAX) {
 		fprintf(stderr, "No suitable memory type index found.\n");
-		return VK_NULL_HANDLE;
+		return false;
 	}
 
-	if (image || buffer) {
-		memset(&ded_info, 0, sizeof ded_info);
-		ded_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
-		ded_info.image = image;
-		ded_info.buffer = buffer;
+	/* an existing block of the type a new block would get needs no new
+	 * memory at all (the preferred flags may not exist on any type) */
+	for (block = shared ? ctx->mem.blocks : NULL; block; block = block->next) {
+		if (!block->shared || block->linear != is_linear ||
+		    block->type_idx != type_idx)
+			continue;
 
-		exp_mem_info.pNext = &ded_info;
+		if (mem_block_reserve(block, reqs->size, reqs->alignment, &offset))
+			goto found;
 	}
 
-	if (vkAllocateMemory(ctx->dev, &mem_alloc_info, 0, &mem) !=
-	    VK_SUCCESS)
-		return VK_NULL_HANDLE;
+	/* a full block may not fit into the heap any more, the resource alone
+	 * might */
+	block = NULL;
+	if (shared)
+		block = mem_block_create(ctx, &budgets, type_idx, VK_MEM_BLOCK_SIZE, false,
+					 VK_NULL_HANDLE, VK_NULL_HANDLE);
+	if (!block)
+		block = mem_block_create(ctx, &budgets, type_idx, reqs->size, is_external,
+					 ded_image, ded_buffer);
+	if (!block)
+		return false;
+
+	block->shared = shared;
+	block->linear = is_linear;
+
+	if (!mem_block_reserve(block, reqs->size, reqs->alignment, &offset)) {
+		mem_block_destroy(ctx, block);
+		return false;
+	}
+
+found:
+	block->num_resources++;
+	ctx->mem.num_resources++;
+	ctx->mem.heap_used[props->memoryTypes[block->type_idx].heapIndex] += reqs->size;
+
+	mobj->mem = block->mem;
+	mobj->offset = offset;
+	mobj->mem_sz = reqs->size;
+	mobj->block = block;
+	return true;
+}
 
-	return mem;
+/* mobj->mem_sz must still be the size reserved by mem_alloc() for a
+ * resource in a shared block, empty shared blocks are kept for the next
+ * resources until vk_cleanup_ctx() */
+static void
+mem_free(struct vk_ctx *ctx, struct vk_mem_obj *mobj)
+{
+	struct vk_mem_block *block = mobj->block;
+
+	mobj->mem = VK_NULL_HANDLE;
+	mobj->block = NULL;
+
+	if (!block)
+		return;
+
+	block->num_resources--;
+	ctx->mem.num_resources--;
+	ctx->mem.heap_used[ctx->mem.props.memoryTypes[block->type_idx].heapIndex] -= mobj->mem_sz;
+
+	if (!block->shared)
+		mem_block_destroy(ctx, block);
+	else
+		mem_block_release(block, mobj->offset, mobj->mem_sz);
+}
+
+static void
+mem_cleanup(struct vk_ctx *ctx)
+{
+	while (ctx->mem.blocks)
+		mem_block_destroy(ctx, ctx->mem.blocks);
+
+	ctx->mem.num_resources = 0;
+	memset(ctx->mem.heap_used, 0, sizeof ctx->mem.heap_used);
+}
+
+void
+vk_print_memory_stats(struct vk_ctx *ctx)
+{
+	const VkPhysicalDeviceMemoryProperties *props = &ctx->mem.props;
+	struct heap_budgets budgets;
+	uint32_t i;
+
+	get_heap_budgets(ctx, &budgets);
+
+	printf("VK memory: %u allocations (maxMemoryAllocationCount: %u), %u resources, budget: %s\n",
+	       ctx->mem.num_blocks, ctx->mem.max_blocks, ctx->mem.num_resources,
+	       ctx->has_memory_budget ? "VK_EXT_memory_budget" : "80% of the heap size");
+
+	for (i = 0; i < props->memoryHeapCount; i++) {
+		printf("VK memory heap %u (%s, %.0f MiB): %.1f MiB in blocks, %.1f MiB bound, process usage %.1f of %.1f MiB budget\n",
+		       i,
+		       (props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "device-local" : "host",
+		       props->memoryHeaps[i].size / 1048576.0,
+		       ctx->mem.heap_allocated[i] / 1048576.0,
+		       ctx->mem.heap_used[i] / 1048576.0,
+		       budgets.usage[i] / 1048576.0, budgets.budget[i] / 1048576.0);
+	}
+}
+
+static VkSampleCountFlagBits
+get_num_samples(uint32_t num_samples)
+{
+	switch(num_samples) {
+	case 64:
+		return VK_SAMPLE_COUNT_64_BIT;
+	case 32:
+		return VK_SAMPLE_COUNT_32_BIT;
+	case 16:
+		return VK_SAMPLE_COUNT_16_BIT;
+	case 8:
+		return VK_SAMPLE_COUNT_8_BIT;
+	case 4:
+		return VK_SAMPLE_COUNT_4_BIT;
+	case 2:
+		return VK_SAMPLE_COUNT_2_BIT;
+	case 1:
+		break;
+	default:
+		fprintf(stderr, "Invalid number of samples in VkSampleCountFlagBits. Using one sample.\n");
+		break;
+	}
+	return VK_SAMPLE_COUNT_1_BIT;
 }
 
 static bool
@@ -916,22 +2000,18 @@ alloc_image_memory(struct vk_ctx *ctx, struct vk_image_obj *img_obj)
 	mem_reqs2.pNext = &ded_reqs;
 
 	vkGetImageMemoryRequirements2(ctx->dev, &req_info2, &mem_reqs2);
-	img_obj->mobj.mem = alloc_memory(ctx,
-					 true,
-					 &mem_reqs2.memoryRequirements,
-					 ded_reqs.requiresDedicatedAllocation? img_obj->img : VK_NULL_HANDLE,
-					 VK_NULL_HANDLE,
-					 mem_reqs2.memoryRequirements.memoryTypeBits &
-					 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	img_obj->mobj.mem_sz = mem_reqs2.memoryRequirements.size;
-	img_obj->mobj.dedicated = ded_reqs.requiresDedicatedAllocation;
-	if (img_obj->mobj.mem == VK_NULL_HANDLE) {
+
+	/* exported: always a block of its own */
+	if (!mem_alloc(ctx, &mem_reqs2.memoryRequirements,
+		       0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		       true, false,
+		       ded_reqs.requiresDedicatedAllocation ? img_obj->img : VK_NULL_HANDLE,
+		       VK_NULL_HANDLE, &img_obj->mobj)) {
 		fprintf(stderr, "Failed to allocate image memory.\n");
 		return false;
 	}
 
-	if (vkBindImageMemory(ctx->dev, img_obj->img, img_obj->mobj.mem, 0) != VK_SUCCESS) {
+	if (vkBindImageMemory(ctx->dev, img_obj->img, img_obj->mobj.mem, img_obj->mobj.offset) != VK_SUCCESS) {
 		fprintf(stderr, "Failed to bind image memory.\n");
 		return false;
 	}
@@ -1047,7 +2127,7 @@ vk_init_ctx(struct vk_ctx *ctx, bool enable_validation)
 		goto fail;
 	}
 
-	if ((ctx->pdev = select_physical_device(ctx->inst)) == VK_NULL_HANDLE) {
+	if ((ctx->pdev = select_physical_device(ctx)) == VK_NULL_HANDLE) {
 		fprintf(stderr, "Failed to find suitable physical device.\n");
 		goto fail;
 	}
@@ -1058,6 +2138,7 @@ vk_init_ctx(struct vk_ctx *ctx, bool enable_validation)
 	}
 
 	fill_uuid(ctx->pdev, ctx->deviceUUID, ctx->driverUUID);
+	mem_init(ctx);
 	return true;
 
 fail:
@@ -1066,8 +2147,20 @@ fail:
 }
 
 bool
-vk_init_ctx_for_rendering(struct vk_ctx *ctx, bool enable_validation)
+vk_init_ctx_for_rendering(struct vk_ctx *ctx, bool enable_validation,
+			  uint32_t num_frames_in_flight)
 {
+	if (num_frames_in_flight < 1)
+		num_frames_in_flight = 1;
+
+	if (num_frames_in_flight > VK_MAX_FRAMES_IN_FLIGHT) {
+		fprintf(stderr, "Clamping frames-in-flight to %d.\n", VK_MAX_FRAMES_IN_FLIGHT);
+		num_frames_in_flight = VK_MAX_FRAMES_IN_FLIGHT;
+	}
+
+	ctx->num_frames_in_flight = num_frames_in_flight;
+	ctx->frame_idx = 0;
+
 	if (!vk_init_ctx(ctx, enable_validation)) {
 		fprintf(stderr, "Failed to initialize Vulkan.\n");
 		return false;
@@ -1090,6 +2183,10 @@ vk_init_ctx_for_rendering(struct vk_ctx *ctx, bool enable_validation)
 		goto fail;
 	}
 
+	/* a missing pipeline cache only costs startup time */
+	if ((ctx->pipeline_cache = create_pipeline_cache(ctx)) == VK_NULL_HANDLE)
+		fprintf(stderr, "Failed to create pipeline cache.\n");
+
     VkFenceCreateInfo fence_info;
     memset(&fence_info, 0, sizeof fence_info);
     fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
@@ -1098,6 +2195,11 @@ vk_init_ctx_for_rendering(struct vk_ctx *ctx, bool enable_validation)
         goto fail;
     }
 
+	if (!create_frames(ctx)) {
+		fprintf(stderr, "Failed to create frames-in-flight ring.\n");
+		goto fail;
+	}
+
 	return true;
 
 fail:
@@ -1108,6 +2210,34 @@ fail:
 void
 vk_cleanup_ctx(struct vk_ctx *ctx)
 {
+	uint32_t i;
+
+	if (ctx->dev != VK_NULL_HANDLE)
+		vkDeviceWaitIdle(ctx->dev);
+
+	for (i = 0; i < VK_MAX_FRAMES_IN_FLIGHT; i++) {
+		struct vk_frame *frame = &ctx->frames[i];
+
+		vk_destroy_semaphores(ctx, &frame->semaphores);
+		memset(&frame->semaphores, 0, sizeof frame->semaphores);
+
+		if (frame->fence != VK_NULL_HANDLE) {
+			vkDestroyFence(ctx->dev, frame->fence, 0);
+			frame->fence = VK_NULL_HANDLE;
+		}
+
+		if (frame->cmd_buf != VK_NULL_HANDLE) {
+			vkFreeCommandBuffers(ctx->dev, ctx->cmd_pool, 1, &frame->cmd_buf);
+			frame->cmd_buf = VK_NULL_HANDLE;
+		}
+	}
+
+	if (ctx->pipeline_cache != VK_NULL_HANDLE) {
+		vk_save_pipeline_cache(ctx);
+		vkDestroyPipelineCache(ctx->dev, ctx->pipeline_cache, 0);
+		ctx->pipeline_cache = VK_NULL_HANDLE;
+	}
+
     if (ctx->fence != VK_NULL_HANDLE) {
         vkDestroyFence(ctx->dev, ctx->fence, 0);
         ctx->fence = VK_NULL_HANDLE;
@@ -1126,6 +2256,7 @@ vk_cleanup_ctx(struct vk_ctx *ctx)
 	}
 
 	if (ctx->dev != VK_NULL_HANDLE) {
+		mem_cleanup(ctx);
 		vkDestroyDevice(ctx->dev, 0);
 		ctx->dev = VK_NULL_HANDLE;
 	}
@@ -1137,8 +2268,72 @@ vk_cleanup_ctx(struct vk_ctx *ctx)
 }
 
 bool
-vk_create_ext_image(struct vk_ctx *ctx,
-		    struct vk_image_props *props, struct vk_image_obj *img)
+vk_save_pipeline_cache(struct vk_ctx *ctx)
+{
+	struct pipeline_cache_file_header hdr;
+	char *tmp_file = NULL;
+	void *data = NULL;
+	size_t data_size = 0;
+	FILE *fp = NULL;
+	bool ok = false;
+
+	if (ctx->pipeline_cache == VK_NULL_HANDLE || !ctx->pipeline_cache_file)
+		return false;
+
+	if (vkGetPipelineCacheData(ctx->dev, ctx->pipeline_cache,
+				   &data_size, NULL) != VK_SUCCESS ||
+	    data_size == 0)
+		return false;
+
+	if (!(data = malloc(data_size)))
+		return false;
+
+	if (vkGetPipelineCacheData(ctx->dev, ctx->pipeline_cache,
+				   &data_size, data) != VK_SUCCESS)
+		goto out;
+
+	memset(&hdr, 0, sizeof hdr);
+	hdr.magic = PIPELINE_CACHE_FILE_MAGIC;
+	hdr.version = VK_PIPELINE_CACHE_FILE_VERSION;
+	memcpy(hdr.deviceUUID, ctx->deviceUUID, VK_UUID_SIZE);
+	memcpy(hdr.driverUUID, ctx->driverUUID, VK_UUID_SIZE);
+	hdr.data_size = data_size;
+
+	/* write to a temporary file first, so that a crash never leaves a
+	 * truncated cache file behind */
+	if (!(tmp_file = (char *)malloc(strlen(ctx->pipeline_cache_file) + 5)))
+		goto out;
+	sprintf(tmp_file, "%s.tmp", ctx->pipeline_cache_file);
+
+	if (!(fp = fopen(tmp_file, "wb"))) {
+		fprintf(stderr, "Failed to create pipeline cache file %s.\n", tmp_file);
+		goto out;
+	}
+
+	ok = fwrite(&hdr, sizeof hdr, 1, fp) == 1 &&
+	     fwrite(data, 1, data_size, fp) == data_size;
+	ok = (fclose(fp) == 0) && ok;
+
+	if (ok) {
+		remove(ctx->pipeline_cache_file);
+		ok = rename(tmp_file, ctx->pipeline_cache_file) == 0;
+	}
+
+	if (!ok) {
+		fprintf(stderr, "Failed to write pipeline cache file %s.\n",
+			ctx->pipeline_cache_file);
+		remove(tmp_file);
+	}
+
+out:
+	free(tmp_file);
+	free(data);
+	return ok;
+}
+
+static bool
+create_ext_image_handle(struct vk_ctx *ctx,
+			struct vk_image_props *props, VkImage *img)
 {
 	VkExternalMemoryImageCreateInfo ext_img_info;
 	VkImageCreateInfo img_info;
@@ -1169,7 +2364,14 @@ vk_create_ext_image(struct vk_ctx *ctx,
 	 */
 	img_info.flags = VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT;
 
-	if (vkCreateImage(ctx->dev, &img_info, 0, &img->img) != VK_SUCCESS)
+	return vkCreateImage(ctx->dev, &img_info, 0, img) == VK_SUCCESS;
+}
+
+bool
+vk_create_ext_image(struct vk_ctx *ctx,
+		    struct vk_image_props *props, struct vk_image_obj *img)
+{
+	if (!create_ext_image_handle(ctx, props, &img->img))
 		goto fail;
 
 	if(!alloc_image_memory(ctx, img))
@@ -1185,6 +2387,65 @@ fail:
 	return false;
 }
 
+bool
+vk_create_transient_image(struct vk_ctx *ctx,
+			  struct vk_image_props *props,
+			  struct vk_image_obj *img)
+{
+	VkImageCreateInfo img_info;
+	VkImageFormatProperties fmt_props;
+	VkMemoryRequirements mem_reqs;
+	VkImageUsageFlags usage = get_aspect_from_depth_format(props->format) ?
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT :
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+	memset(&img_info, 0, sizeof img_info);
+	img_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	img_info.imageType = get_image_type(props->h, props->depth);
+	img_info.format = props->format;
+	img_info.extent.width = props->w;
+	img_info.extent.height = props->h;
+	img_info.extent.depth = props->depth;
+	img_info.mipLevels = 1;
+	img_info.arrayLayers = 1;
+	img_info.samples = get_num_samples(props->num_samples);
+	img_info.tiling = props->tiling;
+	img_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	img_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	/* transient: the implementation may back the image with lazily
+	 * allocated memory (tilers keep it in tile memory) */
+	img_info.usage = usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+	if (vkGetPhysicalDeviceImageFormatProperties(ctx->pdev, img_info.format,
+						     img_info.imageType, img_info.tiling,
+						     img_info.usage, 0, &fmt_props) != VK_SUCCESS ||
+	    !(fmt_props.sampleCounts & img_info.samples))
+		img_info.usage = usage;
+	props->usage = img_info.usage;
+
+	if (vkCreateImage(ctx->dev, &img_info, 0, &img->img) != VK_SUCCESS)
+		goto fail;
+
+	vkGetImageMemoryRequirements(ctx->dev, img->img, &mem_reqs);
+
+	if (!mem_alloc(ctx, &mem_reqs,
+		       0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+		       VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+		       false, false, VK_NULL_HANDLE, VK_NULL_HANDLE,
+		       &img->mobj))
+		goto fail;
+
+	if (vkBindImageMemory(ctx->dev, img->img, img->mobj.mem, img->mobj.offset) != VK_SUCCESS)
+		goto fail;
+
+	return true;
+
+fail:
+	fprintf(stderr, "Failed to create transient image.\n");
+	vk_destroy_ext_image(ctx, img);
+	return false;
+}
+
 bool
 vk_create_ext_buffer(struct vk_ctx *ctx,
 		     uint32_t sz,
@@ -1214,7 +2475,7 @@ vk_destroy_ext_image(struct vk_ctx *ctx, struct vk_image_obj *img_obj)
 	}
 
 	if (img_obj->mobj.mem != VK_NULL_HANDLE) {
-		vkFreeMemory(ctx->dev, img_obj->mobj.mem, 0);
+		mem_free(ctx, &img_obj->mobj);
 		img_obj->mobj.mem = VK_NULL_HANDLE;
 	}
 
@@ -1234,13 +2495,206 @@ vk_destroy_ext_bo(struct vk_ctx *ctx,
 	}
 
 	if (bo->mobj.mem != VK_NULL_HANDLE) {
-		vkFreeMemory(ctx->dev, bo->mobj.mem, 0);
+		mem_free(ctx, &bo->mobj);
 		bo->mobj.mem = VK_NULL_HANDLE;
 	}
 }
 
-bool
-vk_fill_ext_image_props(struct vk_ctx *ctx,
+/* reserves an aligned range for a resource with the given requirements,
+ * linear and optimal resources are kept bufferImageGranularity apart */
+static bool
+interop_alloc_reserve(struct vk_interop_alloc *alloc,
+		      const VkMemoryRequirements *reqs,
+		      bool is_linear,
+		      struct vk_mem_obj *mobj)
+{
+	VkDeviceSize alignment = reqs->alignment;
+
+	if (alloc->num_resources == VK_INTEROP_ALLOC_MAX_RESOURCES) {
+		fprintf(stderr, "Too many resources in the interop allocation.\n");
+		return false;
+	}
+
+	if (!(alloc->memory_type_bits & reqs->memoryTypeBits)) {
+		fprintf(stderr, "No memory type shared by all interop resources.\n");
+		return false;
+	}
+
+	if (alloc->num_resources > 0 && alloc->last_is_linear != is_linear &&
+	    alloc->granularity > alignment)
+		alignment = alloc->granularity;
+
+	mobj->mem = VK_NULL_HANDLE;
+	mobj->offset = (alloc->mobj.mem_sz + alignment - 1) / alignment * alignment;
+	mobj->mem_sz = reqs->size;
+	mobj->dedicated = false;
+	mobj->sub_allocated = true;
+	mobj->block = NULL;
+
+	alloc->mobj.mem_sz = mobj->offset + reqs->size;
+	alloc->memory_type_bits &= reqs->memoryTypeBits;
+	alloc->last_is_linear = is_linear;
+	alloc->resource_mobjs[alloc->num_resources++] = mobj;
+
+	return true;
+}
+
+void
+vk_interop_alloc_begin(struct vk_ctx *ctx,
+		       struct vk_interop_alloc *alloc)
+{
+	VkPhysicalDeviceProperties pdev_props;
+
+	vkGetPhysicalDeviceProperties(ctx->pdev, &pdev_props);
+
+	memset(alloc, 0, sizeof *alloc);
+	alloc->memory_type_bits = UINT32_MAX;
+	alloc->granularity = pdev_props.limits.bufferImageGranularity;
+}
+
+bool
+vk_interop_alloc_image(struct vk_ctx *ctx,
+		       struct vk_interop_alloc *alloc,
+		       struct vk_image_props *props,
+		       struct vk_image_obj *img)
+{
+	VkMemoryDedicatedRequirements ded_reqs;
+	VkImageMemoryRequirementsInfo2 req_info2;
+	VkMemoryRequirements2 mem_reqs2;
+
+	memset(img, 0, sizeof *img);
+
+	if (!create_ext_image_handle(ctx, props, &img->img)) {
+		fprintf(stderr, "Failed to create external image.\n");
+		return false;
+	}
+
+	memset(&ded_reqs, 0, sizeof ded_reqs);
+	ded_reqs.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+	memset(&req_info2, 0, sizeof req_info2);
+	req_info2.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+	req_info2.image = img->img;
+
+	memset(&mem_reqs2, 0, sizeof mem_reqs2);
+	mem_reqs2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	mem_reqs2.pNext = &ded_reqs;
+
+	vkGetImageMemoryRequirements2(ctx->dev, &req_info2, &mem_reqs2);
+
+	if (ded_reqs.requiresDedicatedAllocation) {
+		fprintf(stderr, "The image requires a dedicated allocation.\n");
+		goto fail;
+	}
+
+	if (!interop_alloc_reserve(alloc, &mem_reqs2.memoryRequirements,
+				   props->tiling == VK_IMAGE_TILING_LINEAR,
+				   &img->mobj))
+		goto fail;
+
+	alloc->images[alloc->num_resources - 1] = img->img;
+	return true;
+
+fail:
+	vkDestroyImage(ctx->dev, img->img, 0);
+	img->img = VK_NULL_HANDLE;
+	return false;
+}
+
+bool
+vk_interop_alloc_buffer(struct vk_ctx *ctx,
+			struct vk_interop_alloc *alloc,
+			uint32_t sz,
+			VkBufferUsageFlags usage,
+			struct vk_buf *bo)
+{
+	VkExternalMemoryBufferCreateInfo ext_bo_info;
+	VkBufferCreateInfo buf_info;
+	VkMemoryRequirements mem_reqs;
+
+	memset(bo, 0, sizeof *bo);
+
+	memset(&ext_bo_info, 0, sizeof ext_bo_info);
+	ext_bo_info.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+	ext_bo_info.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_BIT;
+
+	memset(&buf_info, 0, sizeof buf_info);
+	buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buf_info.pNext = &ext_bo_info;
+	buf_info.size = sz;
+	buf_info.usage = usage;
+	buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(ctx->dev, &buf_info, 0, &bo->buf) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to create external buffer.\n");
+		return false;
+	}
+
+	vkGetBufferMemoryRequirements(ctx->dev, bo->buf, &mem_reqs);
+
+	if (!interop_alloc_reserve(alloc, &mem_reqs, true, &bo->mobj)) {
+		vkDestroyBuffer(ctx->dev, bo->buf, 0);
+		bo->buf = VK_NULL_HANDLE;
+		return false;
+	}
+
+	/* the buffer size, not the (aligned) size of its memory range */
+	bo->mobj.mem_sz = sz;
+	alloc->bufs[alloc->num_resources - 1] = bo->buf;
+	return true;
+}
+
+bool
+vk_interop_alloc_finish(struct vk_ctx *ctx,
+			struct vk_interop_alloc *alloc)
+{
+	VkMemoryRequirements mem_reqs;
+	uint32_t i;
+
+	if (alloc->num_resources == 0)
+		return false;
+
+	memset(&mem_reqs, 0, sizeof mem_reqs);
+	mem_reqs.size = alloc->mobj.mem_sz;
+	mem_reqs.memoryTypeBits = alloc->memory_type_bits;
+
+	if (!mem_alloc(ctx, &mem_reqs, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		       true, false, VK_NULL_HANDLE, VK_NULL_HANDLE, &alloc->mobj)) {
+		fprintf(stderr, "Failed to allocate interop memory.\n");
+		return false;
+	}
+
+	for (i = 0; i < alloc->num_resources; i++) {
+		struct vk_mem_obj *mobj = alloc->resource_mobjs[i];
+		VkResult res = alloc->images[i] != VK_NULL_HANDLE ?
+			vkBindImageMemory(ctx->dev, alloc->images[i],
+					  alloc->mobj.mem, mobj->offset) :
+			vkBindBufferMemory(ctx->dev, alloc->bufs[i],
+					   alloc->mobj.mem, mobj->offset);
+
+		if (res != VK_SUCCESS) {
+			fprintf(stderr, "Failed to bind interop memory.\n");
+			return false;
+		}
+		mobj->mem = alloc->mobj.mem;
+	}
+
+	return true;
+}
+
+void
+vk_interop_alloc_destroy(struct vk_ctx *ctx,
+			 struct vk_interop_alloc *alloc)
+{
+	if (alloc->mobj.mem != VK_NULL_HANDLE)
+		mem_free(ctx, &alloc->mobj);
+
+	alloc->mobj.mem_sz = 0;
+	alloc->num_resources = 0;
+}
+
+bool
+vk_fill_ext_image_props(struct vk_ctx *ctx,
 			uint32_t w,
 			uint32_t h,
 			uint32_t d,
@@ -1276,23 +2730,32 @@ vk_fill_ext_image_props(struct vk_ctx *ctx,
 	return true;
 }
 
-bool
-vk_create_renderer(struct vk_ctx *ctx,
-		   const char *vs_src,
-		   unsigned int vs_size,
-		   const char *fs_src,
-		   unsigned int fs_size,
-		   bool enable_depth,
-		   bool enable_stencil,
-		   struct vk_image_att *color_att,
-		   struct vk_image_att *depth_att,
-		   struct vk_vertex_info *vert_info,
-		   struct vk_renderer *renderer)
+static bool
+create_renderer(struct vk_ctx *ctx,
+		const char *vs_src,
+		unsigned int vs_size,
+		const char *fs_src,
+		unsigned int fs_size,
+		bool enable_depth,
+		bool enable_stencil,
+		struct vk_image_att *color_att,
+		struct vk_image_att *depth_att,
+		struct vk_image_att *resolve_color_att,
+		struct vk_image_att *resolve_depth_att,
+		struct vk_vertex_info *vert_info,
+		VkDescriptorType desc_type,
+		struct vk_renderer *renderer)
 {
 	memset(&renderer->vertex_info, 0, sizeof renderer->vertex_info);
 	if (vert_info)
 		renderer->vertex_info = *vert_info;
 
+	renderer->desc_type = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+	if (desc_type != VK_DESCRIPTOR_TYPE_MAX_ENUM) {
+		if (!create_descriptor_set(ctx, desc_type, renderer))
+			goto fail;
+	}
+
     {
         struct vk_image_props color_clear = color_att->props;
         struct vk_image_props depth_clear;
@@ -1301,18 +2764,33 @@ vk_create_renderer(struct vk_ctx *ctx,
         color_clear.in_layout = VK_IMAGE_LAYOUT_UNDEFINED;
         depth_clear.in_layout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-        renderer->clear_renderpass = create_renderpass(ctx, &color_clear, depth_att ? &depth_clear : NULL);
+        if (resolve_color_att) {
+            struct vk_image_props resolve_color_clear = resolve_color_att->props;
+            struct vk_image_props resolve_depth_clear = resolve_depth_att->props;
+
+            resolve_color_clear.in_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            resolve_depth_clear.in_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            renderer->clear_renderpass = create_resolve_renderpass(ctx, &color_clear, &depth_clear,
+                                                                   &resolve_color_clear, &resolve_depth_clear);
+        } else {
+            renderer->clear_renderpass = create_renderpass(ctx, &color_clear, depth_att ? &depth_clear : NULL);
+        }
         if (renderer->clear_renderpass == VK_NULL_HANDLE)
             goto fail;
     }
 
 	{
-        renderer->draw_renderpass = create_renderpass(ctx, &color_att->props, depth_att ? &depth_att->props : NULL);
+        if (resolve_color_att)
+            renderer->draw_renderpass = create_resolve_renderpass(ctx, &color_att->props, &depth_att->props,
+                                                                  &resolve_color_att->props, &resolve_depth_att->props);
+        else
+            renderer->draw_renderpass = create_renderpass(ctx, &color_att->props, depth_att ? &depth_att->props : NULL);
         if (renderer->draw_renderpass == VK_NULL_HANDLE)
             goto fail;
 	}
 
-	create_framebuffer(ctx, color_att, depth_att, renderer);
+	create_framebuffer(ctx, color_att, depth_att, resolve_color_att, resolve_depth_att, renderer);
 	if (renderer->fb == VK_NULL_HANDLE)
 		goto fail;
 
@@ -1338,6 +2816,70 @@ fail:
 	return false;
 }
 
+bool
+vk_create_renderer(struct vk_ctx *ctx,
+		   const char *vs_src,
+		   unsigned int vs_size,
+		   const char *fs_src,
+		   unsigned int fs_size,
+		   bool enable_depth,
+		   bool enable_stencil,
+		   struct vk_image_att *color_att,
+		   struct vk_image_att *depth_att,
+		   struct vk_vertex_info *vert_info,
+		   VkDescriptorType desc_type,
+		   struct vk_renderer *renderer)
+{
+	return create_renderer(ctx, vs_src, vs_size, fs_src, fs_size,
+			       enable_depth, enable_stencil,
+			       color_att, depth_att, NULL, NULL,
+			       vert_info, desc_type, renderer);
+}
+
+bool
+vk_create_resolve_renderer(struct vk_ctx *ctx,
+			   const char *vs_src,
+			   unsigned int vs_size,
+			   const char *fs_src,
+			   unsigned int fs_size,
+			   bool enable_stencil,
+			   struct vk_image_att *color_att,
+			   struct vk_image_att *depth_att,
+			   struct vk_image_att *resolve_color_att,
+			   struct vk_image_att *resolve_depth_att,
+			   struct vk_vertex_info *vert_info,
+			   VkDescriptorType desc_type,
+			   struct vk_renderer *renderer)
+{
+	if (!ctx->has_depth_stencil_resolve) {
+		fprintf(stderr, "VK_KHR_depth_stencil_resolve is not supported.\n");
+		return false;
+	}
+
+	return create_renderer(ctx, vs_src, vs_size, fs_src, fs_size,
+			       true, enable_stencil,
+			       color_att, depth_att,
+			       resolve_color_att, resolve_depth_att,
+			       vert_info, desc_type, renderer);
+}
+
+bool
+vk_recreate_framebuffer(struct vk_ctx *ctx,
+			struct vk_image_att *color_att,
+			struct vk_image_att *depth_att,
+			struct vk_image_att *resolve_color_att,
+			struct vk_image_att *resolve_depth_att,
+			struct vk_renderer *renderer)
+{
+	if (renderer->fb != VK_NULL_HANDLE) {
+		vkDestroyFramebuffer(ctx->dev, renderer->fb, 0);
+		renderer->fb = VK_NULL_HANDLE;
+	}
+
+	create_framebuffer(ctx, color_att, depth_att, resolve_color_att, resolve_depth_att, renderer);
+	return renderer->fb != VK_NULL_HANDLE;
+}
+
 void
 vk_destroy_renderer(struct vk_ctx *ctx,
 		    struct vk_renderer *renderer)
@@ -1376,20 +2918,98 @@ vk_destroy_renderer(struct vk_ctx *ctx,
 		vkDestroyPipelineLayout(ctx->dev, renderer->pipeline_layout, 0);
 		renderer->pipeline_layout = VK_NULL_HANDLE;
 	}
+
+	/* destroying the pool frees the descriptor set */
+	if (renderer->desc_pool != VK_NULL_HANDLE) {
+		vkDestroyDescriptorPool(ctx->dev, renderer->desc_pool, 0);
+		renderer->desc_pool = VK_NULL_HANDLE;
+		renderer->desc_set = VK_NULL_HANDLE;
+	}
+
+	if (renderer->desc_set_layout != VK_NULL_HANDLE) {
+		vkDestroyDescriptorSetLayout(ctx->dev, renderer->desc_set_layout, 0);
+		renderer->desc_set_layout = VK_NULL_HANDLE;
+	}
+}
+
+void
+vk_update_renderer_descriptor(struct vk_ctx *ctx,
+			      struct vk_renderer *renderer,
+			      struct vk_buf *bo,
+			      VkDeviceSize range)
+{
+	VkDescriptorBufferInfo buf_info;
+	VkWriteDescriptorSet write;
+
+	assert(renderer->desc_set != VK_NULL_HANDLE);
+
+	memset(&buf_info, 0, sizeof buf_info);
+	buf_info.buffer = bo->buf;
+	buf_info.offset = 0;
+	buf_info.range = range;
+
+	memset(&write, 0, sizeof write);
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = renderer->desc_set;
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = renderer->desc_type;
+	write.pBufferInfo = &buf_info;
+
+	vkUpdateDescriptorSets(ctx->dev, 1, &write, 0, NULL);
 }
 
 bool
-vk_create_buffer(struct vk_ctx *ctx,
-		 bool is_external,
-		 uint32_t sz,
-		 VkBufferUsageFlagBits usage,
-		 void *pnext,
-		 struct vk_buf *bo)
+vk_replace_renderer_descriptor(struct vk_ctx *ctx,
+			       struct vk_renderer *renderer,
+			       struct vk_buf *bo,
+			       VkDeviceSize range,
+			       VkDescriptorPool *old_pool)
+{
+	VkDescriptorPool desc_pool;
+	VkDescriptorSet desc_set;
+
+	assert(renderer->desc_set_layout != VK_NULL_HANDLE);
+
+	if (!allocate_descriptor_set(ctx, renderer, &desc_pool, &desc_set))
+		return false;
+
+	*old_pool = renderer->desc_pool;
+	renderer->desc_pool = desc_pool;
+	renderer->desc_set = desc_set;
+	vk_update_renderer_descriptor(ctx, renderer, bo, range);
+
+	return true;
+}
+
+void
+vk_destroy_descriptor_pool(struct vk_ctx *ctx,
+			   VkDescriptorPool *pool)
+{
+	if (*pool != VK_NULL_HANDLE) {
+		vkDestroyDescriptorPool(ctx->dev, *pool, 0);
+		*pool = VK_NULL_HANDLE;
+	}
+}
+
+static bool
+create_buffer(struct vk_ctx *ctx,
+	      bool is_external,
+	      VkDeviceSize sz,
+	      VkBufferUsageFlags usage,
+	      void *pnext,
+	      VkMemoryPropertyFlags required,
+	      VkMemoryPropertyFlags preferred,
+	      struct vk_buf *bo)
 {
 	VkBufferCreateInfo buf_info;
 	VkMemoryRequirements mem_reqs;
 
 	bo->mobj.mem = VK_NULL_HANDLE;
+	bo->mobj.offset = 0;
+	bo->mobj.dedicated = false;
+	bo->mobj.sub_allocated = false;
+	bo->mobj.block = NULL;
 	bo->buf = VK_NULL_HANDLE;
 
 	/* VkBufferCreateInfo */
@@ -1405,21 +3025,13 @@ vk_create_buffer(struct vk_ctx *ctx,
 
 	/* allocate buffer */
 	vkGetBufferMemoryRequirements(ctx->dev, bo->buf, &mem_reqs);
-	/* VK_MEMORY_PROPERTY_HOST_COHERENT_BIT bit specifies that the
-	 * host cache management commands vkFlushMappedMemoryRanges and
-	 * vkInvalidateMappedMemoryRanges are not needed to flush host
-	 * writes to the device or make device writes visible to the
-	 * host, respectively. */
-	bo->mobj.mem = alloc_memory(ctx, is_external, &mem_reqs, VK_NULL_HANDLE, VK_NULL_HANDLE,
-				    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
-				    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-
-	if (bo->mobj.mem == VK_NULL_HANDLE)
+	if (!mem_alloc(ctx, &mem_reqs, required, preferred,
+		       is_external, true, VK_NULL_HANDLE, VK_NULL_HANDLE, &bo->mobj))
 		goto fail;
 
-	bo->mobj.mem_sz = sz;
-
-	if (vkBindBufferMemory(ctx->dev, bo->buf, bo->mobj.mem, 0) != VK_SUCCESS) {
+	/* mem_sz: the whole allocation of an exported buffer (a block of its
+	 * own), GL imports it with this size */
+	if (vkBindBufferMemory(ctx->dev, bo->buf, bo->mobj.mem, bo->mobj.offset) != VK_SUCCESS) {
 		fprintf(stderr, "Failed to bind buffer memory.\n");
 		goto fail;
 	}
@@ -1432,6 +3044,54 @@ fail:
 	return false;
 }
 
+bool
+vk_create_buffer(struct vk_ctx *ctx,
+		 bool is_external,
+		 uint32_t sz,
+		 VkBufferUsageFlagBits usage,
+		 void *pnext,
+		 struct vk_buf *bo)
+{
+	/* VK_MEMORY_PROPERTY_HOST_COHERENT_BIT bit specifies that the
+	 * host cache management commands vkFlushMappedMemoryRanges and
+	 * vkInvalidateMappedMemoryRanges are not needed to flush host
+	 * writes to the device or make device writes visible to the
+	 * host, respectively. DEVICE_LOCAL is preferred (integrated GPUs,
+	 * resizable BAR) as long as its heap has room in the budget. */
+	return create_buffer(ctx, is_external, sz, usage, pnext,
+			     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+			     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, bo);
+}
+
+bool
+vk_create_device_buffer(struct vk_ctx *ctx,
+			VkDeviceSize sz,
+			VkBufferUsageFlags usage,
+			struct vk_buf *bo)
+{
+	return create_buffer(ctx, false, sz,
+			     usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, NULL,
+			     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, bo);
+}
+
+bool
+vk_has_host_invisible_vram(struct vk_ctx *ctx)
+{
+	const VkPhysicalDeviceMemoryProperties *props = &ctx->mem.props;
+	uint32_t i;
+
+	for (i = 0; i < props->memoryTypeCount; i++) {
+		VkMemoryPropertyFlags flags = props->memoryTypes[i].propertyFlags;
+
+		if ((flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) &&
+		    !(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+			return true;
+	}
+
+	return false;
+}
+
 bool
 vk_update_buffer_data(struct vk_ctx *ctx,
 		      void *data,
@@ -1440,14 +3100,10 @@ vk_update_buffer_data(struct vk_ctx *ctx,
 {
 	void *map;
 
-	if (vkMapMemory(ctx->dev, bo->mobj.mem, 0, data_sz, 0, &map) != VK_SUCCESS) {
-		fprintf(stderr, "Failed to map buffer memory.\n");
+	if (!vk_map_buffer(ctx, bo, &map))
 		goto fail;
-	}
 
 	memcpy(map, data, data_sz);
-
-	vkUnmapMemory(ctx->dev, bo->mobj.mem);
 	return true;
 
 fail:
@@ -1457,6 +3113,21 @@ fail:
 	return false;
 }
 
+bool
+vk_map_buffer(struct vk_ctx *ctx,
+	      struct vk_buf *bo,
+	      void **map)
+{
+	if (!bo->mobj.block || !bo->mobj.block->map) {
+		fprintf(stderr, "Failed to map buffer memory.\n");
+		*map = NULL;
+		return false;
+	}
+
+	*map = (uint8_t *)bo->mobj.block->map + bo->mobj.offset;
+	return true;
+}
+
 void
 vk_destroy_buffer(struct vk_ctx *ctx,
 		  struct vk_buf *bo)
@@ -1465,53 +3136,622 @@ vk_destroy_buffer(struct vk_ctx *ctx,
 		vkDestroyBuffer(ctx->dev, bo->buf, 0);
 
 	if (bo->mobj.mem != VK_NULL_HANDLE)
-		vkFreeMemory(ctx->dev, bo->mobj.mem, 0);
+		mem_free(ctx, &bo->mobj);
 
 	bo->mobj.mem_sz = 0;
 	bo->buf = VK_NULL_HANDLE;
 	bo->mobj.mem = VK_NULL_HANDLE;
 }
 
-void
-vk_draw(struct vk_ctx *ctx,
-	struct vk_buf *vbo,
-	struct vk_renderer *renderer,
-	float *vk_fb_color,
-	uint32_t vk_fb_color_count,
-	struct vk_semaphores *semaphores,
-	bool has_wait, bool has_signal,
-	struct vk_image_att *attachments,
-	uint32_t n_attachments,
-	struct vk_push_constants *push_constants,
-	float x, float y,
-	float w, float h)
+bool
+vk_create_staging_ring(struct vk_ctx *ctx,
+		       VkDeviceSize size,
+		       struct vk_staging_ring *ring)
+{
+	void *map;
+
+	memset(ring, 0, sizeof *ring);
+
+	size = (size + VK_STAGING_MAX_ALIGNMENT - 1) / VK_STAGING_MAX_ALIGNMENT *
+	       VK_STAGING_MAX_ALIGNMENT;
+
+	/* plain host memory: the GPU reads every byte exactly once, in the
+	 * copy, a device-local (BAR) heap is better left to other buffers */
+	if (!create_buffer(ctx, false, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, NULL,
+			   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+			   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, 0, &ring->bo))
+		return false;
+
+	if (!vk_map_buffer(ctx, &ring->bo, &map)) {
+		vk_destroy_buffer(ctx, &ring->bo);
+		return false;
+	}
+
+	ring->map = (uint8_t *)map;
+	ring->size = size;
+	return true;
+}
+
+void
+vk_destroy_staging_ring(struct vk_ctx *ctx,
+			struct vk_staging_ring *ring)
+{
+	vk_destroy_buffer(ctx, &ring->bo);
+	memset(ring, 0, sizeof *ring);
+}
+
+void
+vk_staging_ring_begin_frame(struct vk_staging_ring *ring,
+			    uint32_t slot)
+{
+	/* the slot's previous submission (and all earlier ones) is done, so
+	 * is everything written before its end */
+	if (ring->slot_end[slot] > ring->tail)
+		ring->tail = ring->slot_end[slot];
+
+	ring->slot = slot;
+	ring->slot_end[slot] = ring->head;
+}
+
+void *
+vk_staging_ring_alloc(struct vk_staging_ring *ring,
+		      VkDeviceSize size,
+		      VkDeviceSize alignment,
+		      VkDeviceSize *offset)
+{
+	VkDeviceSize pos, off;
+
+	assert(alignment > 0 && alignment <= VK_STAGING_MAX_ALIGNMENT &&
+	       (alignment & (alignment - 1)) == 0);
+
+	if (!ring->map)
+		return NULL;
+
+	pos = (ring->head + alignment - 1) & ~(alignment - 1);
+	off = pos % ring->size;
+
+	/* an allocation never wraps around, the rest of the ring is skipped */
+	if (off + size > ring->size) {
+		pos += ring->size - off;
+		off = 0;
+	}
+
+	if (pos + size - ring->tail > ring->size)
+		return NULL;
+
+	ring->head = pos + size;
+	ring->slot_end[ring->slot] = ring->head;
+
+	*offset = off;
+	return ring->map + off;
+}
+
+void
+vk_record_upload(VkCommandBuffer cmd_buf,
+		 struct vk_staging_ring *ring,
+		 VkDeviceSize src_offset,
+		 struct vk_buf *dst,
+		 VkDeviceSize dst_offset,
+		 VkDeviceSize size)
+{
+	vk_record_copy_buffer(cmd_buf, &ring->bo, src_offset, dst, dst_offset, size);
+}
+
+void
+vk_record_copy_buffer(VkCommandBuffer cmd_buf,
+		      struct vk_buf *src,
+		      VkDeviceSize src_offset,
+		      struct vk_buf *dst,
+		      VkDeviceSize dst_offset,
+		      VkDeviceSize size)
+{
+	VkBufferCopy region;
+
+	region.srcOffset = src_offset;
+	region.dstOffset = dst_offset;
+	region.size = size;
+
+	vkCmdCopyBuffer(cmd_buf, src->buf, dst->buf, 1, &region);
+}
+
+void
+vk_record_upload_barrier(VkCommandBuffer cmd_buf)
+{
+	VkMemoryBarrier barrier;
+
+	memset(&barrier, 0, sizeof barrier);
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT |
+				VK_ACCESS_UNIFORM_READ_BIT |
+				VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+
+	vkCmdPipelineBarrier(cmd_buf,
+			     VK_PIPELINE_STAGE_TRANSFER_BIT,
+			     VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+			     VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+			     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			     0, 1, &barrier, 0, NULL, 0, NULL);
+}
+
+bool
+vk_create_timestamps(struct vk_ctx *ctx,
+		     uint32_t count,
+		     struct vk_timestamps *ts)
+{
+	VkPhysicalDeviceProperties pdev_props;
+	VkQueueFamilyProperties *fam_props;
+	VkQueryPoolCreateInfo pool_info;
+	uint32_t prop_count = 0;
+	uint32_t valid_bits = 0;
+
+	memset(ts, 0, sizeof *ts);
+
+	vkGetPhysicalDeviceQueueFamilyProperties(ctx->pdev, &prop_count, NULL);
+	fam_props = (VkQueueFamilyProperties*)malloc(prop_count * sizeof *fam_props);
+	if (!fam_props)
+		return false;
+	vkGetPhysicalDeviceQueueFamilyProperties(ctx->pdev, &prop_count, fam_props);
+	if ((uint32_t)ctx->qfam_idx < prop_count)
+		valid_bits = fam_props[ctx->qfam_idx].timestampValidBits;
+	free(fam_props);
+
+	if (valid_bits == 0) {
+		fprintf(stderr, "Timestamp queries are not supported by the queue.\n");
+		return false;
+	}
+
+	vkGetPhysicalDeviceProperties(ctx->pdev, &pdev_props);
+	ts->ns_per_tick = pdev_props.limits.timestampPeriod;
+	ts->valid_mask = valid_bits >= 64 ? ~(uint64_t)0 : (((uint64_t)1 << valid_bits) - 1);
+
+	memset(&pool_info, 0, sizeof pool_info);
+	pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	pool_info.queryCount = count;
+
+	if (vkCreateQueryPool(ctx->dev, &pool_info, 0, &ts->pool) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to create timestamp query pool.\n");
+		ts->pool = VK_NULL_HANDLE;
+		return false;
+	}
+
+	ts->count = count;
+	return true;
+}
+
+void
+vk_destroy_timestamps(struct vk_ctx *ctx,
+		      struct vk_timestamps *ts)
+{
+	if (ts->pool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(ctx->dev, ts->pool, 0);
+
+	memset(ts, 0, sizeof *ts);
+}
+
+void
+vk_record_reset_timestamps(VkCommandBuffer cmd_buf,
+			   struct vk_timestamps *ts,
+			   uint32_t first,
+			   uint32_t count)
+{
+	vkCmdResetQueryPool(cmd_buf, ts->pool, first, count);
+}
+
+void
+vk_record_timestamp(VkCommandBuffer cmd_buf,
+		    struct vk_timestamps *ts,
+		    uint32_t idx)
+{
+	/* the timestamp is written once all previous commands completed */
+	vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			    ts->pool, idx);
+}
+
+bool
+vk_get_timestamps_ns(struct vk_ctx *ctx,
+		     struct vk_timestamps *ts,
+		     uint32_t first,
+		     uint32_t count,
+		     uint64_t *ns)
+{
+	uint32_t i;
+
+	/* never waits: VK_NOT_READY is returned for pending queries */
+	if (vkGetQueryPoolResults(ctx->dev, ts->pool, first, count,
+				  count * sizeof(uint64_t), ns, sizeof(uint64_t),
+				  VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+		return false;
+
+	for (i = 0; i < count; i++)
+		ns[i] = (uint64_t)((double)(ns[i] & ts->valid_mask) * ts->ns_per_tick);
+
+	return true;
+}
+
+static bool
+wait_timeline(struct vk_ctx *ctx, uint64_t value)
+{
+	VkSemaphoreWaitInfoKHR wait_info;
+
+	memset(&wait_info, 0, sizeof wait_info);
+	wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+	wait_info.semaphoreCount = 1;
+	wait_info.pSemaphores = &ctx->timeline;
+	wait_info.pValues = &value;
+
+	return pfn_vkWaitSemaphoresKHR(ctx->dev, &wait_info, UINT64_MAX) == VK_SUCCESS;
+}
+
+static bool
+signal_timeline(struct vk_ctx *ctx, uint64_t value)
+{
+	VkSemaphoreSignalInfoKHR signal_info;
+
+	memset(&signal_info, 0, sizeof signal_info);
+	signal_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO_KHR;
+	signal_info.semaphore = ctx->timeline;
+	signal_info.value = value;
+
+	return pfn_vkSignalSemaphoreKHR(ctx->dev, &signal_info) == VK_SUCCESS;
+}
+
+static bool
+wait_frame(struct vk_ctx *ctx, struct vk_frame *frame)
+{
+	if (frame->timeline_value)
+		return wait_timeline(ctx, frame->timeline_value);
+
+	/* a failed submission reset the fence, nothing will signal it */
+	if (!frame->fence_submitted)
+		return true;
+
+	return vkWaitForFences(ctx->dev, 1, &frame->fence, true, UINT64_MAX) == VK_SUCCESS;
+}
+
+struct vk_frame *
+vk_acquire_frame(struct vk_ctx *ctx)
+{
+	struct vk_frame *frame = &ctx->frames[ctx->frame_idx];
+
+	/* Only blocks when the ring wrapped around and the GPU has
+	 * not finished the previous submission of this slot yet. */
+	if (!wait_frame(ctx, frame)) {
+		fprintf(stderr, "Failed to wait for fences.\n");
+		return NULL;
+	}
+
+	return frame;
+}
+
+bool
+vk_submit_frame(struct vk_ctx *ctx,
+		struct vk_frame *frame,
+		const VkSubmitInfo *submit_info)
+{
+	uint32_t slot = (uint32_t)(frame - ctx->frames);
+
+	if (vkResetFences(ctx->dev, 1, &frame->fence) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to reset fences.\n");
+		return false;
+	}
+
+	/* Nothing will signal the reset fence if the submission fails:
+	 * the next vk_acquire_frame() of this slot must not wait for it. */
+	frame->timeline_value = 0;
+	frame->fence_submitted = false;
+
+	if (vkQueueSubmit(ctx->queue, 1, submit_info, frame->fence) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to submit queue.\n");
+		return false;
+	}
+
+	frame->fence_submitted = true;
+	ctx->frame_idx = (slot + 1) % ctx->num_frames_in_flight;
+
+	/* A single-slot ring keeps the old wait-per-submit behaviour. */
+	if (ctx->num_frames_in_flight == 1) {
+		if (vkWaitForFences(ctx->dev, 1, &frame->fence, true, UINT64_MAX) != VK_SUCCESS) {
+			fprintf(stderr, "Failed to wait for fences.\n");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void
+vk_wait_frames_idle(struct vk_ctx *ctx)
+{
+	uint32_t i;
+
+	for (i = 0; i < ctx->num_frames_in_flight; i++) {
+		if (ctx->frames[i].fence == VK_NULL_HANDLE)
+			continue;
+
+		if (!wait_frame(ctx, &ctx->frames[i])) {
+			fprintf(stderr, "Failed to wait for fences.\n");
+		}
+	}
+}
+
+bool
+vk_submit_cmd_bufs(struct vk_ctx *ctx,
+		   struct vk_frame *frame,
+		   const VkCommandBuffer *cmd_bufs,
+		   uint32_t n_cmd_bufs,
+		   struct vk_semaphores *semaphores,
+		   bool has_wait, bool has_signal)
 {
-	VkCommandBufferBeginInfo cmd_begin_info;
-	VkRenderPassBeginInfo rp_begin_info;
-	VkRect2D rp_area;
-	VkClearValue clear_values[2];
 	VkSubmitInfo submit_info;
-	VkDeviceSize offsets[] = {0};
 	VkPipelineStageFlags stage_flags;
 
-	assert(vk_fb_color_count == 4);
 	if (has_wait)
 		assert(semaphores->gl_frame_done);
 	if (has_signal)
 		assert(semaphores->vk_frame_ready);
 
+	/* VkSubmitInfo */
+	stage_flags = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
+
+	memset(&submit_info, 0, sizeof submit_info);
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = n_cmd_bufs;
+	submit_info.pCommandBuffers = cmd_bufs;
+	if (has_wait) {
+		submit_info.pWaitDstStageMask = &stage_flags;
+		submit_info.waitSemaphoreCount = 1;
+		submit_info.pWaitSemaphores = &semaphores->gl_frame_done;
+	}
+
+	if (has_signal) {
+		submit_info.signalSemaphoreCount = 1;
+		submit_info.pSignalSemaphores = &semaphores->vk_frame_ready;
+	}
+
+	return vk_submit_frame(ctx, frame, &submit_info);
+}
+
+bool
+vk_submit_cmd_bufs_timeline(struct vk_ctx *ctx,
+			    struct vk_frame *frame,
+			    const VkCommandBuffer *cmd_bufs,
+			    uint32_t n_cmd_bufs,
+			    struct vk_timeline *timeline,
+			    uint64_t wait_gl_value,
+			    uint64_t signal_value)
+{
+	VkSubmitInfo submit_info;
+	VkTimelineSemaphoreSubmitInfoKHR tl_info;
+	VkPipelineStageFlags stage_flags;
+	uint32_t slot = (uint32_t)(frame - ctx->frames);
+	bool submitted = true;
+
+	if (!signal_value)
+		signal_value = timeline->vk_value + 1;
+
+	assert(ctx->timeline == timeline->vk_frame_ready);
+	assert(signal_value > timeline->vk_value);
+
+	stage_flags = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
+
+	memset(&tl_info, 0, sizeof tl_info);
+	tl_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+	tl_info.signalSemaphoreValueCount = 1;
+	tl_info.pSignalSemaphoreValues = &signal_value;
+
+	memset(&submit_info, 0, sizeof submit_info);
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.pNext = &tl_info;
+	submit_info.commandBufferCount = n_cmd_bufs;
+	submit_info.pCommandBuffers = cmd_bufs;
+	submit_info.signalSemaphoreCount = 1;
+	submit_info.pSignalSemaphores = &timeline->vk_frame_ready;
+
+	if (wait_gl_value) {
+		tl_info.waitSemaphoreValueCount = 1;
+		tl_info.pWaitSemaphoreValues = &wait_gl_value;
+
+		submit_info.pWaitDstStageMask = &stage_flags;
+		submit_info.waitSemaphoreCount = 1;
+		submit_info.pWaitSemaphores = &timeline->gl_frame_done;
+	}
+
+	/* no fence: the slot is free again once the timeline reached
+	 * signal_value, see wait_frame() */
+	if (vkQueueSubmit(ctx->queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to submit queue.\n");
+		submitted = false;
+
+		/* GL may already wait for signal_value */
+		if (!vk_signal_timeline(ctx, timeline, signal_value))
+			return false;
+	}
+
+	timeline->vk_value = signal_value;
+	frame->timeline_value = signal_value;
+	ctx->frame_idx = (slot + 1) % ctx->num_frames_in_flight;
+
+	/* A single-slot ring keeps the old wait-per-submit behaviour. */
+	if (ctx->num_frames_in_flight == 1) {
+		if (!wait_timeline(ctx, signal_value)) {
+			fprintf(stderr, "Failed to wait for timeline semaphore.\n");
+			return false;
+		}
+	}
+
+	return submitted;
+}
+
+bool
+vk_signal_timeline(struct vk_ctx *ctx,
+		   struct vk_timeline *timeline,
+		   uint64_t value)
+{
+	assert(ctx->timeline == timeline->vk_frame_ready);
+	assert(value > timeline->vk_value);
+
+	/* the pending submissions signal smaller values, they have to
+	 * execute first */
+	if (!wait_timeline(ctx, timeline->vk_value) ||
+	    !signal_timeline(ctx, value)) {
+		fprintf(stderr, "Failed to signal timeline semaphore.\n");
+		return false;
+	}
+
+	timeline->vk_value = value;
+	return true;
+}
+
+VkCommandBuffer
+vk_create_cmd_buf(struct vk_ctx *ctx)
+{
+	return create_cmd_buf(ctx->dev, ctx->cmd_pool);
+}
+
+void
+vk_destroy_cmd_buf(struct vk_ctx *ctx,
+		   VkCommandBuffer *cmd_buf)
+{
+	if (*cmd_buf != VK_NULL_HANDLE) {
+		vkFreeCommandBuffers(ctx->dev, ctx->cmd_pool, 1, cmd_buf);
+		*cmd_buf = VK_NULL_HANDLE;
+	}
+}
+
+VkCommandPool
+vk_create_cmd_pool(struct vk_ctx *ctx)
+{
+	return create_cmd_pool(ctx);
+}
+
+void
+vk_destroy_cmd_pool(struct vk_ctx *ctx,
+		    VkCommandPool *cmd_pool)
+{
+	if (*cmd_pool != VK_NULL_HANDLE) {
+		vkDestroyCommandPool(ctx->dev, *cmd_pool, 0);
+		*cmd_pool = VK_NULL_HANDLE;
+	}
+}
+
+bool
+vk_reset_cmd_pool(struct vk_ctx *ctx,
+		  VkCommandPool cmd_pool)
+{
+	if (vkResetCommandPool(ctx->dev, cmd_pool, 0) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to reset command pool.\n");
+		return false;
+	}
+
+	return true;
+}
+
+VkCommandBuffer
+vk_create_secondary_cmd_buf(struct vk_ctx *ctx,
+			    VkCommandPool cmd_pool)
+{
+	VkCommandBuffer cmd_buf;
+	VkCommandBufferAllocateInfo alloc_info;
+
+	memset(&alloc_info, 0, sizeof alloc_info);
+	alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+	alloc_info.commandBufferCount = 1;
+	alloc_info.commandPool = cmd_pool;
+
+	if (vkAllocateCommandBuffers(ctx->dev, &alloc_info, &cmd_buf) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	return cmd_buf;
+}
+
+bool
+vk_begin_secondary_cmd_buf(VkCommandBuffer cmd_buf,
+			   struct vk_renderer *renderer,
+			   float x, float y,
+			   float w, float h)
+{
+	VkCommandBufferInheritanceInfo inheritance_info;
+	VkCommandBufferBeginInfo cmd_begin_info;
+	VkViewport sec_viewport;
+	VkRect2D sec_scissor;
+
+	memset(&inheritance_info, 0, sizeof inheritance_info);
+	inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance_info.renderPass = renderer->draw_renderpass;
+	inheritance_info.subpass = 0;
+	inheritance_info.framebuffer = renderer->fb;
+
+	memset(&cmd_begin_info, 0, sizeof cmd_begin_info);
+	cmd_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmd_begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+			       VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	cmd_begin_info.pInheritanceInfo = &inheritance_info;
+
+	if (vkBeginCommandBuffer(cmd_buf, &cmd_begin_info) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to begin secondary command buffer.\n");
+		return false;
+	}
+
+	/* the dynamic state is not inherited from the primary command
+	 * buffer, and the global viewport of begin_renderpass() is not
+	 * safe to use from several recording threads */
+	memset(&sec_viewport, 0, sizeof sec_viewport);
+	sec_viewport.x = x;
+	sec_viewport.y = y;
+	sec_viewport.width = w;
+	sec_viewport.height = h;
+	sec_viewport.minDepth = 0;
+	sec_viewport.maxDepth = 1;
+
+	sec_scissor.offset.x = x;
+	sec_scissor.offset.y = y;
+	sec_scissor.extent.width = w;
+	sec_scissor.extent.height = h;
+
+	vkCmdSetViewport(cmd_buf, 0, 1, &sec_viewport);
+	vkCmdSetScissor(cmd_buf, 0, 1, &sec_scissor);
+
+	return true;
+}
+
+bool
+vk_begin_cmd_buf(VkCommandBuffer cmd_buf)
+{
+	VkCommandBufferBeginInfo cmd_begin_info;
+
 	/* VkCommandBufferBeginInfo */
 	memset(&cmd_begin_info, 0, sizeof cmd_begin_info);
 	cmd_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	/* pre-recorded command buffers may be pending in more than one
+	 * frame at a time */
 	cmd_begin_info.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
 
-	/* VkRect2D render area */
-	memset(&rp_area, 0, sizeof rp_area);
-	rp_area.extent.width = (uint32_t)w;
-	rp_area.extent.height = (uint32_t)h;
-	rp_area.offset.x = x;
-	rp_area.offset.y = y;
+	if (vkBeginCommandBuffer(cmd_buf, &cmd_begin_info) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to begin command buffer.\n");
+		return false;
+	}
+
+	return true;
+}
+
+bool
+vk_end_cmd_buf(VkCommandBuffer cmd_buf)
+{
+	if (vkEndCommandBuffer(cmd_buf) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to end command buffer.\n");
+		return false;
+	}
 
+	return true;
+}
+
+static void
+fill_clear_values(VkClearValue *clear_values,
+		  const float *vk_fb_color)
+{
 	/* VkClearValue */
 	memset(&clear_values[0], 0, sizeof clear_values[0]);
 	clear_values[0].color.float32[0] = vk_fb_color[0]; /* red */
@@ -1522,36 +3762,36 @@ vk_draw(struct vk_ctx *ctx,
 	memset(&clear_values[1], 0, sizeof clear_values[1]);
 	clear_values[1].depthStencil.depth = 1.0;
 	clear_values[1].depthStencil.stencil = 0;
+}
+
+static void
+begin_renderpass(VkCommandBuffer cmd_buf,
+		 VkRenderPass renderpass,
+		 VkFramebuffer fb,
+		 const VkClearValue *clear_values,
+		 float x, float y,
+		 float w, float h)
+{
+	VkRenderPassBeginInfo rp_begin_info;
+	VkRect2D rp_area;
+
+	/* VkRect2D render area */
+	memset(&rp_area, 0, sizeof rp_area);
+	rp_area.extent.width = (uint32_t)w;
+	rp_area.extent.height = (uint32_t)h;
+	rp_area.offset.x = x;
+	rp_area.offset.y = y;
 
 	/* VkRenderPassBeginInfo */
 	memset(&rp_begin_info, 0, sizeof rp_begin_info);
 	rp_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	rp_begin_info.renderPass = renderer->draw_renderpass;
-	rp_begin_info.framebuffer = renderer->fb;
+	rp_begin_info.renderPass = renderpass;
+	rp_begin_info.framebuffer = fb;
 	rp_begin_info.renderArea = rp_area;
 	rp_begin_info.clearValueCount = 2;
 	rp_begin_info.pClearValues = clear_values;
 
-	/* VkSubmitInfo */
-	stage_flags = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
-
-	memset(&submit_info, 0, sizeof submit_info);
-	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &ctx->cmd_buf;
-	if (has_wait) {
-		submit_info.pWaitDstStageMask = &stage_flags;
-		submit_info.waitSemaphoreCount = 1;
-		submit_info.pWaitSemaphores = &semaphores->gl_frame_done;
-	}
-
-	if (has_signal) {
-		submit_info.signalSemaphoreCount = 1;
-		submit_info.pSignalSemaphores = &semaphores->vk_frame_ready;
-	}
-
-	vkBeginCommandBuffer(ctx->cmd_buf, &cmd_begin_info);
-	vkCmdBeginRenderPass(ctx->cmd_buf, &rp_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBeginRenderPass(cmd_buf, &rp_begin_info, VK_SUBPASS_CONTENTS_INLINE);
 
 	viewport.x = x;
 	viewport.y = y;
@@ -1563,159 +3803,165 @@ vk_draw(struct vk_ctx *ctx,
 	scissor.extent.width = w;
 	scissor.extent.height = h;
 
-	vkCmdSetViewport(ctx->cmd_buf, 0, 1, &viewport);
-	vkCmdSetScissor(ctx->cmd_buf, 0, 1, &scissor);
-
-	vkCmdPushConstants(ctx->cmd_buf,
-			   renderer->pipeline_layout,
-			   VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-			   0, sizeof (struct vk_push_constants),
-			   push_constants);
-
-	if (vbo) {
-		vkCmdBindVertexBuffers(ctx->cmd_buf, 0, 1, &vbo->buf, offsets);
-	}
-	vkCmdBindPipeline(ctx->cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipeline);
-
-	int num_vertices = vbo ? renderer->vertex_info.num_verts : 36;
-	vkCmdDraw(ctx->cmd_buf, num_vertices, 1, 0, 0);
-
-	vkCmdEndRenderPass(ctx->cmd_buf);
-	if (attachments) {
-		VkImageMemoryBarrier *barriers =
-			(VkImageMemoryBarrier*)calloc(n_attachments, sizeof(VkImageMemoryBarrier));
-		VkImageMemoryBarrier *barrier = barriers;
-		for (uint32_t n = 0; n < n_attachments; n++, barrier++) {
-			struct vk_image_att *att = &attachments[n];
-			VkImageAspectFlags depth_stencil_flags =
-				get_aspect_from_depth_format(att->props.format);
-			bool is_depth = (depth_stencil_flags != 0);
-
-			/* Insert barrier to mark ownership transfer. */
-			barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			barrier->oldLayout = is_depth ?
-				VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL :
-				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-			barrier->newLayout = VK_IMAGE_LAYOUT_GENERAL;
-			barrier->srcAccessMask = get_access_mask(barrier->oldLayout);
-			barrier->dstAccessMask = get_access_mask(barrier->newLayout);
-			barrier->srcQueueFamilyIndex = ctx->qfam_idx;
-			barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
-			barrier->image = att->obj.img;
-			barrier->subresourceRange.aspectMask = is_depth ?
-				depth_stencil_flags :
-				VK_IMAGE_ASPECT_COLOR_BIT;
-			barrier->subresourceRange.baseMipLevel = 0;
-			barrier->subresourceRange.levelCount = 1;
-			barrier->subresourceRange.baseArrayLayer = 0;
-			barrier->subresourceRange.layerCount = 1;
-		}
-
-		vkCmdPipelineBarrier(ctx->cmd_buf,
-				     VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT,
-				     VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-				     0,
-				     0, NULL,
-				     0, NULL,
-				     n_attachments, barriers);
-		free(barriers);
-	}
-	vkEndCommandBuffer(ctx->cmd_buf);
-
-    if (vkQueueSubmit(ctx->queue, 1, &submit_info, ctx->fence) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to submit queue.\n");
-    }
-
-    if (vkWaitForFences(ctx->dev, 1, &ctx->fence, true, UINT64_MAX) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to wait for fences.\n");
-    }
-
-    if (vkResetFences(ctx->dev, 1, &ctx->fence) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to reset fences.\n");
-    }
-
-	/* FIXME */
-	if (!semaphores && !has_wait && !has_signal)
-		vkQueueWaitIdle(ctx->queue);
+	vkCmdSetViewport(cmd_buf, 0, 1, &viewport);
+	vkCmdSetScissor(cmd_buf, 0, 1, &scissor);
 }
 
 void
-vk_clear_color(struct vk_ctx *ctx,
+vk_record_draw(struct vk_ctx *ctx,
+	       VkCommandBuffer cmd_buf,
 	       struct vk_buf *vbo,
 	       struct vk_renderer *renderer,
 	       float *vk_fb_color,
 	       uint32_t vk_fb_color_count,
-	       struct vk_semaphores *semaphores,
-	       bool has_wait, bool has_signal,
-	       struct vk_image_att *attachments,
-	       uint32_t n_attachments,
+	       struct vk_push_constants *push_constants,
+	       uint32_t desc_offset,
 	       float x, float y,
 	       float w, float h)
 {
-	VkCommandBufferBeginInfo cmd_begin_info;
-	VkRenderPassBeginInfo rp_begin_info;
-	VkRect2D rp_area;
+	vk_record_draw_instanced(ctx, cmd_buf, vbo, renderer,
+				 vk_fb_color, vk_fb_color_count,
+				 push_constants, desc_offset, 0, 1,
+				 x, y, w, h);
+}
+
+void
+vk_record_draw_instanced(struct vk_ctx *ctx,
+			 VkCommandBuffer cmd_buf,
+			 struct vk_buf *vbo,
+			 struct vk_renderer *renderer,
+			 float *vk_fb_color,
+			 uint32_t vk_fb_color_count,
+			 struct vk_push_constants *push_constants,
+			 uint32_t desc_offset,
+			 uint32_t first_instance,
+			 uint32_t num_instances,
+			 float x, float y,
+			 float w, float h)
+{
 	VkClearValue clear_values[2];
-	VkSubmitInfo submit_info;
-	VkPipelineStageFlags stage_flags;
-	VkImageSubresourceRange img_range;
+	VkDeviceSize offsets[] = {0};
 
 	assert(vk_fb_color_count == 4);
 
-	if (has_wait)
-		assert(semaphores->gl_frame_done);
-	if (has_signal)
-		assert(semaphores->vk_frame_ready);
+	fill_clear_values(clear_values, vk_fb_color);
+	begin_renderpass(cmd_buf, renderer->draw_renderpass, renderer->fb,
+			 clear_values, x, y, w, h);
 
-	/* VkCommandBufferBeginInfo */
-	memset(&cmd_begin_info, 0, sizeof cmd_begin_info);
-	cmd_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	cmd_begin_info.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	if (push_constants) {
+		vkCmdPushConstants(cmd_buf,
+				   renderer->pipeline_layout,
+				   VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				   0, sizeof (struct vk_push_constants),
+				   push_constants);
+	}
 
-	/* VkRect2D render area */
-	memset(&rp_area, 0, sizeof rp_area);
-	rp_area.extent.width = (uint32_t)w;
-	rp_area.extent.height = (uint32_t)h;
-	rp_area.offset.x = x;
-	rp_area.offset.y = y;
+	if (renderer->desc_set != VK_NULL_HANDLE) {
+		bool is_dynamic =
+			renderer->desc_type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ||
+			renderer->desc_type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
 
-	/* VkClearValue */
-	memset(&clear_values[0], 0, sizeof clear_values[0]);
-	clear_values[0].color.float32[0] = vk_fb_color[0]; /* red */
-	clear_values[0].color.float32[1] = vk_fb_color[1]; /* green */
-	clear_values[0].color.float32[2] = vk_fb_color[2]; /* blue */
-	clear_values[0].color.float32[3] = vk_fb_color[3]; /* alpha */
+		vkCmdBindDescriptorSets(cmd_buf,
+					VK_PIPELINE_BIND_POINT_GRAPHICS,
+					renderer->pipeline_layout,
+					0, 1, &renderer->desc_set,
+					is_dynamic ? 1 : 0, &desc_offset);
+	}
 
-	memset(&clear_values[1], 0, sizeof clear_values[1]);
-	clear_values[1].depthStencil.depth = 1.0;
-	clear_values[1].depthStencil.stencil = 0;
+	if (vbo) {
+		vkCmdBindVertexBuffers(cmd_buf, 0, 1, &vbo->buf, offsets);
+	}
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipeline);
 
-	/* VkRenderPassBeginInfo */
+	int num_vertices = vbo ? renderer->vertex_info.num_verts : 36;
+	vkCmdDraw(cmd_buf, num_vertices, num_instances, 0, first_instance);
+
+	vkCmdEndRenderPass(cmd_buf);
+}
+
+void
+vk_record_draw_list(struct vk_ctx *ctx,
+		    VkCommandBuffer cmd_buf,
+		    struct vk_buf *vbo,
+		    struct vk_renderer *renderer,
+		    const struct vk_push_constants *push_constants,
+		    uint32_t count)
+{
+	VkDeviceSize offsets[] = {0};
+	uint32_t i;
+
+	vkCmdBindVertexBuffers(cmd_buf, 0, 1, &vbo->buf, offsets);
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipeline);
+
+	for (i = 0; i < count; i++) {
+		vkCmdPushConstants(cmd_buf,
+				   renderer->pipeline_layout,
+				   VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				   0, sizeof (struct vk_push_constants),
+				   &push_constants[i]);
+		vkCmdDraw(cmd_buf, renderer->vertex_info.num_verts, 1, 0, 0);
+	}
+}
+
+void
+vk_record_execute_secondary(struct vk_ctx *ctx,
+			    VkCommandBuffer cmd_buf,
+			    struct vk_renderer *renderer,
+			    float *vk_fb_color,
+			    uint32_t vk_fb_color_count,
+			    const VkCommandBuffer *secondary_cmd_bufs,
+			    uint32_t n_secondary_cmd_bufs,
+			    float x, float y,
+			    float w, float h)
+{
+	VkClearValue clear_values[2];
+	VkRenderPassBeginInfo rp_begin_info;
+
+	assert(vk_fb_color_count == 4);
+
+	fill_clear_values(clear_values, vk_fb_color);
+
+	/* no begin_renderpass(): only vkCmdExecuteCommands() is allowed
+	 * in a subpass with secondary command buffer contents, the
+	 * secondary command buffers set their own viewport & scissor */
 	memset(&rp_begin_info, 0, sizeof rp_begin_info);
 	rp_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	rp_begin_info.renderPass = renderer->clear_renderpass;
+	rp_begin_info.renderPass = renderer->draw_renderpass;
 	rp_begin_info.framebuffer = renderer->fb;
-	rp_begin_info.renderArea = rp_area;
+	rp_begin_info.renderArea.offset.x = x;
+	rp_begin_info.renderArea.offset.y = y;
+	rp_begin_info.renderArea.extent.width = (uint32_t)w;
+	rp_begin_info.renderArea.extent.height = (uint32_t)h;
 	rp_begin_info.clearValueCount = 2;
 	rp_begin_info.pClearValues = clear_values;
 
-	/* VkSubmitInfo */
-	stage_flags = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
+	vkCmdBeginRenderPass(cmd_buf, &rp_begin_info,
+			     VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+	vkCmdExecuteCommands(cmd_buf, n_secondary_cmd_bufs, secondary_cmd_bufs);
+	vkCmdEndRenderPass(cmd_buf);
+}
 
-	memset(&submit_info, 0, sizeof submit_info);
-	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &ctx->cmd_buf;
-	if (has_wait) {
-		submit_info.pWaitDstStageMask = &stage_flags;
-		submit_info.waitSemaphoreCount = 1;
-		submit_info.pWaitSemaphores = &semaphores->gl_frame_done;
-	}
+void
+vk_record_clear_color(struct vk_ctx *ctx,
+		      VkCommandBuffer cmd_buf,
+		      struct vk_renderer *renderer,
+		      float *vk_fb_color,
+		      uint32_t vk_fb_color_count,
+		      struct vk_image_att *attachments,
+		      uint32_t n_attachments,
+		      bool acquire,
+		      float x, float y,
+		      float w, float h)
+{
+	VkClearValue clear_values[2];
+	VkImageSubresourceRange img_range;
+	uint32_t src_qfam = acquire ? VK_QUEUE_FAMILY_EXTERNAL : VK_QUEUE_FAMILY_IGNORED;
+	uint32_t dst_qfam = acquire ? ctx->qfam_idx : VK_QUEUE_FAMILY_IGNORED;
 
-	if (has_signal) {
-		submit_info.signalSemaphoreCount = 1;
-		submit_info.pSignalSemaphores = &semaphores->vk_frame_ready;
-	}
+	assert(vk_fb_color_count == 4);
+	assert(n_attachments >= 2);
+
+	fill_clear_values(clear_values, vk_fb_color);
 
 	img_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	img_range.baseMipLevel = 0;
@@ -1723,27 +3969,25 @@ vk_clear_color(struct vk_ctx *ctx,
 	img_range.baseArrayLayer = 0;
 	img_range.layerCount = 1;
 
-	vkBeginCommandBuffer(ctx->cmd_buf, &cmd_begin_info);
-
 	vk_transition_image_layout(&attachments[0],
-				   ctx->cmd_buf,
+				   cmd_buf,
 				   VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
 				   VK_IMAGE_LAYOUT_GENERAL,
-				   VK_QUEUE_FAMILY_EXTERNAL,
-				   ctx->qfam_idx,
+				   src_qfam,
+				   dst_qfam,
 				   VK_IMAGE_ASPECT_COLOR_BIT);
 
 	VkImageAspectFlags depth_aspects = get_aspect_from_depth_format(attachments[1].props.format);
 
     vk_transition_image_layout(&attachments[1],
-        ctx->cmd_buf,
+        cmd_buf,
         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
         VK_IMAGE_LAYOUT_GENERAL,
-        VK_QUEUE_FAMILY_EXTERNAL,
-        ctx->qfam_idx,
+        src_qfam,
+        dst_qfam,
 		depth_aspects);
 
-	vkCmdClearColorImage(ctx->cmd_buf,
+	vkCmdClearColorImage(cmd_buf,
 			     attachments[0].obj.img,
 			     VK_IMAGE_LAYOUT_GENERAL,
 			     &clear_values[0].color,
@@ -1752,45 +3996,41 @@ vk_clear_color(struct vk_ctx *ctx,
 
     img_range.aspectMask = depth_aspects;
 
-    vkCmdClearDepthStencilImage(ctx->cmd_buf,
+    vkCmdClearDepthStencilImage(cmd_buf,
         attachments[1].obj.img,
         VK_IMAGE_LAYOUT_GENERAL,
         &clear_values[1].depthStencil,
         1,
         &img_range);
 
-	vkCmdBeginRenderPass(ctx->cmd_buf, &rp_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-
-	viewport.x = x;
-	viewport.y = y;
-	viewport.width = w;
-	viewport.height = h;
-
-	scissor.offset.x = x;
-	scissor.offset.y = y;
-	scissor.extent.width = w;
-	scissor.extent.height = h;
-
-	vkCmdSetViewport(ctx->cmd_buf, 0, 1, &viewport);
-	vkCmdSetScissor(ctx->cmd_buf, 0, 1, &scissor);
+	begin_renderpass(cmd_buf, renderer->clear_renderpass, renderer->fb,
+			 clear_values, x, y, w, h);
 
-	vkCmdBindPipeline(ctx->cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipeline);
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipeline);
 
-	vkCmdEndRenderPass(ctx->cmd_buf);
+	vkCmdEndRenderPass(cmd_buf);
+}
 
+void
+vk_record_release_attachments(struct vk_ctx *ctx,
+			      VkCommandBuffer cmd_buf,
+			      struct vk_image_att *attachments,
+			      uint32_t n_attachments)
+{
 	VkImageMemoryBarrier *barriers =
-		(VkImageMemoryBarrier*)calloc(n_attachments, sizeof(VkImageMemoryBarrier));
+		(VkImageMemoryBarrier*)alloca(n_attachments * sizeof(VkImageMemoryBarrier));
 	VkImageMemoryBarrier *barrier = barriers;
 
+	memset(barriers, 0, n_attachments * sizeof(VkImageMemoryBarrier));
+
 	for (uint32_t n = 0; n < n_attachments; n++, barrier++) {
 		struct vk_image_att *att = &attachments[n];
+		VkImageAspectFlags depth_stencil_flags =
+			get_aspect_from_depth_format(att->props.format);
+		bool is_depth = (depth_stencil_flags != 0);
 
 		/* Insert barrier to mark ownership transfer. */
 		barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-
-		VkImageAspectFlags depth_aspects = get_aspect_from_depth_format(att->props.format);
-		bool is_depth = depth_aspects != (uintptr_t)VK_NULL_HANDLE;
-
 		barrier->oldLayout = is_depth ?
 			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL :
 			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
@@ -1801,7 +4041,7 @@ vk_clear_color(struct vk_ctx *ctx,
 		barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
 		barrier->image = att->obj.img;
 		barrier->subresourceRange.aspectMask = is_depth ?
-			depth_aspects :
+			depth_stencil_flags :
 			VK_IMAGE_ASPECT_COLOR_BIT;
 		barrier->subresourceRange.baseMipLevel = 0;
 		barrier->subresourceRange.levelCount = 1;
@@ -1809,28 +4049,75 @@ vk_clear_color(struct vk_ctx *ctx,
 		barrier->subresourceRange.layerCount = 1;
 	}
 
-	vkCmdPipelineBarrier(ctx->cmd_buf,
-					VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT,
-					VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-					0,
-					0, NULL,
-					0, NULL,
-					n_attachments, barriers);
-	free(barriers);
+	vkCmdPipelineBarrier(cmd_buf,
+			     VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT,
+			     VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			     0,
+			     0, NULL,
+			     0, NULL,
+			     n_attachments, barriers);
+}
 
-	vkEndCommandBuffer(ctx->cmd_buf);
+void
+vk_draw(struct vk_ctx *ctx,
+	struct vk_frame *frame,
+	struct vk_buf *vbo,
+	struct vk_renderer *renderer,
+	float *vk_fb_color,
+	uint32_t vk_fb_color_count,
+	struct vk_semaphores *semaphores,
+	bool has_wait, bool has_signal,
+	struct vk_image_att *attachments,
+	uint32_t n_attachments,
+	struct vk_push_constants *push_constants,
+	float x, float y,
+	float w, float h)
+{
+	vk_begin_cmd_buf(frame->cmd_buf);
 
-    if (vkQueueSubmit(ctx->queue, 1, &submit_info, ctx->fence) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to submit queue.\n");
-    }
+	vk_record_draw(ctx, frame->cmd_buf, vbo, renderer,
+		       vk_fb_color, vk_fb_color_count,
+		       push_constants, 0, x, y, w, h);
 
-    if (vkWaitForFences(ctx->dev, 1, &ctx->fence, true, UINT64_MAX) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to wait for fences.\n");
-    }
+	if (attachments)
+		vk_record_release_attachments(ctx, frame->cmd_buf, attachments, n_attachments);
 
-    if (vkResetFences(ctx->dev, 1, &ctx->fence) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to reset fences.\n");
-    }
+	vk_end_cmd_buf(frame->cmd_buf);
+
+	vk_submit_cmd_bufs(ctx, frame, &frame->cmd_buf, 1,
+			   semaphores, has_wait, has_signal);
+
+	/* FIXME */
+	if (!semaphores && !has_wait && !has_signal)
+		vkQueueWaitIdle(ctx->queue);
+}
+
+void
+vk_clear_color(struct vk_ctx *ctx,
+	       struct vk_frame *frame,
+	       struct vk_buf *vbo,
+	       struct vk_renderer *renderer,
+	       float *vk_fb_color,
+	       uint32_t vk_fb_color_count,
+	       struct vk_semaphores *semaphores,
+	       bool has_wait, bool has_signal,
+	       struct vk_image_att *attachments,
+	       uint32_t n_attachments,
+	       float x, float y,
+	       float w, float h)
+{
+	vk_begin_cmd_buf(frame->cmd_buf);
+
+	vk_record_clear_color(ctx, frame->cmd_buf, renderer,
+			      vk_fb_color, vk_fb_color_count,
+			      attachments, n_attachments, true, x, y, w, h);
+
+	vk_record_release_attachments(ctx, frame->cmd_buf, attachments, n_attachments);
+
+	vk_end_cmd_buf(frame->cmd_buf);
+
+	vk_submit_cmd_bufs(ctx, frame, &frame->cmd_buf, 1,
+			   semaphores, has_wait, has_signal);
 
 	if (!semaphores && !has_wait && !has_signal)
 		vkQueueWaitIdle(ctx->queue);
@@ -1969,6 +4256,101 @@ vk_destroy_semaphores(struct vk_ctx *ctx,
 		vkDestroySemaphore(ctx->dev, semaphores->gl_frame_done, 0);
 }
 
+static bool
+timeline_is_exportable(struct vk_ctx *ctx)
+{
+	VkSemaphoreTypeCreateInfoKHR type_info;
+	VkPhysicalDeviceExternalSemaphoreInfo ext_info;
+	VkExternalSemaphoreProperties ext_props;
+
+	memset(&type_info, 0, sizeof type_info);
+	type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+	type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+
+	memset(&ext_info, 0, sizeof ext_info);
+	ext_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_SEMAPHORE_INFO;
+	ext_info.pNext = &type_info;
+	ext_info.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_BIT;
+
+	memset(&ext_props, 0, sizeof ext_props);
+	ext_props.sType = VK_STRUCTURE_TYPE_EXTERNAL_SEMAPHORE_PROPERTIES;
+
+	vkGetPhysicalDeviceExternalSemaphoreProperties(ctx->pdev, &ext_info, &ext_props);
+
+	return (ext_props.externalSemaphoreFeatures &
+		VK_EXTERNAL_SEMAPHORE_FEATURE_EXPORTABLE_BIT) != 0;
+}
+
+bool
+vk_create_timeline(struct vk_ctx *ctx,
+		   struct vk_timeline *timeline)
+{
+	VkSemaphoreCreateInfo sema_info;
+	VkExportSemaphoreCreateInfo exp_sema_info;
+	VkSemaphoreTypeCreateInfoKHR type_info;
+
+	memset(timeline, 0, sizeof *timeline);
+
+	if (!ctx->has_timeline_semaphores || !timeline_is_exportable(ctx))
+		return false;
+
+	/* VkSemaphoreTypeCreateInfo, all values start at 0 */
+	memset(&type_info, 0, sizeof type_info);
+	type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+	type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+	type_info.initialValue = 0;
+
+	/* VkExportSemaphoreCreateInfo */
+	memset(&exp_sema_info, 0, sizeof exp_sema_info);
+	exp_sema_info.sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO;
+	exp_sema_info.pNext = &type_info;
+	exp_sema_info.handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_BIT;
+
+	/* VkSemaphoreCreateInfo */
+	memset(&sema_info, 0, sizeof sema_info);
+	sema_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	sema_info.pNext = &exp_sema_info;
+
+	if (vkCreateSemaphore(ctx->dev, &sema_info, 0, &timeline->vk_frame_ready) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to create timeline semaphore vk_frame_ready.\n");
+		goto fail;
+	}
+
+	if (vkCreateSemaphore(ctx->dev, &sema_info, 0, &timeline->gl_frame_done) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to create timeline semaphore gl_frame_done.\n");
+		goto fail;
+	}
+
+	ctx->timeline = timeline->vk_frame_ready;
+	return true;
+
+fail:
+	vk_destroy_timeline(ctx, timeline);
+	return false;
+}
+
+void
+vk_destroy_timeline(struct vk_ctx *ctx,
+		    struct vk_timeline *timeline)
+{
+	uint32_t i;
+
+	/* the ring slots fall back to their fences */
+	if (ctx->timeline == timeline->vk_frame_ready) {
+		vk_wait_frames_idle(ctx);
+		for (i = 0; i < VK_MAX_FRAMES_IN_FLIGHT; i++)
+			ctx->frames[i].timeline_value = 0;
+		ctx->timeline = VK_NULL_HANDLE;
+	}
+
+	if (timeline->vk_frame_ready)
+		vkDestroySemaphore(ctx->dev, timeline->vk_frame_ready, 0);
+	if (timeline->gl_frame_done)
+		vkDestroySemaphore(ctx->dev, timeline->gl_frame_done, 0);
+
+	memset(timeline, 0, sizeof *timeline);
+}
+
 void
 vk_transition_image_layout(struct vk_image_att *img_att,
 			   VkCommandBuffer cmd_buf,
@@ -34,6 +34,72 @@
 extern "C" {
 #endif
 
+/* upper bound for vk_ctx::num_frames_in_flight */
+#define VK_MAX_FRAMES_IN_FLIGHT 8
+
+struct vk_semaphores
+{
+	VkSemaphore vk_frame_ready;
+	VkSemaphore gl_frame_done;
+};
+
+/* bump whenever the layout of the pipeline cache file changes */
+#define VK_PIPELINE_CACHE_FILE_VERSION 1
+
+/* exported VK_KHR_timeline_semaphore pair shared by all ring slots,
+ * every handoff signals the next value, so handoffs of several frames
+ * can be queued without per-slot binary semaphores */
+struct vk_timeline
+{
+	VkSemaphore vk_frame_ready;
+	VkSemaphore gl_frame_done;
+
+	uint64_t vk_value; /* last value signaled by Vulkan (vk_frame_ready) */
+	uint64_t gl_value; /* last value signaled by GL (gl_frame_done) */
+};
+
+/* one slot of the frames-in-flight ring, see vk_acquire_frame() */
+struct vk_frame
+{
+	VkCommandBuffer cmd_buf;
+	VkFence fence;
+
+	struct vk_semaphores semaphores;
+
+	/* vk_timeline::vk_value of the slot's last timeline submission,
+	 * waited for instead of the fence (0 == fence) */
+	uint64_t timeline_value;
+
+	/* the fence belongs to a queued submission, false before the first
+	 * one and after a failed one (wait_frame() skips the fence) */
+	bool fence_submitted;
+};
+
+/* size of the blocks that internal (not exported) resources are
+ * sub-allocated from, larger resources get a block of their own */
+#define VK_MEM_BLOCK_SIZE (16u << 20)
+
+struct vk_mem_block;
+
+/* Device memory of a vk_ctx: one list of blocks (VkDeviceMemory) for all
+ * memory types. Internal resources share blocks, exported memory and
+ * dedicated allocations are blocks of their own (GL imports the whole
+ * VkDeviceMemory). Not thread-safe, like cmd_pool. */
+struct vk_mem_allocator
+{
+	VkPhysicalDeviceMemoryProperties props;
+	VkDeviceSize granularity; /* bufferImageGranularity */
+
+	struct vk_mem_block *blocks;
+	uint32_t num_blocks;     /* live vkAllocateMemory() allocations */
+	uint32_t max_blocks;     /* maxMemoryAllocationCount */
+	uint32_t num_resources;  /* live resources in the blocks */
+
+	/* bytes of this ctx per heap: allocated blocks & bound resources */
+	VkDeviceSize heap_allocated[VK_MAX_MEMORY_HEAPS];
+	VkDeviceSize heap_used[VK_MAX_MEMORY_HEAPS];
+};
+
 struct vk_ctx
 {
 	VkInstance inst;
@@ -48,8 +114,44 @@ struct vk_ctx
 
 	VkFence fence;
 
+	struct vk_frame frames[VK_MAX_FRAMES_IN_FLIGHT];
+	uint32_t num_frames_in_flight;
+	uint32_t frame_idx;
+
+	/* loaded from pipeline_cache_file in vk_init_ctx_for_rendering()
+	 * and written back in vk_cleanup_ctx(), set pipeline_cache_file
+	 * before the init call (NULL keeps the cache in memory only) */
+	VkPipelineCache pipeline_cache;
+	const char *pipeline_cache_file;
+	size_t pipeline_cache_loaded_size; /* 0 == cold start */
+
 	uint8_t deviceUUID[VK_UUID_SIZE];
 	uint8_t driverUUID[VK_UUID_SIZE];
+
+	/* physical device selection of vk_init_ctx(), set before the init
+	 * call: with match_uuids the device with these UUIDs is preferred
+	 * (the GL context's, see gl_get_device_uuids()), pdev_override
+	 * (NULL == automatic) forces a device by its index in
+	 * vkEnumeratePhysicalDevices() or by a substring of its name */
+	bool match_uuids;
+	uint8_t match_deviceUUID[VK_UUID_SIZE];
+	uint8_t match_driverUUID[VK_UUID_SIZE];
+	const char *pdev_override;
+
+	/* VK_KHR_timeline_semaphore is enabled on dev */
+	bool has_timeline_semaphores;
+
+	/* VK_KHR_depth_stencil_resolve is enabled on dev, see
+	 * vk_create_resolve_renderer() */
+	bool has_depth_stencil_resolve;
+
+	/* vk_frame_ready of the timeline in use, see vk_create_timeline() */
+	VkSemaphore timeline;
+
+	/* VK_EXT_memory_budget is enabled on dev, the allocator keeps new
+	 * blocks within the budget of a heap (otherwise 80% of its size) */
+	bool has_memory_budget;
+	struct vk_mem_allocator mem;
 };
 
 struct vk_image_props
@@ -76,6 +178,12 @@ struct vk_mem_obj {
 	VkDeviceMemory mem;
 	VkDeviceSize mem_sz;
 	bool dedicated;
+
+	/* the resource is bound at offset of mem: a range of block, or of a
+	 * vk_interop_alloc (sub_allocated, vk_destroy_* don't free mem) */
+	VkDeviceSize offset;
+	bool sub_allocated;
+	struct vk_mem_block *block;
 };
 
 struct vk_image_obj {
@@ -89,12 +197,20 @@ struct vk_image_att {
 	struct vk_image_props props;
 };
 
+#define VK_MAX_VERTEX_ATTRIBS 4
+
 struct vk_vertex_info
 {
 	int num_verts;
 	int num_components;
 
 	VkPrimitiveTopology topology;
+
+	/* interleaved 32 bit float attributes at locations 0 .. num_attribs - 1
+	 * with attrib_components[i] floats each (0 attributes: a single vec2
+	 * at location 0) */
+	uint32_t num_attribs;
+	uint32_t attrib_components[VK_MAX_VERTEX_ATTRIBS];
 };
 
 struct vk_renderer
@@ -107,6 +223,12 @@ struct vk_renderer
 	VkShaderModule fs;
 	VkFramebuffer fb;
 
+	/* optional buffer descriptor at set = 0, binding = 0 */
+	VkDescriptorType desc_type;
+	VkDescriptorSetLayout desc_set_layout;
+	VkDescriptorPool desc_pool;
+	VkDescriptorSet desc_set;
+
 	struct vk_vertex_info vertex_info;
 };
 
@@ -116,10 +238,55 @@ struct vk_buf
 	struct vk_mem_obj mobj;
 };
 
-struct vk_semaphores
+/* the largest alignment of vk_staging_ring_alloc() */
+#define VK_STAGING_MAX_ALIGNMENT 256
+
+/* Persistently mapped upload ring, see vk_create_staging_ring(): per-frame
+ * data is written linearly into host memory and copied into device-local
+ * buffers by the frame's command-buffer (vkCmdCopyBuffer()). The data of a
+ * frame is reserved until its frames-in-flight slot comes around again. */
+struct vk_staging_ring
 {
-	VkSemaphore vk_frame_ready;
-	VkSemaphore gl_frame_done;
+	struct vk_buf bo;
+	uint8_t *map;
+	VkDeviceSize size;
+
+	/* monotonic byte positions, the buffer offset is position % size:
+	 * the next allocation, the end of the data the GPU may still read
+	 * and the end of each slot's data */
+	VkDeviceSize head;
+	VkDeviceSize tail;
+	VkDeviceSize slot_end[VK_MAX_FRAMES_IN_FLIGHT];
+	uint32_t slot;
+};
+
+#define VK_INTEROP_ALLOC_MAX_RESOURCES 16
+
+/* Several non-dedicated interop images / buffers packed into one exported
+ * allocation, see vk_interop_alloc_begin() */
+struct vk_interop_alloc
+{
+	/* mem_sz: the packed size, mem: valid after vk_interop_alloc_finish() */
+	struct vk_mem_obj mobj;
+
+	uint32_t memory_type_bits;
+	VkDeviceSize granularity;
+	bool last_is_linear;
+
+	uint32_t num_resources;
+	struct vk_mem_obj *resource_mobjs[VK_INTEROP_ALLOC_MAX_RESOURCES];
+	VkImage images[VK_INTEROP_ALLOC_MAX_RESOURCES];
+	VkBuffer bufs[VK_INTEROP_ALLOC_MAX_RESOURCES];
+};
+
+/* GPU timestamp queries, see vk_create_timestamps() */
+struct vk_timestamps
+{
+	VkQueryPool pool;
+	uint32_t count;
+
+	double ns_per_tick;
+	uint64_t valid_mask;
 };
 
 struct vk_push_constants
@@ -131,11 +298,15 @@ bool
 vk_init_ctx(struct vk_ctx *ctx, bool enable_validation);
 
 bool
-vk_init_ctx_for_rendering(struct vk_ctx *ctx, bool enable_validation);
+vk_init_ctx_for_rendering(struct vk_ctx *ctx, bool enable_validation,
+			  uint32_t num_frames_in_flight);
 
 void
 vk_cleanup_ctx(struct vk_ctx *ctx);
 
+bool
+vk_save_pipeline_cache(struct vk_ctx *ctx);
+
 bool
 vk_check_gl_compatibility(struct vk_ctx *ctx);
 
@@ -144,6 +315,14 @@ vk_create_ext_image(struct vk_ctx *ctx,
 		    struct vk_image_props *props,
 		    struct vk_image_obj *img_obj);
 
+/* a color / depth attachment that never leaves Vulkan (no export, no
+ * sampling), e.g. the multisampled attachments of a resolve renderer,
+ * destroyed with vk_destroy_ext_image() */
+bool
+vk_create_transient_image(struct vk_ctx *ctx,
+			  struct vk_image_props *props,
+			  struct vk_image_obj *img_obj);
+
 bool
 vk_create_ext_buffer(struct vk_ctx *ctx,
 		     uint32_t sz,
@@ -158,6 +337,39 @@ void
 vk_destroy_ext_bo(struct vk_ctx *ctx,
 		  struct vk_buf *bo);
 
+/* Interop allocator: vk_interop_alloc_image() / _buffer() create the
+ * resources and reserve an aligned range for each of them,
+ * vk_interop_alloc_finish() allocates one exported block and binds them.
+ * The block is imported into GL once (gl_create_mem_obj_from_vk_mem() with
+ * alloc->mobj), the resources at their mobj.offset. Images that require a
+ * dedicated allocation are rejected, use vk_create_ext_image() for them.
+ * The resources are destroyed with vk_destroy_ext_image() / _bo() before
+ * vk_interop_alloc_destroy() frees the block. */
+void
+vk_interop_alloc_begin(struct vk_ctx *ctx,
+		       struct vk_interop_alloc *alloc);
+
+bool
+vk_interop_alloc_image(struct vk_ctx *ctx,
+		       struct vk_interop_alloc *alloc,
+		       struct vk_image_props *props,
+		       struct vk_image_obj *img);
+
+bool
+vk_interop_alloc_buffer(struct vk_ctx *ctx,
+			struct vk_interop_alloc *alloc,
+			uint32_t sz,
+			VkBufferUsageFlags usage,
+			struct vk_buf *bo);
+
+bool
+vk_interop_alloc_finish(struct vk_ctx *ctx,
+			struct vk_interop_alloc *alloc);
+
+void
+vk_interop_alloc_destroy(struct vk_ctx *ctx,
+			 struct vk_interop_alloc *alloc);
+
 bool
 vk_fill_ext_image_props(struct vk_ctx *ctx,
 			uint32_t w, uint32_t h,
@@ -183,12 +395,72 @@ vk_create_renderer(struct vk_ctx *ctx,
 		   struct vk_image_att *color_att,
 		   struct vk_image_att *depth_att,
 		   struct vk_vertex_info *vert_info,
+		   VkDescriptorType desc_type,
 		   struct vk_renderer *renderer);
 
+/* renders into the multisampled color_att & depth_att and resolves them
+ * into the single sample resolve_color_att & resolve_depth_att (depth:
+ * sample 0) at the end of every render pass, the resolve attachments are
+ * the ones to clear / release (fails without
+ * vk_ctx::has_depth_stencil_resolve) */
+bool
+vk_create_resolve_renderer(struct vk_ctx *ctx,
+			   const char *vs_src,
+			   unsigned int vs_size,
+			   const char *fs_src,
+			   unsigned int fs_size,
+			   bool enable_stencil,
+			   struct vk_image_att *color_att,
+			   struct vk_image_att *depth_att,
+			   struct vk_image_att *resolve_color_att,
+			   struct vk_image_att *resolve_depth_att,
+			   struct vk_vertex_info *vert_info,
+			   VkDescriptorType desc_type,
+			   struct vk_renderer *renderer);
+
+/* Recreates the renderer's framebuffer for new attachment images (e.g. after
+ * a resize), the render passes and pipelines are kept: the attachments must
+ * keep their formats & sample-counts, the viewport is dynamic state.
+ * resolve_color_att / resolve_depth_att: NULL unless the renderer was created
+ * with vk_create_resolve_renderer() */
+bool
+vk_recreate_framebuffer(struct vk_ctx *ctx,
+			struct vk_image_att *color_att,
+			struct vk_image_att *depth_att,
+			struct vk_image_att *resolve_color_att,
+			struct vk_image_att *resolve_depth_att,
+			struct vk_renderer *renderer);
+
 void
 vk_destroy_renderer(struct vk_ctx *ctx,
 		    struct vk_renderer *pipeline);
 
+void
+vk_update_renderer_descriptor(struct vk_ctx *ctx,
+			      struct vk_renderer *renderer,
+			      struct vk_buf *bo,
+			      VkDeviceSize range);
+
+/* Points the renderer at bo through a freshly allocated descriptor set,
+ * leaving the old set untouched for command buffers still in flight.
+ * The pool holding the old set is returned in old_pool; release it with
+ * vk_destroy_descriptor_pool() once those submissions have completed. */
+bool
+vk_replace_renderer_descriptor(struct vk_ctx *ctx,
+			       struct vk_renderer *renderer,
+			       struct vk_buf *bo,
+			       VkDeviceSize range,
+			       VkDescriptorPool *old_pool);
+
+void
+vk_destroy_descriptor_pool(struct vk_ctx *ctx,
+			   VkDescriptorPool *pool);
+
+/* per heap: budget & usage of the process (VK_EXT_memory_budget), the
+ * blocks & resources of ctx, printed as "VK memory ..." lines */
+void
+vk_print_memory_stats(struct vk_ctx *ctx);
+
 bool
 vk_create_buffer(struct vk_ctx *ctx,
 		 bool is_external,
@@ -203,12 +475,244 @@ vk_update_buffer_data(struct vk_ctx *ctx,
 		      uint32_t data_sz,
 		      struct vk_buf *bo);
 
+/* host-visible blocks stay mapped until they are freed, vk_map_buffer()
+ * returns a pointer into the block that is valid until
+ * vk_destroy_buffer() (there is no unmap) */
+bool
+vk_map_buffer(struct vk_ctx *ctx,
+	      struct vk_buf *bo,
+	      void **map);
+
 void
 vk_destroy_buffer(struct vk_ctx *ctx,
 		  struct vk_buf *bo);
 
+/* not host-visible, written by vkCmdCopyBuffer() (usage gets
+ * VK_BUFFER_USAGE_TRANSFER_DST_BIT), see vk_create_staging_ring() */
+bool
+vk_create_device_buffer(struct vk_ctx *ctx,
+			VkDeviceSize sz,
+			VkBufferUsageFlags usage,
+			struct vk_buf *bo);
+
+/* the device has device-local memory that the CPU can't map (e.g. a
+ * discrete GPU without resizable BAR): the GPU reads host-visible buffers
+ * over the bus */
+bool
+vk_has_host_invisible_vram(struct vk_ctx *ctx);
+
+/* Staging ring: vk_staging_ring_begin_frame() after vk_acquire_frame()
+ * returned the slot, then vk_staging_ring_alloc() & memcpy() into the
+ * returned pointer, vk_record_upload() into the slot's command-buffer
+ * (outside of a render pass) and one vk_record_upload_barrier() before the
+ * commands that read the destinations. */
+bool
+vk_create_staging_ring(struct vk_ctx *ctx,
+		       VkDeviceSize size,
+		       struct vk_staging_ring *ring);
+
+void
+vk_destroy_staging_ring(struct vk_ctx *ctx,
+			struct vk_staging_ring *ring);
+
+void
+vk_staging_ring_begin_frame(struct vk_staging_ring *ring,
+			    uint32_t slot);
+
+/* NULL if the data of the frames in flight leaves no room */
+void *
+vk_staging_ring_alloc(struct vk_staging_ring *ring,
+		      VkDeviceSize size,
+		      VkDeviceSize alignment,
+		      VkDeviceSize *offset);
+
+void
+vk_record_upload(VkCommandBuffer cmd_buf,
+		 struct vk_staging_ring *ring,
+		 VkDeviceSize src_offset,
+		 struct vk_buf *dst,
+		 VkDeviceSize dst_offset,
+		 VkDeviceSize size);
+
+/* src needs VK_BUFFER_USAGE_TRANSFER_SRC_BIT, dst
+ * VK_BUFFER_USAGE_TRANSFER_DST_BIT (outside of a render pass) */
+void
+vk_record_copy_buffer(VkCommandBuffer cmd_buf,
+		      struct vk_buf *src,
+		      VkDeviceSize src_offset,
+		      struct vk_buf *dst,
+		      VkDeviceSize dst_offset,
+		      VkDeviceSize size);
+
+void
+vk_record_upload_barrier(VkCommandBuffer cmd_buf);
+
+bool
+vk_create_timestamps(struct vk_ctx *ctx,
+		     uint32_t count,
+		     struct vk_timestamps *ts);
+
+void
+vk_destroy_timestamps(struct vk_ctx *ctx,
+		      struct vk_timestamps *ts);
+
+/* queries have to be reset (outside of a render pass) before they can be
+ * written again */
+void
+vk_record_reset_timestamps(VkCommandBuffer cmd_buf,
+			   struct vk_timestamps *ts,
+			   uint32_t first,
+			   uint32_t count);
+
+void
+vk_record_timestamp(VkCommandBuffer cmd_buf,
+		    struct vk_timestamps *ts,
+		    uint32_t idx);
+
+/* non-blocking read-back in nanoseconds, fails if any of the queries is
+ * still pending */
+bool
+vk_get_timestamps_ns(struct vk_ctx *ctx,
+		     struct vk_timestamps *ts,
+		     uint32_t first,
+		     uint32_t count,
+		     uint64_t *ns);
+
+/* NULL if waiting for the slot's previous submission failed (e.g. the
+ * device was lost) */
+struct vk_frame *
+vk_acquire_frame(struct vk_ctx *ctx);
+
+bool
+vk_submit_frame(struct vk_ctx *ctx,
+		struct vk_frame *frame,
+		const VkSubmitInfo *submit_info);
+
+void
+vk_wait_frames_idle(struct vk_ctx *ctx);
+
+bool
+vk_submit_cmd_bufs(struct vk_ctx *ctx,
+		   struct vk_frame *frame,
+		   const VkCommandBuffer *cmd_bufs,
+		   uint32_t n_cmd_bufs,
+		   struct vk_semaphores *semaphores,
+		   bool has_wait, bool has_signal);
+
+VkCommandBuffer
+vk_create_cmd_buf(struct vk_ctx *ctx);
+
+void
+vk_destroy_cmd_buf(struct vk_ctx *ctx,
+		   VkCommandBuffer *cmd_buf);
+
+/* PARALLEL RECORDING: command pools are externally synchronized, every
+ * recording thread needs its own pool (reset as a whole once the GPU is
+ * done with all of its command buffers) */
+VkCommandPool
+vk_create_cmd_pool(struct vk_ctx *ctx);
+
+void
+vk_destroy_cmd_pool(struct vk_ctx *ctx,
+		    VkCommandPool *cmd_pool);
+
+bool
+vk_reset_cmd_pool(struct vk_ctx *ctx,
+		  VkCommandPool cmd_pool);
+
+VkCommandBuffer
+vk_create_secondary_cmd_buf(struct vk_ctx *ctx,
+			    VkCommandPool cmd_pool);
+
+/* begins a one-time secondary command buffer that continues the
+ * draw_renderpass of the renderer (in its current framebuffer) and sets
+ * the viewport & scissor */
+bool
+vk_begin_secondary_cmd_buf(VkCommandBuffer cmd_buf,
+			   struct vk_renderer *renderer,
+			   float x, float y, float w, float h);
+
+bool
+vk_begin_cmd_buf(VkCommandBuffer cmd_buf);
+
+bool
+vk_end_cmd_buf(VkCommandBuffer cmd_buf);
+
+void
+vk_record_draw(struct vk_ctx *ctx,
+	       VkCommandBuffer cmd_buf,
+	       struct vk_buf *vbo,
+	       struct vk_renderer *renderer,
+	       float *vk_fb_color,
+	       uint32_t vk_fb_color_count,
+	       struct vk_push_constants *push_constants,
+	       uint32_t desc_offset,
+	       float x, float y, float w, float h);
+
+/* same as vk_record_draw(), but draws num_instances instances
+ * starting at first_instance (the vertex shader is expected to index
+ * its per-instance data with gl_InstanceIndex, which includes
+ * first_instance) */
+void
+vk_record_draw_instanced(struct vk_ctx *ctx,
+			 VkCommandBuffer cmd_buf,
+			 struct vk_buf *vbo,
+			 struct vk_renderer *renderer,
+			 float *vk_fb_color,
+			 uint32_t vk_fb_color_count,
+			 struct vk_push_constants *push_constants,
+			 uint32_t desc_offset,
+			 uint32_t first_instance,
+			 uint32_t num_instances,
+			 float x, float y, float w, float h);
+
+/* one draw per push constant block (e.g. an MVP per object), recorded
+ * into a secondary command buffer started with
+ * vk_begin_secondary_cmd_buf() */
+void
+vk_record_draw_list(struct vk_ctx *ctx,
+		    VkCommandBuffer cmd_buf,
+		    struct vk_buf *vbo,
+		    struct vk_renderer *renderer,
+		    const struct vk_push_constants *push_constants,
+		    uint32_t count);
+
+/* the draw_renderpass of the renderer, with its contents recorded into
+ * secondary command buffers (executed in order) */
+void
+vk_record_execute_secondary(struct vk_ctx *ctx,
+			    VkCommandBuffer cmd_buf,
+			    struct vk_renderer *renderer,
+			    float *vk_fb_color,
+			    uint32_t vk_fb_color_count,
+			    const VkCommandBuffer *secondary_cmd_bufs,
+			    uint32_t n_secondary_cmd_bufs,
+			    float x, float y, float w, float h);
+
+/* acquire: take the attachments over from the external (GL) queue
+ * family, only the first command touching them after the handoff may
+ * do so, a later clear in the same command buffer only transitions
+ * the layouts */
+void
+vk_record_clear_color(struct vk_ctx *ctx,
+		      VkCommandBuffer cmd_buf,
+		      struct vk_renderer *renderer,
+		      float *vk_fb_color,
+		      uint32_t vk_fb_color_count,
+		      struct vk_image_att *attachments,
+		      uint32_t n_attachments,
+		      bool acquire,
+		      float x, float y, float w, float h);
+
+void
+vk_record_release_attachments(struct vk_ctx *ctx,
+			      VkCommandBuffer cmd_buf,
+			      struct vk_image_att *attachments,
+			      uint32_t n_attachments);
+
 void
 vk_draw(struct vk_ctx *ctx,
+	struct vk_frame *frame,
 	struct vk_buf *vbo,
 	struct vk_renderer *renderer,
 	float *vk_fb_color,
@@ -222,6 +726,7 @@ vk_draw(struct vk_ctx *ctx,
 
 void
 vk_clear_color(struct vk_ctx *ctx,
+	       struct vk_frame *frame,
 	       struct vk_buf *vbo,
 	       struct vk_renderer *renderer,
 	       float *vk_fb_color,
@@ -246,6 +751,39 @@ void
 vk_destroy_semaphores(struct vk_ctx *ctx,
 		      struct vk_semaphores *semaphores);
 
+/* fails if the timeline semaphores are not supported or cannot be
+ * exported, the caller falls back to the binary vk_semaphores then */
+bool
+vk_create_timeline(struct vk_ctx *ctx,
+		   struct vk_timeline *timeline);
+
+void
+vk_destroy_timeline(struct vk_ctx *ctx,
+		    struct vk_timeline *timeline);
+
+/* waits for gl_frame_done >= wait_gl_value (0 == no wait) and signals
+ * vk_frame_ready = signal_value (0 == vk_value + 1), which becomes the
+ * new vk_value; the ring slot is tracked by that value instead of a
+ * fence. If the submission fails, the value is signaled from the host
+ * (after the previous submissions completed), so that nobody waits for
+ * it forever. */
+bool
+vk_submit_cmd_bufs_timeline(struct vk_ctx *ctx,
+			    struct vk_frame *frame,
+			    const VkCommandBuffer *cmd_bufs,
+			    uint32_t n_cmd_bufs,
+			    struct vk_timeline *timeline,
+			    uint64_t wait_gl_value,
+			    uint64_t signal_value);
+
+/* signals vk_frame_ready = value (the new vk_value) from the host once
+ * the previous submissions completed, for a value that GL already waits
+ * for but no submission will signal */
+bool
+vk_signal_timeline(struct vk_ctx *ctx,
+		   struct vk_timeline *timeline,
+		   uint64_t value);
+
 
 void
 vk_transition_image_layout(struct vk_image_att *img_att,
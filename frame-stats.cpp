@@ -0,0 +1,271 @@
+#include "frame-stats.h"
+
+#include "vk-render.h"
+
+#include <ext/piglit/piglit-util.h>
+
+#include <fstream>
+#include <iostream>
+
+#define FRAME_STATS_SLOTS 10            // frames whose GL queries can be in flight
+#define FRAME_STATS_QUERIES 32          // GL timestamp queries per frame (a begin/end pair per timer)
+
+struct frame_stats_slot
+{
+    GLuint queries[FRAME_STATS_QUERIES];
+    gl_timer timers[FRAME_STATS_QUERIES / 2];
+    uint32_t num_queries;
+    GLint64 gl_begin_ns;                // GL_TIMESTAMP at frame_stats_begin_frame()
+    bool pending;                       // waiting for the query results
+    frame_stats stats;
+};
+
+static bool stats_active = false;
+static bool stats_vk_timings = false;
+static std::ofstream stats_csv;
+
+static frame_stats_slot stats_slots[FRAME_STATS_SLOTS];
+static frame_stats_slot* stats_current = nullptr;
+static uint64_t stats_next_frame = 0;       // next frame to begin
+static uint64_t stats_oldest_frame = 0;     // oldest frame that was not finalized yet
+
+static frame_stats stats_latest;
+static bool stats_has_latest = false;
+
+static uint64_t stats_num_frames = 0;
+static uint64_t stats_num_vk_frames = 0;
+static uint64_t stats_num_dropped = 0;
+static frame_stats stats_sum;
+
+static void finalize_frame(frame_stats_slot& slot)
+{
+    slot.pending = false;
+
+    const frame_stats& s = slot.stats;
+
+    if (stats_csv.is_open())
+    {
+        stats_csv << s.frame << "," << s.cpu_begin_ns << "," << s.cpu_frame_ms << "," << s.gl_gpu_start_ms << ","
+            << s.gl_draw_ms << "," << s.gl_blit_ms << "," << s.vk_clear_ms << "," << s.vk_draw_ms << ","
+            << (s.vk_valid ? 1 : 0) << "\n";
+    }
+
+    stats_latest = s;
+    stats_has_latest = true;
+
+    ++stats_num_frames;
+    stats_sum.cpu_frame_ms += s.cpu_frame_ms;
+    stats_sum.gl_gpu_start_ms += s.gl_gpu_start_ms;
+    stats_sum.gl_draw_ms += s.gl_draw_ms;
+    stats_sum.gl_blit_ms += s.gl_blit_ms;
+
+    if (s.vk_valid)
+    {
+        ++stats_num_vk_frames;
+        stats_sum.vk_clear_ms += s.vk_clear_ms;
+        stats_sum.vk_draw_ms += s.vk_draw_ms;
+    }
+}
+
+// reads back the results of a frame if they are available, never waits for the GPU
+// (force: the slot is needed again, finalize with whatever is available)
+static bool try_collect_frame(frame_stats_slot& slot, bool force)
+{
+    frame_stats& s = slot.stats;
+
+    if (slot.num_queries > 0)
+    {
+        // queries complete in order, so the last one is enough
+        GLint available = 0;
+        glGetQueryObjectiv(slot.queries[slot.num_queries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return false;
+    }
+
+    vk_gpu_timings vk_timings;
+    s.vk_valid = vk_get_gpu_timings(s.frame, vk_timings);
+    if (stats_vk_timings && !s.vk_valid && !force)
+        return false;
+
+    if (s.vk_valid)
+    {
+        s.vk_clear_ms = vk_timings.clear_ms;
+        s.vk_draw_ms = vk_timings.draw_ms;
+    }
+
+    GLuint64 ns[FRAME_STATS_QUERIES];
+    for (uint32_t i = 0; i < slot.num_queries; ++i)
+        glGetQueryObjectui64v(slot.queries[i], GL_QUERY_RESULT, &ns[i]);
+
+    s.gl_draw_ms = 0.0;
+    s.gl_blit_ms = 0.0;
+    for (uint32_t i = 0; i + 1 < slot.num_queries; i += 2)
+    {
+        const double ms = (ns[i + 1] - ns[i]) / 1000000.0;
+        if (slot.timers[i / 2] == GL_TIMER_DRAW)
+            s.gl_draw_ms += ms;
+        else
+            s.gl_blit_ms += ms;
+    }
+
+    s.gl_gpu_start_ms = slot.num_queries > 0 ? ((GLint64)ns[0] - slot.gl_begin_ns) / 1000000.0 : 0.0;
+
+    finalize_frame(slot);
+    return true;
+}
+
+// finalizes the completed frames, oldest first (so the CSV stays in order)
+static void collect_frames(bool force)
+{
+    while (stats_oldest_frame < stats_next_frame)
+    {
+        frame_stats_slot& slot = stats_slots[stats_oldest_frame % FRAME_STATS_SLOTS];
+
+        if (slot.pending && !try_collect_frame(slot, force))
+            break;
+
+        ++stats_oldest_frame;
+    }
+}
+
+bool frame_stats_init(const char* csv_file, bool vk_timings)
+{
+    for (auto& slot : stats_slots)
+    {
+        glGenQueries(FRAME_STATS_QUERIES, slot.queries);
+        slot.num_queries = 0;
+        slot.pending = false;
+    }
+
+    if (csv_file)
+    {
+        stats_csv.open(csv_file);
+        if (!stats_csv)
+        {
+            std::cout << "ERROR: Failed to open GPU timings CSV file " << csv_file << std::endl;
+            return false;
+        }
+        stats_csv << "frame,cpu_begin_ns,cpu_frame_ms,gl_gpu_start_ms,gl_draw_ms,gl_blit_ms,vk_clear_ms,vk_draw_ms,vk_valid\n";
+    }
+
+    stats_vk_timings = vk_timings;
+    stats_current = nullptr;
+    stats_next_frame = 0;
+    stats_oldest_frame = 0;
+    stats_has_latest = false;
+    stats_num_frames = 0;
+    stats_num_vk_frames = 0;
+    stats_num_dropped = 0;
+    stats_sum = frame_stats();
+
+    stats_active = true;
+    return true;
+}
+
+void frame_stats_shutdown()
+{
+    if (!stats_active)
+        return;
+
+    // the caller waited for the GPU (glFinish()), the Vulkan timings of the last frames are missing though,
+    // their ring slots are not acquired again
+    collect_frames(true);
+
+    for (auto& slot : stats_slots)
+        glDeleteQueries(FRAME_STATS_QUERIES, slot.queries);
+
+    stats_csv.close();
+    stats_active = false;
+
+    if (stats_num_frames == 0)
+        return;
+
+    const double n = (double)stats_num_frames;
+    std::cout << "GPU timings (frames: " << stats_num_frames << ", dropped: " << stats_num_dropped << ")"
+        << " cpu frame: " << stats_sum.cpu_frame_ms / n << " ms"
+        << " gl start latency: " << stats_sum.gl_gpu_start_ms / n << " ms"
+        << " gl draw: " << stats_sum.gl_draw_ms / n << " ms"
+        << " gl blit: " << stats_sum.gl_blit_ms / n << " ms";
+
+    if (stats_num_vk_frames > 0)
+    {
+        const double vk_n = (double)stats_num_vk_frames;
+        std::cout << " vk clear: " << stats_sum.vk_clear_ms / vk_n << " ms"
+            << " vk draw: " << stats_sum.vk_draw_ms / vk_n << " ms";
+    }
+
+    std::cout << std::endl;
+}
+
+void frame_stats_begin_frame(uint64_t frame)
+{
+    if (!stats_active)
+        return;
+
+    collect_frames(false);
+
+    // the oldest frame still occupies the slot: finalize it with the results that are available or drop it,
+    // waiting would stall the pipeline
+    if (stats_next_frame - stats_oldest_frame >= FRAME_STATS_SLOTS)
+    {
+        frame_stats_slot& oldest = stats_slots[stats_oldest_frame % FRAME_STATS_SLOTS];
+        if (oldest.pending && !try_collect_frame(oldest, true))
+        {
+            oldest.pending = false;
+            ++stats_num_dropped;
+        }
+        ++stats_oldest_frame;
+        collect_frames(false);
+    }
+
+    frame_stats_slot& slot = stats_slots[stats_next_frame % FRAME_STATS_SLOTS];
+    ++stats_next_frame;
+
+    slot.num_queries = 0;
+    slot.pending = false;
+    slot.stats = frame_stats();
+    slot.stats.frame = frame;
+    slot.stats.cpu_begin_ns = piglit_time_get_nano();
+    glGetInteger64v(GL_TIMESTAMP, &slot.gl_begin_ns);
+
+    stats_current = &slot;
+
+    vk_set_frame_index(frame);
+}
+
+void frame_stats_end_frame()
+{
+    if (!stats_active || !stats_current)
+        return;
+
+    stats_current->stats.cpu_frame_ms = (piglit_time_get_nano() - stats_current->stats.cpu_begin_ns) / 1000000.0;
+    stats_current->pending = true;
+    stats_current = nullptr;
+}
+
+void gl_timer_begin(gl_timer timer)
+{
+    if (!stats_current || stats_current->num_queries + 2 > FRAME_STATS_QUERIES)
+        return;
+
+    stats_current->timers[stats_current->num_queries / 2] = timer;
+    glQueryCounter(stats_current->queries[stats_current->num_queries++], GL_TIMESTAMP);
+}
+
+void gl_timer_end(gl_timer timer)
+{
+    // unmatched end (the begin was skipped because the frame ran out of queries)
+    if (!stats_current || (stats_current->num_queries & 1) == 0)
+        return;
+
+    glQueryCounter(stats_current->queries[stats_current->num_queries++], GL_TIMESTAMP);
+}
+
+bool frame_stats_latest(frame_stats& out)
+{
+    if (!stats_has_latest)
+        return false;
+
+    out = stats_latest;
+    return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+// GPU timings per frame (vkgl-test -gpu-timers):
+// GL timestamp queries around the GL draws & the blit, Vulkan timestamp queries around the recorded
+// Vulkan work (see vk_render_settings::gpu_timestamps), the CPU clock is piglit_time_get_nano().
+// All queries are read back a few frames later without stalling, so a frame's stats become available
+// with a delay of up to 'frames-in-flight' + a couple of frames.
+
+enum gl_timer
+{
+    GL_TIMER_DRAW,      // gl_draw_mesh()
+    GL_TIMER_BLIT,      // VK-GL FBO -> window framebuffer
+
+    GL_TIMER_COUNT
+};
+
+struct frame_stats
+{
+    uint64_t frame = 0;
+    int64_t cpu_begin_ns = 0;       // piglit_time_get_nano() at frame_stats_begin_frame()
+    double cpu_frame_ms = 0.0;      // frame_stats_begin_frame() -> frame_stats_end_frame()
+    double gl_gpu_start_ms = 0.0;   // GPU start of the frame's first GL timer relative to cpu_begin_ns (GL queue latency)
+    double gl_draw_ms = 0.0;
+    double gl_blit_ms = 0.0;
+    double vk_clear_ms = 0.0;
+    double vk_draw_ms = 0.0;
+    bool vk_valid = false;          // the Vulkan timings were available (not available for pre-recorded command-buffers)
+};
+
+// csv_file: optional, one line per frame is appended while the app is running
+// vk_timings: wait for the Vulkan timings of a frame too (see vk_get_gpu_timings()) before it is finalized
+bool frame_stats_init(const char* csv_file, bool vk_timings);
+
+// prints the averages over all frames whose timings have been read back
+void frame_stats_shutdown();
+
+// all functions below are no-ops until frame_stats_init() was called
+void frame_stats_begin_frame(uint64_t frame);
+void frame_stats_end_frame();
+
+// timers of the same kind accumulate within a frame
+void gl_timer_begin(gl_timer timer);
+void gl_timer_end(gl_timer timer);
+
+// the most recent frame whose GL (and Vulkan, if enabled) timings are complete
+bool frame_stats_latest(frame_stats& out);
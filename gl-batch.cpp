@@ -0,0 +1,215 @@
+#include "gl-batch.h"
+
+#include "frame-stats.h"
+#include "trace.h"
+#include "vk-render.h"
+
+#include <learnopengl/shader_m.h>
+
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+// layout of GL_DRAW_INDIRECT_BUFFER entries for glMultiDrawArraysIndirect()
+struct gl_draw_arrays_cmd
+{
+    GLuint count;
+    GLuint instance_count;
+    GLuint first;
+    GLuint base_instance;
+};
+
+// std430 'Draw' of gl_batch.vs
+struct gl_batch_draw_data
+{
+    glm::mat4 model;
+    GLuint texture_slot;
+    GLuint pad[3];
+};
+
+struct gl_batch_mesh
+{
+    GLuint first;
+    GLuint count;
+};
+
+static bool batch_active = false;
+static uint32_t batch_max_draws = 0;
+
+static std::unique_ptr<Shader> batch_shader;
+static GLuint batch_vao = 0;
+static GLuint batch_vertex_buffer = 0;
+static GLuint batch_draw_index_buffer = 0;  // 0 .. max_draws - 1, one per instance
+static GLuint batch_indirect_buffer = 0;
+static GLuint batch_draw_data_buffer = 0;
+
+// merged vertices, re-uploaded on the next submit after a mesh was added
+static std::vector<float> batch_vertices;
+static std::vector<gl_batch_mesh> batch_meshes;
+static bool batch_vertices_dirty = false;
+
+static GLuint batch_textures[GL_BATCH_MAX_TEXTURES] = {};
+
+// draws since the last submit
+static std::vector<gl_draw_arrays_cmd> batch_cmds;
+static std::vector<gl_batch_draw_data> batch_draw_data;
+
+static void upload_vertices()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, batch_vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, batch_vertices.size() * sizeof(float), batch_vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    batch_vertices_dirty = false;
+}
+
+bool gl_batch_init(uint32_t max_draws, GLuint per_view_ubo_binding)
+{
+    if (!GLAD_GL_VERSION_4_3)
+    {
+        std::cout << "WARNING: the GL batch renderer requires GL 4.3 (multi-draw-indirect & shader storage buffers)" << std::endl;
+        return false;
+    }
+
+    batch_max_draws = max_draws;
+
+    batch_shader.reset(new Shader("gl_batch.vs", "gl_batch.fs"));
+    batch_shader->bindUniformBlock("PerView", per_view_ubo_binding);
+
+    GLint texture_units[GL_BATCH_MAX_TEXTURES];
+    std::iota(texture_units, texture_units + GL_BATCH_MAX_TEXTURES, 0);
+    batch_shader->use();
+    glUniform1iv(batch_shader->getUniformLocation("textures"), GL_BATCH_MAX_TEXTURES, texture_units);
+    glUseProgram(0);
+
+    glGenBuffers(1, &batch_vertex_buffer);
+    glGenBuffers(1, &batch_draw_index_buffer);
+    glGenBuffers(1, &batch_indirect_buffer);
+    glGenBuffers(1, &batch_draw_data_buffer);
+
+    std::vector<GLuint> draw_indices(max_draws);
+    std::iota(draw_indices.begin(), draw_indices.end(), 0u);
+    glBindBuffer(GL_ARRAY_BUFFER, batch_draw_index_buffer);
+    glBufferData(GL_ARRAY_BUFFER, draw_indices.size() * sizeof(GLuint), draw_indices.data(), GL_STATIC_DRAW);
+
+    glGenVertexArrays(1, &batch_vao);
+    glBindVertexArray(batch_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, batch_vertex_buffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VK_VERTEX_FLOATS * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, VK_VERTEX_FLOATS * sizeof(float), (void*)(3 * sizeof(float)));
+    glBindBuffer(GL_ARRAY_BUFFER, batch_draw_index_buffer);
+    glEnableVertexAttribArray(2);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+    glVertexAttribDivisor(2, 1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    batch_cmds.reserve(max_draws);
+    batch_draw_data.reserve(max_draws);
+
+    batch_active = true;
+    return true;
+}
+
+void gl_batch_shutdown()
+{
+    if (!batch_active)
+        return;
+
+    glDeleteVertexArrays(1, &batch_vao);
+    glDeleteBuffers(1, &batch_vertex_buffer);
+    glDeleteBuffers(1, &batch_draw_index_buffer);
+    glDeleteBuffers(1, &batch_indirect_buffer);
+    glDeleteBuffers(1, &batch_draw_data_buffer);
+    batch_vao = 0;
+    batch_vertex_buffer = batch_draw_index_buffer = batch_indirect_buffer = batch_draw_data_buffer = 0;
+
+    batch_shader.reset();
+    batch_vertices.clear();
+    batch_meshes.clear();
+    batch_cmds.clear();
+    batch_draw_data.clear();
+
+    batch_active = false;
+}
+
+bool gl_batch_enabled()
+{
+    return batch_active;
+}
+
+uint32_t gl_batch_add_mesh(const float* vertices, uint32_t num_vertices)
+{
+    batch_meshes.push_back({ (GLuint)(batch_vertices.size() / VK_VERTEX_FLOATS), num_vertices });
+    batch_vertices.insert(batch_vertices.end(), vertices, vertices + num_vertices * VK_VERTEX_FLOATS);
+    batch_vertices_dirty = true;
+
+    return (uint32_t)batch_meshes.size() - 1;
+}
+
+void gl_batch_set_texture(uint32_t slot, GLuint texture)
+{
+    if (slot < GL_BATCH_MAX_TEXTURES)
+        batch_textures[slot] = texture;
+}
+
+void gl_batch_draw(uint32_t mesh, const glm::mat4& model, uint32_t texture_slot)
+{
+    if (batch_cmds.size() == batch_max_draws)
+        gl_batch_submit();
+
+    const gl_batch_mesh& m = batch_meshes[mesh];
+    const GLuint draw_index = (GLuint)batch_cmds.size();
+
+    batch_cmds.push_back({ m.count, 1, m.first, draw_index });
+
+    gl_batch_draw_data data = {};
+    data.model = model;
+    data.texture_slot = texture_slot;
+    batch_draw_data.push_back(data);
+}
+
+void gl_batch_submit()
+{
+    if (batch_cmds.empty())
+        return;
+
+    TRACE_ZONE("gl_batch_submit");
+
+    if (batch_vertices_dirty)
+        upload_vertices();
+
+    // orphan the buffers of the previous submit, the GL may still read them
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch_indirect_buffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, batch_cmds.size() * sizeof(gl_draw_arrays_cmd), batch_cmds.data(), GL_STREAM_DRAW);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch_draw_data_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, batch_draw_data.size() * sizeof(gl_batch_draw_data), batch_draw_data.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GL_BATCH_SSBO_BINDING, batch_draw_data_buffer);
+
+    batch_shader->use();
+    glBindVertexArray(batch_vao);
+    for (uint32_t i = 0; i < GL_BATCH_MAX_TEXTURES; ++i)
+    {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, batch_textures[i]);
+    }
+
+    gl_timer_begin(GL_TIMER_DRAW);
+    glMultiDrawArraysIndirect(GL_TRIANGLES, nullptr, (GLsizei)batch_cmds.size(), 0);
+    gl_timer_end(GL_TIMER_DRAW);
+
+    for (uint32_t i = GL_BATCH_MAX_TEXTURES; i-- > 0;)
+    {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    batch_cmds.clear();
+    batch_draw_data.clear();
+}
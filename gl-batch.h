@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <stdint.h>
+
+// GL batch renderer (vkgl-test -gl-batch):
+// static meshes are merged into one vertex buffer (interleaved pos.xyz + uv, the VK_VERTEX_FLOATS layout),
+// the model matrix & texture slot of every draw go into a shader storage buffer and all draws of a frame
+// are submitted with a single glMultiDrawArraysIndirect() (one VAO, one program, one set of texture bindings).
+// The index of a draw reaches the shader through an instanced vertex attribute offset by the baseInstance
+// of its indirect command (no GL_ARB_shader_draw_parameters needed).
+// Requires GL 4.3 (multi-draw-indirect, shader storage buffers).
+
+#define GL_BATCH_MAX_TEXTURES 4         // texture slots of a batch (texture units 0 .. GL_BATCH_MAX_TEXTURES - 1)
+#define GL_BATCH_SSBO_BINDING 0         // GL_SHADER_STORAGE_BUFFER binding point of the per-draw data
+
+// max_draws: draws per glMultiDrawArraysIndirect(), more draws per frame are submitted in several batches
+// per_view_ubo_binding: binding point of the 'PerView' uniform block (view & projection, see gl_update_per_view())
+bool gl_batch_init(uint32_t max_draws, GLuint per_view_ubo_binding);
+void gl_batch_shutdown();
+
+bool gl_batch_enabled();
+
+// appends the vertices to the merged vertex buffer, returns the mesh index for gl_batch_draw()
+uint32_t gl_batch_add_mesh(const float* vertices, uint32_t num_vertices);
+
+void gl_batch_set_texture(uint32_t slot, GLuint texture);
+
+void gl_batch_draw(uint32_t mesh, const glm::mat4& model, uint32_t texture_slot);
+
+// submits the draws since the last submit (one glMultiDrawArraysIndirect)
+void gl_batch_submit();
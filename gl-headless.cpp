@@ -0,0 +1,204 @@
+#include "gl-headless.h"
+
+#include <iostream>
+
+#if VKGL_HAS_EGL
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstring>
+
+static EGLDisplay egl_display = EGL_NO_DISPLAY;
+static EGLContext egl_context = EGL_NO_CONTEXT;
+static EGLSurface egl_surface = EGL_NO_SURFACE;
+
+static bool egl_has_extension(const char* extensions, const char* name)
+{
+    if (!extensions)
+        return false;
+
+    const size_t name_len = strlen(name);
+    for (const char* ext = strstr(extensions, name); ext; ext = strstr(ext + name_len, name))
+    {
+        const bool starts_token = (ext == extensions) || (ext[-1] == ' ');
+        const bool ends_token = (ext[name_len] == ' ') || (ext[name_len] == '\0');
+        if (starts_token && ends_token)
+            return true;
+    }
+
+    return false;
+}
+
+static EGLDisplay egl_open_display()
+{
+    // client extensions can be queried without a display
+    const char* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+#if defined(EGL_PLATFORM_SURFACELESS_MESA)
+    // Mesa surfaceless platform: works without X11 / Wayland / DRM master (e.g. llvmpipe on CI machines)
+    auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display && egl_has_extension(client_extensions, "EGL_MESA_platform_surfaceless"))
+    {
+        EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display != EGL_NO_DISPLAY)
+        {
+            std::cout << "EGL platform: surfaceless" << std::endl;
+            return display;
+        }
+    }
+#endif
+
+    std::cout << "EGL platform: default" << std::endl;
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool gl_headless_init(bool debug_context)
+{
+    egl_display = egl_open_display();
+
+    EGLint major = 0, minor = 0;
+    if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, &major, &minor))
+    {
+        std::cout << "ERROR: Failed to initialize EGL display" << std::endl;
+        return false;
+    }
+    std::cout << "EGL version: " << major << "." << minor << std::endl;
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        std::cout << "ERROR: EGL does not support desktop OpenGL" << std::endl;
+        return false;
+    }
+
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_NONE
+    };
+
+    EGLConfig config = nullptr;
+    EGLint num_configs = 0;
+    if (!eglChooseConfig(egl_display, config_attribs, &config, 1, &num_configs) || num_configs < 1)
+    {
+        std::cout << "ERROR: No suitable EGL config" << std::endl;
+        return false;
+    }
+
+    // the version / profile / debug attributes are core in EGL 1.5, EGL 1.4 needs EGL_KHR_create_context for them
+    // (same values for the version & profile tokens, the debug flag is a bit of EGL_CONTEXT_FLAGS_KHR there)
+    const char* display_extensions = eglQueryString(egl_display, EGL_EXTENSIONS);
+    const bool egl_15 = major > 1 || (major == 1 && minor >= 5);
+    const bool khr_create_context = egl_has_extension(display_extensions, "EGL_KHR_create_context");
+
+    EGLint context_attribs[9];
+    int num_attribs = 0;
+    if (egl_15 || khr_create_context)
+    {
+        context_attribs[num_attribs++] = EGL_CONTEXT_MAJOR_VERSION_KHR;
+        context_attribs[num_attribs++] = 4;
+        context_attribs[num_attribs++] = EGL_CONTEXT_MINOR_VERSION_KHR;
+        context_attribs[num_attribs++] = 5;
+        context_attribs[num_attribs++] = EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR;
+        context_attribs[num_attribs++] = EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR;
+        if (debug_context && egl_15)
+        {
+            context_attribs[num_attribs++] = EGL_CONTEXT_OPENGL_DEBUG;
+            context_attribs[num_attribs++] = EGL_TRUE;
+        }
+        else if (debug_context)
+        {
+            context_attribs[num_attribs++] = EGL_CONTEXT_FLAGS_KHR;
+            context_attribs[num_attribs++] = EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR;
+        }
+    }
+    else
+    {
+        std::cout << "WARNING: EGL " << major << "." << minor
+            << " without EGL_KHR_create_context, the context version & debug flag can't be requested" << std::endl;
+    }
+    context_attribs[num_attribs] = EGL_NONE;
+
+    egl_context = eglCreateContext(egl_display, config, EGL_NO_CONTEXT, context_attribs);
+    if (egl_context == EGL_NO_CONTEXT)
+    {
+        std::cout << "ERROR: Failed to create EGL context" << std::endl;
+        return false;
+    }
+
+    // without EGL_KHR_surfaceless_context a (tiny) pbuffer is needed to make the context current,
+    // it is never rendered to
+    if (!egl_has_extension(display_extensions, "EGL_KHR_surfaceless_context"))
+    {
+        const EGLint pbuffer_attribs[] = {
+            EGL_WIDTH, 1,
+            EGL_HEIGHT, 1,
+            EGL_NONE
+        };
+
+        egl_surface = eglCreatePbufferSurface(egl_display, config, pbuffer_attribs);
+        if (egl_surface == EGL_NO_SURFACE)
+        {
+            std::cout << "ERROR: Failed to create EGL pbuffer surface" << std::endl;
+            return false;
+        }
+    }
+
+    if (!eglMakeCurrent(egl_display, egl_surface, egl_surface, egl_context))
+    {
+        std::cout << "ERROR: Failed to make EGL context current" << std::endl;
+        return false;
+    }
+
+    // headless frames are never presented, so there is nothing to wait for
+    eglSwapInterval(egl_display, 0);
+
+    return true;
+}
+
+void* gl_headless_get_proc_address(const char* name)
+{
+    return (void*)eglGetProcAddress(name);
+}
+
+void gl_headless_shutdown()
+{
+    if (egl_display == EGL_NO_DISPLAY)
+        return;
+
+    eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+    if (egl_surface != EGL_NO_SURFACE)
+        eglDestroySurface(egl_display, egl_surface);
+    if (egl_context != EGL_NO_CONTEXT)
+        eglDestroyContext(egl_display, egl_context);
+
+    eglTerminate(egl_display);
+
+    egl_surface = EGL_NO_SURFACE;
+    egl_context = EGL_NO_CONTEXT;
+    egl_display = EGL_NO_DISPLAY;
+}
+
+#else
+
+bool gl_headless_init(bool debug_context)
+{
+    std::cout << "ERROR: headless mode is not available (vkgl-test was built without EGL)" << std::endl;
+    return false;
+}
+
+void* gl_headless_get_proc_address(const char* name)
+{
+    return nullptr;
+}
+
+void gl_headless_shutdown()
+{
+}
+
+#endif
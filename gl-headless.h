@@ -0,0 +1,10 @@
+#pragma once
+
+// Offscreen GL context for display-less machines, used instead of the GLFW window in headless mode.
+// The context is created through EGL (surfaceless platform / surfaceless context if available, otherwise a tiny pbuffer),
+// so there is no default framebuffer to render into: everything goes to the vkgl interop FBO.
+// NOTE: only available when EGL was found at configure time (VKGL_HAS_EGL), otherwise gl_headless_init() fails.
+
+bool gl_headless_init(bool debug_context);
+void* gl_headless_get_proc_address(const char* name);
+void gl_headless_shutdown();
@@ -0,0 +1,20 @@
+#version 430 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+flat in uint TextureSlot;
+
+// GL_BATCH_MAX_TEXTURES (gl-batch.h), on texture units 0 .. 3
+uniform sampler2D textures[4];
+
+void main()
+{
+    // constant indices only, the slot is not dynamically uniform within a multi-draw
+    switch (TextureSlot)
+    {
+    case 0u: FragColor = texture(textures[0], TexCoords); break;
+    case 1u: FragColor = texture(textures[1], TexCoords); break;
+    case 2u: FragColor = texture(textures[2], TexCoords); break;
+    default: FragColor = texture(textures[3], TexCoords); break;
+    }
+}
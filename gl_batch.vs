@@ -0,0 +1,33 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+// index of the draw in the batch: instanced attribute, offset by the baseInstance of the indirect command
+layout (location = 2) in uint aDrawIndex;
+
+out vec2 TexCoords;
+flat out uint TextureSlot;
+
+layout (std140) uniform PerView
+{
+    mat4 view;
+    mat4 projection;
+};
+
+struct Draw
+{
+    mat4 model;
+    uvec4 textureSlot;  // x: texture unit, yzw: padding
+};
+
+layout (std430, binding = 0) readonly buffer Draws
+{
+    Draw draws[];
+};
+
+void main()
+{
+    Draw draw = draws[aDrawIndex];
+    TexCoords = aTexCoords;
+    TextureSlot = draw.textureSlot.x;
+    gl_Position = projection * view * draw.model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// Bounded single-producer / single-consumer ring, lock-free & without allocations after construction:
+// the producer fills the slot returned by try_reserve() in place and publishes it with push(),
+// the consumer reads front() and hands the slot back with pop(). The slots are reused, members with their own
+// storage (e.g. a std::vector) keep their capacity from one use to the next.
+// All index accesses are sequentially consistent, so a consumer that parks itself (sets a flag, then checks empty())
+// can't miss a push() that is followed by a check of that flag.
+template <typename T, uint32_t N>
+class spsc_queue
+{
+public:
+    // producer: the slot to fill, nullptr while the queue is full
+    T* try_reserve()
+    {
+        const uint32_t tail = tail_idx.load();
+        if (tail - head_idx.load() == N)
+            return nullptr;
+        return &slots[tail % N];
+    }
+
+    // producer: publishes the slot returned by try_reserve()
+    void push()
+    {
+        tail_idx.store(tail_idx.load() + 1);
+    }
+
+    // consumer: the oldest published slot, nullptr while the queue is empty
+    T* front()
+    {
+        const uint32_t head = head_idx.load();
+        if (head == tail_idx.load())
+            return nullptr;
+        return &slots[head % N];
+    }
+
+    // consumer: hands the slot returned by front() back to the producer
+    void pop()
+    {
+        head_idx.store(head_idx.load() + 1);
+    }
+
+    bool empty() const
+    {
+        return head_idx.load() == tail_idx.load();
+    }
+
+private:
+    T slots[N];
+
+    // on separate cache lines, each one is only written by one side
+    alignas(64) std::atomic<uint32_t> head_idx{ 0 };
+    alignas(64) std::atomic<uint32_t> tail_idx{ 0 };
+};
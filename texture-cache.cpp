@@ -0,0 +1,478 @@
+// windows.h has to come before glad.h, otherwise it redefines APIENTRY
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "texture-cache.h"
+
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define TEX_CACHE_FILE_MAGIC 0x58544756     // "VGTX"
+#define TEX_CACHE_FILE_VERSION 1
+#define TEX_CACHE_MAX_LEVELS 16
+#define TEX_CACHE_LEVEL_ALIGNMENT 16
+
+// header of a cache file, followed by 'num_levels' level entries and the texel / block data of the levels
+struct tex_cache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_hash;           // FNV-1a of the source file contents
+    uint64_t source_size;
+    uint32_t internal_format;       // sized GL internal format (GL_RGBA8, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, ...)
+    uint32_t format;                // pixel format of the uncompressed levels (GL_RGBA, ...), 0 == compressed blocks
+    uint32_t width;
+    uint32_t height;
+    uint32_t num_levels;
+    uint32_t reserved;
+};
+
+struct tex_cache_level
+{
+    uint64_t offset;                // from the start of the file
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct mapped_file
+{
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+static bool cache_active = false;
+static std::string cache_dir;
+static bool cache_compress = false;
+
+static uint32_t cache_hits = 0;
+static uint32_t cache_misses = 0;
+static uint32_t cache_stores = 0;
+static double cache_load_ms = 0.0;
+
+static void unmap_file(mapped_file& mf)
+{
+#ifdef _WIN32
+    if (mf.data)
+        UnmapViewOfFile(mf.data);
+    if (mf.mapping)
+        CloseHandle(mf.mapping);
+    if (mf.file != INVALID_HANDLE_VALUE)
+        CloseHandle(mf.file);
+    mf.file = INVALID_HANDLE_VALUE;
+    mf.mapping = nullptr;
+#else
+    if (mf.data)
+        munmap((void*)mf.data, mf.size);
+    if (mf.fd >= 0)
+        close(mf.fd);
+    mf.fd = -1;
+#endif
+    mf.data = nullptr;
+    mf.size = 0;
+}
+
+// read-only mapping of the whole file, false if it does not exist (or is empty)
+static bool map_file(const char* path, mapped_file& mf)
+{
+#ifdef _WIN32
+    mf.file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (mf.file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mf.file, &size) || size.QuadPart == 0)
+    {
+        unmap_file(mf);
+        return false;
+    }
+
+    mf.mapping = CreateFileMappingA(mf.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mf.mapping)
+        mf.data = (const unsigned char*)MapViewOfFile(mf.mapping, FILE_MAP_READ, 0, 0, 0);
+    mf.size = (size_t)size.QuadPart;
+#else
+    mf.fd = open(path, O_RDONLY);
+    if (mf.fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(mf.fd, &st) != 0 || st.st_size == 0)
+    {
+        unmap_file(mf);
+        return false;
+    }
+
+    mf.size = (size_t)st.st_size;
+    void* data = mmap(nullptr, mf.size, PROT_READ, MAP_PRIVATE, mf.fd, 0);
+    mf.data = data != MAP_FAILED ? (const unsigned char*)data : nullptr;
+#endif
+
+    if (!mf.data)
+    {
+        unmap_file(mf);
+        return false;
+    }
+    return true;
+}
+
+static uint64_t fnv1a_64(const unsigned char* data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static bool hash_source_file(const char* path, uint64_t& hash, uint64_t& size)
+{
+    TRACE_ZONE("tex_cache_hash");
+
+    mapped_file mf;
+    if (!map_file(path, mf))
+        return false;
+
+    hash = fnv1a_64(mf.data, mf.size);
+    size = mf.size;
+    unmap_file(mf);
+    return true;
+}
+
+static std::string cache_file_path(uint64_t source_hash)
+{
+    std::ostringstream name;
+    // compressed & uncompressed mip chains of the same source live side by side
+    name << cache_dir << "/" << std::hex << std::setw(16) << std::setfill('0') << source_hash
+        << (cache_compress ? "-s3tc" : "") << TEX_CACHE_FILE_EXTENSION;
+    return name.str();
+}
+
+static bool is_compressed_format_supported(uint32_t internal_format)
+{
+    if (internal_format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || internal_format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+        return GLAD_GL_EXT_texture_compression_s3tc != 0;
+    return false;
+}
+
+// byte size of a level as tex_cache_store() writes it, 0 for a format it never writes
+static uint64_t expected_level_size(const tex_cache_header& hdr, uint32_t width, uint32_t height)
+{
+    if (hdr.format == 0)
+    {
+        // 4x4 blocks, 8 bytes with DXT1, 16 bytes with DXT5
+        const uint64_t blocks = (uint64_t)((width + 3) / 4) * ((height + 3) / 4);
+        if (hdr.internal_format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+            return blocks * 8;
+        if (hdr.internal_format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+            return blocks * 16;
+        return 0;
+    }
+
+    uint64_t components = 0;
+    switch (hdr.format)
+    {
+    case GL_RED: components = 1; break;
+    case GL_RG: components = 2; break;
+    case GL_RGB: components = 3; break;
+    case GL_RGBA: components = 4; break;
+    }
+    return (uint64_t)width * height * components;
+}
+
+static const char* file_name(const char* path)
+{
+    const char* slash = std::max(std::strrchr(path, '/'), std::strrchr(path, '\\'));
+    return slash ? slash + 1 : path;
+}
+
+void tex_cache_init(const char* dir, bool compress)
+{
+    cache_active = dir != nullptr;
+    if (!cache_active)
+        return;
+
+    cache_dir = dir;
+    cache_compress = compress;
+
+    if (cache_compress && !GLAD_GL_EXT_texture_compression_s3tc)
+    {
+        std::cout << "WARNING: GL_EXT_texture_compression_s3tc is not supported, the texture cache stores uncompressed texels" << std::endl;
+        cache_compress = false;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(cache_dir, ec);
+
+    cache_hits = 0;
+    cache_misses = 0;
+    cache_stores = 0;
+    cache_load_ms = 0.0;
+}
+
+void tex_cache_shutdown()
+{
+    if (!cache_active)
+        return;
+
+    cache_active = false;
+
+    if (cache_hits + cache_misses == 0)
+        return;
+
+    std::cout << "texture cache (" << cache_dir << "): " << cache_hits << " hits, " << cache_misses << " misses"
+        << " (" << cache_stores << " written), hits uploaded in " << cache_load_ms << " ms" << std::endl;
+}
+
+GLuint tex_cache_load(const char* path)
+{
+    if (!cache_active)
+        return 0;
+
+    TRACE_ZONE("tex_cache_load");
+
+    const auto begin = std::chrono::steady_clock::now();
+
+    uint64_t source_hash = 0, source_size = 0;
+    if (!hash_source_file(path, source_hash, source_size))
+    {
+        ++cache_misses;
+        return 0;
+    }
+
+    const std::string cache_file = cache_file_path(source_hash);
+
+    // no cache file yet: cold start
+    mapped_file mf;
+    if (!map_file(cache_file.c_str(), mf))
+    {
+        ++cache_misses;
+        return 0;
+    }
+
+    const tex_cache_header* hdr = (const tex_cache_header*)mf.data;
+    const tex_cache_level* levels = (const tex_cache_level*)(mf.data + sizeof(tex_cache_header));
+
+    bool valid =
+        mf.size >= sizeof(tex_cache_header)
+        && hdr->magic == TEX_CACHE_FILE_MAGIC
+        && hdr->version == TEX_CACHE_FILE_VERSION
+        && hdr->source_hash == source_hash
+        && hdr->source_size == source_size
+        && hdr->width > 0 && hdr->height > 0
+        && hdr->width < (1u << TEX_CACHE_MAX_LEVELS) && hdr->height < (1u << TEX_CACHE_MAX_LEVELS)
+        && hdr->num_levels > 0 && hdr->num_levels <= TEX_CACHE_MAX_LEVELS
+        && mf.size >= sizeof(tex_cache_header) + hdr->num_levels * sizeof(tex_cache_level);
+
+    // the GL reads as many bytes as the level dimensions & format imply, whatever the level entry says,
+    // so the dimensions have to be the ones of the mip chain and the size has to match them
+    for (uint32_t i = 0; valid && i < hdr->num_levels; ++i)
+    {
+        const tex_cache_level& level = levels[i];
+        const uint64_t expected_size = expected_level_size(*hdr, level.width, level.height);
+
+        valid = level.width == std::max(1u, hdr->width >> i)
+            && level.height == std::max(1u, hdr->height >> i)
+            && expected_size != 0 && level.size == expected_size
+            && level.offset <= mf.size && level.size <= mf.size - level.offset;
+    }
+
+    if (!valid)
+    {
+        std::cout << "WARNING: Ignoring invalid texture cache file " << cache_file << std::endl;
+        unmap_file(mf);
+        ++cache_misses;
+        return 0;
+    }
+
+    // e.g. a cache directory that was copied from a machine with a different GL driver
+    if (hdr->format == 0 && !is_compressed_format_supported(hdr->internal_format))
+    {
+        unmap_file(mf);
+        ++cache_misses;
+        return 0;
+    }
+
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    glTexStorage2D(GL_TEXTURE_2D, hdr->num_levels, hdr->internal_format, hdr->width, hdr->height);
+    for (uint32_t i = 0; i < hdr->num_levels; ++i)
+    {
+        const tex_cache_level& level = levels[i];
+        const void* texels = mf.data + level.offset;
+
+        if (hdr->format == 0)
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height, hdr->internal_format, (GLsizei)level.size, texels);
+        else
+            glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height, hdr->format, GL_UNSIGNED_BYTE, texels);
+    }
+
+    // same sampler state as loadTexture()
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // the GL copied the texels of client memory uploads before returning
+    unmap_file(mf);
+
+    ++cache_hits;
+    cache_load_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    return tex;
+}
+
+bool tex_cache_store(const char* path, GLuint tex, int components)
+{
+    if (!cache_active || components < 1 || components > 4)
+        return false;
+
+    TRACE_ZONE("tex_cache_store");
+
+    uint64_t source_hash = 0, source_size = 0;
+    if (!hash_source_file(path, source_hash, source_size))
+        return false;
+
+    static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    static const GLenum sized_formats[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+
+    // S3TC only for color images, DXT1 has no alpha
+    const bool compress = cache_compress && components >= 3;
+
+    tex_cache_header hdr;
+    std::memset(&hdr, 0, sizeof hdr);
+    hdr.magic = TEX_CACHE_FILE_MAGIC;
+    hdr.version = TEX_CACHE_FILE_VERSION;
+    hdr.source_hash = source_hash;
+    hdr.source_size = source_size;
+    hdr.format = compress ? 0 : formats[components - 1];
+    hdr.internal_format = compress
+        ? (components == 3 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+        : sized_formats[components - 1];
+
+    GLint width = 0, height = 0;
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+    hdr.width = (uint32_t)width;
+    hdr.height = (uint32_t)height;
+    while (hdr.num_levels < TEX_CACHE_MAX_LEVELS && (std::max(width, height) >> hdr.num_levels) > 0)
+        ++hdr.num_levels;
+
+    std::vector<tex_cache_level> levels(hdr.num_levels);
+    std::vector<std::vector<unsigned char>> level_data(hdr.num_levels);
+
+    // the driver compresses each level in a scratch texture, the blocks are read back from there
+    GLuint scratch_tex = 0;
+    if (compress)
+        glGenTextures(1, &scratch_tex);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    uint64_t offset = sizeof(tex_cache_header) + hdr.num_levels * sizeof(tex_cache_level);
+    for (uint32_t i = 0; i < hdr.num_levels; ++i)
+    {
+        tex_cache_level& level = levels[i];
+        level.width = std::max(1u, hdr.width >> i);
+        level.height = std::max(1u, hdr.height >> i);
+
+        std::vector<unsigned char>& data = level_data[i];
+        data.resize((size_t)level.width * level.height * components);
+
+        glBindTexture(GL_TEXTURE_2D, tex);
+        glGetTexImage(GL_TEXTURE_2D, i, formats[components - 1], GL_UNSIGNED_BYTE, data.data());
+
+        if (compress)
+        {
+            GLint compressed_size = 0;
+            glBindTexture(GL_TEXTURE_2D, scratch_tex);
+            glTexImage2D(GL_TEXTURE_2D, 0, hdr.internal_format, level.width, level.height, 0, formats[components - 1], GL_UNSIGNED_BYTE, data.data());
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &compressed_size);
+
+            data.resize((size_t)compressed_size);
+            glGetCompressedTexImage(GL_TEXTURE_2D, 0, data.data());
+        }
+
+        offset = (offset + TEX_CACHE_LEVEL_ALIGNMENT - 1) & ~(uint64_t)(TEX_CACHE_LEVEL_ALIGNMENT - 1);
+        level.offset = offset;
+        level.size = data.size();
+        offset += level.size;
+    }
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (scratch_tex)
+        glDeleteTextures(1, &scratch_tex);
+
+    // write to a temporary file first, so that a crash never leaves a truncated cache file behind
+    const std::string cache_file = cache_file_path(source_hash);
+    const std::string tmp_file = cache_file + ".tmp";
+
+    bool ok = false;
+    {
+        std::ofstream out(tmp_file, std::ios::binary);
+        if (out)
+        {
+            out.write((const char*)&hdr, sizeof hdr);
+            out.write((const char*)levels.data(), levels.size() * sizeof(tex_cache_level));
+            for (uint32_t i = 0; i < hdr.num_levels; ++i)
+            {
+                static const char padding[TEX_CACHE_LEVEL_ALIGNMENT] = {};
+                out.write(padding, levels[i].offset - (uint64_t)out.tellp());
+                out.write((const char*)level_data[i].data(), level_data[i].size());
+            }
+            ok = out.good();
+        }
+    }
+
+    std::error_code ec;
+    if (ok)
+    {
+        std::filesystem::rename(tmp_file, cache_file, ec);
+        ok = !ec;
+    }
+
+    if (!ok)
+    {
+        std::cout << "WARNING: Failed to write texture cache file " << cache_file << " (" << file_name(path) << ")" << std::endl;
+        std::filesystem::remove(tmp_file, ec);
+        return false;
+    }
+
+    ++cache_stores;
+    return true;
+}
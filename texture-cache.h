@@ -0,0 +1,26 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <stdint.h>
+
+// Pre-baked texture cache (one file per texture in 'dir', see vkgl_options.h):
+// the full mip chain in upload-ready form (sized uncompressed texels, or S3TC blocks compressed by the GL driver
+// when enabled & supported), keyed by a hash of the source file contents. A cache hit memory-maps the file and
+// uploads the levels straight from the mapping, no image decode and no glGenerateMipmap().
+// A cache miss returns 0, the caller decodes the image itself and calls tex_cache_store() afterwards.
+
+#define TEX_CACHE_FILE_EXTENSION ".vkgltex"
+
+// dir == nullptr: the cache is disabled (tex_cache_load() always misses, tex_cache_store() does nothing)
+void tex_cache_init(const char* dir, bool compress);
+
+// prints the hit / miss statistics
+void tex_cache_shutdown();
+
+// the texture from the cache file of the source image 'path', 0 on a cache miss
+GLuint tex_cache_load(const char* path);
+
+// reads back all mip levels of 'tex' (decoded from 'path', with 'components' channels) and writes the cache file;
+// reading back waits for the GPU, so this is meant for the first run only
+bool tex_cache_store(const char* path, GLuint tex, int components);
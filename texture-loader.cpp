@@ -0,0 +1,426 @@
+#include "texture-loader.h"
+
+#include "texture-cache.h"
+#include "trace.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define TEX_LOADER_RING_ALIGNMENT 256   // offsets of the uploads in the ring (a multiple of every texel size)
+
+struct tex_job
+{
+    GLuint tex;
+    std::string path;
+};
+
+struct tex_image
+{
+    GLuint tex;
+    std::string path;
+    int width, height, components;
+    unsigned char* data;            // nullptr: decoding failed
+};
+
+// uploaded region of the pixel-unpack ring, in use until the GL reached 'fence'
+struct tex_ring_region
+{
+    size_t offset;
+    size_t size;
+    GLsync fence;
+};
+
+static bool loader_active = false;
+
+// DECODE THREADS
+static std::vector<std::thread> loader_threads;
+static std::mutex loader_mutex;
+static std::condition_variable loader_jobs_cv;      // new jobs / quit
+static std::condition_variable loader_results_cv;   // new decoded images
+static std::deque<tex_job> loader_jobs;
+static std::deque<tex_image> loader_results;
+static bool loader_quit = false;
+
+// GL THREAD
+static std::deque<tex_image> loader_ready;          // decoded, waiting for ring space
+static uint32_t loader_pending = 0;                 // loaded textures that still have the placeholder
+
+// PIXEL-UNPACK RING (persistently mapped)
+static GLuint ring_buffer = 0;
+static unsigned char* ring_ptr = nullptr;
+static size_t ring_head = 0;
+static std::deque<tex_ring_region> ring_regions;    // oldest first
+
+static void decode_thread_main()
+{
+    if (trace_enabled())
+        trace_set_thread_name("texture decode");
+
+    for (;;)
+    {
+        tex_job job;
+        {
+            std::unique_lock<std::mutex> lock(loader_mutex);
+            loader_jobs_cv.wait(lock, [] { return loader_quit || !loader_jobs.empty(); });
+            if (loader_quit)
+                return;
+
+            job = std::move(loader_jobs.front());
+            loader_jobs.pop_front();
+        }
+
+        tex_image img;
+        img.tex = job.tex;
+        img.path = std::move(job.path);
+        {
+            TRACE_ZONE("stbi_load");
+            img.data = stbi_load(img.path.c_str(), &img.width, &img.height, &img.components, 0);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(loader_mutex);
+            loader_results.push_back(std::move(img));
+        }
+        loader_results_cv.notify_one();
+    }
+}
+
+static GLenum image_format(int components)
+{
+    if (components == 1)
+        return GL_RED;
+    if (components == 2)
+        return GL_RG;
+    if (components == 3)
+        return GL_RGB;
+    return GL_RGBA;
+}
+
+// frees the oldest regions until 'size' bytes fit behind the ring head, never waits for the GPU unless 'wait' is set
+static bool ring_alloc(size_t size, bool wait, size_t& offset)
+{
+    for (;;)
+    {
+        if (ring_regions.empty())
+        {
+            ring_head = 0;
+            offset = 0;
+            break;
+        }
+
+        // the ring is full when the head caught up with the oldest region
+        const size_t tail = ring_regions.front().offset;
+        if (ring_head > tail)
+        {
+            if (ring_head + size <= TEX_LOADER_RING_SIZE)
+            {
+                offset = ring_head;
+                break;
+            }
+            // wrap around, the rest of the ring stays unused for this round
+            if (size <= tail)
+            {
+                offset = 0;
+                break;
+            }
+        }
+        else if (ring_head + size <= tail)
+        {
+            offset = ring_head;
+            break;
+        }
+
+        tex_ring_region& oldest = ring_regions.front();
+        const GLenum status = glClientWaitSync(oldest.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return false;
+
+        glDeleteSync(oldest.fence);
+        ring_regions.pop_front();
+    }
+
+    const size_t end = (offset + size + TEX_LOADER_RING_ALIGNMENT - 1) & ~(size_t)(TEX_LOADER_RING_ALIGNMENT - 1);
+    ring_head = std::min<size_t>(end, TEX_LOADER_RING_SIZE);
+    return true;
+}
+
+// replaces the placeholder of the texture, false: no ring space yet (try again next update)
+static bool upload_image(const tex_image& img, bool wait)
+{
+    TRACE_ZONE("tex_loader_upload");
+
+    const GLenum format = image_format(img.components);
+    const size_t size = (size_t)img.width * img.height * img.components;
+
+    size_t offset = 0;
+    const bool use_ring = ring_ptr && size <= TEX_LOADER_RING_SIZE;
+    if (use_ring && !ring_alloc(size, wait, offset))
+        return false;
+
+    glBindTexture(GL_TEXTURE_2D, img.tex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if (use_ring)
+    {
+        std::memcpy(ring_ptr + offset, img.data, size);
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring_buffer);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, img.width, img.height, 0, format, GL_UNSIGNED_BYTE, (const void*)(uintptr_t)offset);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        ring_regions.push_back({ offset, size, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+    }
+    else
+    {
+        // larger than the whole ring (or no GL_ARB_buffer_storage): straight from client memory
+        glTexImage2D(GL_TEXTURE_2D, 0, format, img.width, img.height, 0, format, GL_UNSIGNED_BYTE, img.data);
+    }
+
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return true;
+}
+
+static uint32_t update(size_t budget, bool wait)
+{
+    {
+        std::lock_guard<std::mutex> lock(loader_mutex);
+        while (!loader_results.empty())
+        {
+            loader_ready.push_back(std::move(loader_results.front()));
+            loader_results.pop_front();
+        }
+    }
+
+    size_t uploaded = 0;
+    while (!loader_ready.empty() && uploaded < budget)
+    {
+        tex_image& img = loader_ready.front();
+
+        if (img.data)
+        {
+            if (!upload_image(img, wait))
+                break;
+
+            uploaded += (size_t)img.width * img.height * img.components;
+            stbi_image_free(img.data);
+        }
+        else
+        {
+            std::cout << "Texture failed to load at path: " << img.path << std::endl;
+        }
+
+        loader_ready.pop_front();
+        --loader_pending;
+    }
+
+    return loader_pending;
+}
+
+bool tex_loader_init(uint32_t num_threads)
+{
+    if (num_threads == 0)
+        num_threads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+    // without persistent mapping the images are uploaded from client memory, still decoded in parallel
+    if (glBufferStorage)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        glGenBuffers(1, &ring_buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring_buffer);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, TEX_LOADER_RING_SIZE, nullptr, flags);
+        ring_ptr = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, TEX_LOADER_RING_SIZE, flags);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (!ring_ptr)
+        {
+            std::cout << "WARNING: Failed to map the texture upload ring, uploading from client memory" << std::endl;
+            glDeleteBuffers(1, &ring_buffer);
+            ring_buffer = 0;
+        }
+    }
+    else
+    {
+        std::cout << "WARNING: GL_ARB_buffer_storage is not supported, uploading textures from client memory" << std::endl;
+    }
+
+    ring_head = 0;
+    loader_pending = 0;
+    loader_quit = false;
+
+    for (uint32_t i = 0; i < num_threads; ++i)
+        loader_threads.emplace_back(decode_thread_main);
+
+    loader_active = true;
+    return true;
+}
+
+void tex_loader_shutdown()
+{
+    if (!loader_active)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(loader_mutex);
+        loader_quit = true;
+        loader_jobs.clear();
+    }
+    loader_jobs_cv.notify_all();
+
+    for (auto& thread : loader_threads)
+        thread.join();
+    loader_threads.clear();
+
+    for (auto* images : { &loader_results, &loader_ready })
+    {
+        for (auto& img : *images)
+            stbi_image_free(img.data);
+        images->clear();
+    }
+
+    for (auto& region : ring_regions)
+        glDeleteSync(region.fence);
+    ring_regions.clear();
+
+    if (ring_buffer)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring_buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &ring_buffer);
+        ring_buffer = 0;
+        ring_ptr = nullptr;
+    }
+
+    loader_pending = 0;
+    loader_active = false;
+}
+
+bool tex_loader_enabled()
+{
+    return loader_active;
+}
+
+uint32_t tex_loader_num_threads()
+{
+    return (uint32_t)loader_threads.size();
+}
+
+GLuint tex_loader_load(const char* path)
+{
+    // same sampler state as loadTexture(), a single mip level is complete for the placeholder
+    static const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+
+    // pre-baked mip chains are uploaded right away, there is nothing to decode
+    GLuint tex = tex_cache_load(path);
+    if (tex)
+        return tex;
+
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    {
+        std::lock_guard<std::mutex> lock(loader_mutex);
+        loader_jobs.push_back({ tex, path });
+    }
+    loader_jobs_cv.notify_one();
+
+    ++loader_pending;
+    return tex;
+}
+
+uint32_t tex_loader_update()
+{
+    if (!loader_active || loader_pending == 0)
+        return 0;
+
+    TRACE_ZONE("tex_loader_update");
+    return update(TEX_LOADER_UPLOAD_BUDGET, false);
+}
+
+void tex_loader_finish()
+{
+    if (!loader_active)
+        return;
+
+    TRACE_ZONE("tex_loader_finish");
+
+    while (loader_pending > 0)
+    {
+        if (loader_ready.empty())
+        {
+            std::unique_lock<std::mutex> lock(loader_mutex);
+            loader_results_cv.wait(lock, [] { return !loader_results.empty(); });
+        }
+
+        update(SIZE_MAX, true);
+    }
+}
+
+void tex_loader_benchmark(const char* const* paths, uint32_t num_paths, uint32_t count, GLuint (*load_serial)(const char* path))
+{
+    using clock = std::chrono::steady_clock;
+
+    auto elapsed_ms = [](clock::time_point begin) {
+        return std::chrono::duration<double, std::milli>(clock::now() - begin).count();
+    };
+
+    std::vector<GLuint> textures(count);
+
+    // load every file once, so that both loaders read them from the OS file cache
+    for (uint32_t i = 0; i < num_paths; ++i)
+    {
+        const GLuint tex = load_serial(paths[i]);
+        glDeleteTextures(1, &tex);
+    }
+    glFinish();
+
+    // serial: nothing can be drawn before the last texture got decoded & uploaded
+    auto begin = clock::now();
+    for (uint32_t i = 0; i < count; ++i)
+        textures[i] = load_serial(paths[i % num_paths]);
+    glFinish();
+    const double serial_ms = elapsed_ms(begin);
+
+    glDeleteTextures(count, textures.data());
+
+    // async: the first frame can be drawn as soon as all textures have their placeholder
+    begin = clock::now();
+    for (uint32_t i = 0; i < count; ++i)
+        textures[i] = tex_loader_load(paths[i % num_paths]);
+    glFinish();
+    const double async_first_frame_ms = elapsed_ms(begin);
+
+    tex_loader_finish();
+    glFinish();
+    const double async_total_ms = elapsed_ms(begin);
+
+    glDeleteTextures(count, textures.data());
+
+    std::cout << "texture loading benchmark (textures: " << count << ", decode threads: " << tex_loader_num_threads()
+        << ", upload ring: " << (ring_ptr ? "yes" : "no") << ")" << std::endl;
+    // serial: the first frame waits for every texture, its time-to-first-frame is the total
+    std::cout << "  serial: total: " << serial_ms << " ms" << std::endl;
+    std::cout << "  async:  time-to-first-frame: " << async_first_frame_ms << " ms, total: " << async_total_ms << " ms"
+        << " (" << serial_ms / async_total_ms << "x)" << std::endl;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Asynchronous texture loading (vkgl-test -async-textures):
+// a pool of worker threads decodes the image files (stbi_load) in parallel, the GL thread copies the decoded pixels
+// into a persistently mapped GL_PIXEL_UNPACK_BUFFER ring (GL_ARB_buffer_storage) and uploads them from there.
+// tex_loader_load() returns the texture right away with a 1x1 placeholder image, tex_loader_update() replaces the
+// placeholder with the decoded image (same texture name, so nothing has to be re-bound by the caller).
+
+#define TEX_LOADER_RING_SIZE (32u << 20)        // bytes of the pixel-unpack ring
+#define TEX_LOADER_UPLOAD_BUDGET (16u << 20)    // bytes uploaded per tex_loader_update() call (bounds the frame hitch)
+
+// num_threads == 0: one decode thread per hardware thread (minus the GL thread)
+bool tex_loader_init(uint32_t num_threads);
+
+// waits for the decode threads, textures that are still pending keep their placeholder
+void tex_loader_shutdown();
+
+bool tex_loader_enabled();
+
+uint32_t tex_loader_num_threads();
+
+// GL thread; queues the file for decoding, the texture has the placeholder image until it got uploaded
+GLuint tex_loader_load(const char* path);
+
+// GL thread, once per frame: uploads the decoded images (up to TEX_LOADER_UPLOAD_BUDGET bytes),
+// returns the number of textures that are still pending
+uint32_t tex_loader_update();
+
+// GL thread; uploads until no texture is pending anymore
+void tex_loader_finish();
+
+// time-to-first-frame & total load time of 'count' textures (cycling through 'paths') with the serial loader
+// vs. the async loader (which has to be initialized)
+void tex_loader_benchmark(const char* const* paths, uint32_t num_paths, uint32_t count, GLuint (*load_serial)(const char* path));
@@ -0,0 +1,196 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct trace_event
+{
+    const char* name;
+    int64_t begin_ns;
+    int64_t end_ns;
+};
+
+struct trace_buffer
+{
+    std::mutex mutex;               // only contended while trace_shutdown() reads the buffer
+    // set by trace_shutdown(), the owning thread allocates a new buffer with its next zone
+    std::atomic<bool> retired{ false };
+    trace_event events[TRACE_EVENTS_PER_THREAD];
+    uint64_t num_events = 0;        // total number of events, wraps around in 'events'
+    uint32_t tid = 0;
+    const char* thread_name = nullptr;
+};
+
+static std::atomic<bool> trace_active(false);
+static const char* trace_file = nullptr;
+static int64_t trace_start_ns = 0;
+
+// every thread registers its buffer on its first event, the registry and the thread share the ownership,
+// so a thread that is still tracing when trace_shutdown() releases the registry never writes into freed memory
+static std::mutex trace_buffers_mutex;
+static std::vector<std::shared_ptr<trace_buffer>> trace_buffers;
+static uint32_t trace_next_tid = 1;
+
+static thread_local std::shared_ptr<trace_buffer> trace_thread_buffer;
+static thread_local const char* trace_thread_name = nullptr;
+
+// nullptr while tracing is disabled
+static trace_buffer* get_thread_buffer()
+{
+    if (!trace_thread_buffer || trace_thread_buffer->retired)
+    {
+        trace_thread_buffer.reset();
+
+        std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+        if (!trace_active)
+            return nullptr;
+
+        std::shared_ptr<trace_buffer> buf = std::make_shared<trace_buffer>();
+        buf->tid = trace_next_tid++;
+        buf->thread_name = trace_thread_name;
+        trace_buffers.push_back(buf);
+        trace_thread_buffer = std::move(buf);
+    }
+    return trace_thread_buffer.get();
+}
+
+static void write_json_string(std::ostream& out, const char* str)
+{
+    out << '"';
+    for (const char* c = str; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+            out << '\\';
+        out << *c;
+    }
+    out << '"';
+}
+
+void trace_init(const char* json_file)
+{
+    trace_file = json_file;
+    trace_start_ns = trace_now_ns();
+    trace_active = true;
+}
+
+void trace_shutdown()
+{
+    if (!trace_active)
+        return;
+
+    trace_active = false;
+
+    std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+
+    // every buffer is locked while it is read, a thread that is still tracing waits (or drops its zone once retired)
+    for (const std::shared_ptr<trace_buffer>& buf : trace_buffers)
+        buf->mutex.lock();
+
+    std::ofstream out(trace_file);
+    if (!out)
+    {
+        std::cout << "ERROR: Failed to open trace file " << trace_file << std::endl;
+    }
+    else
+    {
+        uint64_t num_written = 0, num_dropped = 0;
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+        bool first = true;
+        for (const std::shared_ptr<trace_buffer>& buf : trace_buffers)
+        {
+            if (buf->thread_name)
+            {
+                out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buf->tid
+                    << ",\"args\":{\"name\":";
+                write_json_string(out, buf->thread_name);
+                out << "}}";
+                first = false;
+            }
+
+            const uint64_t num_kept = std::min<uint64_t>(buf->num_events, TRACE_EVENTS_PER_THREAD);
+            num_dropped += buf->num_events - num_kept;
+
+            for (uint64_t i = buf->num_events - num_kept; i < buf->num_events; ++i)
+            {
+                const trace_event& e = buf->events[i % TRACE_EVENTS_PER_THREAD];
+
+                // microseconds (with fractions) relative to trace_init()
+                out << (first ? "" : ",\n") << "{\"name\":";
+                write_json_string(out, e.name);
+                out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buf->tid
+                    << ",\"ts\":" << (e.begin_ns - trace_start_ns) / 1000.0
+                    << ",\"dur\":" << (e.end_ns - e.begin_ns) / 1000.0 << "}";
+                first = false;
+                ++num_written;
+            }
+        }
+
+        out << "\n]}\n";
+
+        std::cout << "trace written to " << trace_file << " (" << num_written << " zones";
+        if (num_dropped > 0)
+            std::cout << ", " << num_dropped << " oldest zones overwritten";
+        std::cout << ")" << std::endl;
+    }
+
+    // the buffers of threads that exited are freed here, a live thread frees its own one when it exits
+    // (or when it traces again)
+    for (const std::shared_ptr<trace_buffer>& buf : trace_buffers)
+    {
+        buf->retired = true;
+        buf->mutex.unlock();
+    }
+    trace_buffers.clear();
+    trace_thread_buffer.reset();
+}
+
+bool trace_enabled()
+{
+    return trace_active.load(std::memory_order_relaxed);
+}
+
+int64_t trace_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void trace_add_zone(const char* name, int64_t begin_ns, int64_t end_ns)
+{
+    if (!trace_enabled())
+        return;
+
+    trace_buffer* buf = get_thread_buffer();
+    if (!buf)
+        return;
+
+    std::lock_guard<std::mutex> lock(buf->mutex);
+    if (buf->retired)
+        return;
+
+    trace_event& e = buf->events[buf->num_events % TRACE_EVENTS_PER_THREAD];
+    e.name = name;
+    e.begin_ns = begin_ns;
+    e.end_ns = end_ns;
+    ++buf->num_events;
+}
+
+void trace_set_thread_name(const char* name)
+{
+    // only remembered while tracing is disabled, the buffer is allocated with the first zone of the thread
+    trace_thread_name = name;
+
+    if (trace_thread_buffer)
+    {
+        std::lock_guard<std::mutex> lock(trace_thread_buffer->mutex);
+        trace_thread_buffer->thread_name = name;
+    }
+}
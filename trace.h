@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+// Scoped-zone CPU tracing (vkgl-test -trace file.json):
+// every zone is stored as one complete event in a fixed-size ring buffer of the calling thread
+// (allocated with the first zone of a thread while tracing is enabled, the oldest events get overwritten),
+// nothing is allocated on the hot path.
+// trace_shutdown() writes all buffers as Chrome trace-event JSON (chrome://tracing, https://ui.perfetto.dev).
+
+#define TRACE_EVENTS_PER_THREAD 65536
+
+void trace_init(const char* json_file);
+
+// writes the JSON file and frees the buffers, zones that other threads end meanwhile are dropped
+void trace_shutdown();
+
+bool trace_enabled();
+
+// steady clock timestamp in nanoseconds
+int64_t trace_now_ns();
+
+// name must be a string literal (or outlive trace_shutdown()), only the pointer is stored
+void trace_add_zone(const char* name, int64_t begin_ns, int64_t end_ns);
+
+// optional display name of the calling thread, e.g. "main"
+void trace_set_thread_name(const char* name);
+
+struct trace_zone
+{
+    const char* name;
+    int64_t begin_ns;
+
+    explicit trace_zone(const char* zone_name)
+        : name(zone_name), begin_ns(trace_enabled() ? trace_now_ns() : 0)
+    {
+    }
+
+    ~trace_zone()
+    {
+        if (begin_ns != 0)
+            trace_add_zone(name, begin_ns, trace_now_ns());
+    }
+
+    trace_zone(const trace_zone&) = delete;
+    trace_zone& operator=(const trace_zone&) = delete;
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+// traces the rest of the enclosing scope
+#define TRACE_ZONE(name) trace_zone TRACE_CONCAT(trace_zone_, __LINE__)(name)
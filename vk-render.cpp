@@ -4,18 +4,36 @@
 
 #include "vk-render.h"
 
+#include <glm/gtc/matrix_transform.hpp>
+
 #include <ext/piglit/vk.h>
 #include <ext/piglit/piglit-util.h>
 #include <ext/piglit/helpers.h>
 
 #include "vk_gl_interop_helpers.h"
 #include "interop.h"
+#include "trace.h"
+#include "spsc-queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 static struct vk_ctx vk_core;
 static struct vk_image_att vk_color_att;
 static struct vk_image_att vk_depth_att;
 static struct vk_renderer vk_rnd;
 
+// VULKAN-SIDE MSAA RESOLVE (see vk_render_settings::resolve_msaa)
+// Vulkan renders into these private multisampled images and resolves them into the single-sample interop images
+static bool vk_resolve = false;
+static struct vk_image_att vk_msaa_color_att;
+static struct vk_image_att vk_msaa_depth_att;
+
 static char* vs_src;
 static char* fs_src;
 static unsigned int vs_sz;
@@ -38,19 +56,292 @@ const struct vkgl_format depth_format = { "D32S8", GL_DEPTH32F_STENCIL8, VK_FORM
 
 uint32_t w = 0, h = 0;
 
+// RESIZE (see vk_resize()): w x h is the render area, the interop images are vk_img_w x vk_img_h
+// and are only reallocated when the render area leaves their size bucket
+#define VK_RESIZE_BUCKET 256
+static uint32_t vk_img_w = 0, vk_img_h = 0;
+static uint32_t vk_msaa_samples = 1;
+static bool vk_shared_interop_requested = false;
+
 // INTEROP TEXTURES
+// with vk_render_settings::shared_interop_memory both images live in one exported allocation
+// and gl_color_mem_obj == gl_depth_mem_obj
+static bool vk_shared_interop = false;
+static struct vk_interop_alloc vk_interop_mem;
+
 static GLuint gl_color_mem_obj = 0;
 static GLuint gl_color_tex = 0;
 
 static GLuint gl_depth_mem_obj = 0;
 static GLuint gl_depth_tex = 0;
 
-// INTEROP SEMAPHORES
-static struct gl_ext_semaphores gl_sem;
-static struct vk_semaphores vk_sem;
+static float vk_fb_color[4] = { 0.0, 1.0, 0.0, 1.0 };
+
+// PRE-RECORDED COMMAND BUFFERS (see vk_render_settings::prerecord_cmd_bufs)
+static bool vk_prerecorded = false;
+static struct vk_buf vk_mvp_buf;                // one MVP slot per frames-in-flight ring slot
+static uint8_t* vk_mvp_buf_map = nullptr;       // persistently mapped
+static VkDeviceSize vk_mvp_buf_stride = 0;
+static VkCommandBuffer vk_clear_cmd_buf = VK_NULL_HANDLE;
+static VkCommandBuffer vk_draw_cmd_bufs[VK_MAX_FRAMES_IN_FLIGHT];
+static VkCommandBuffer vk_clear_draw_cmd_bufs[VK_MAX_FRAMES_IN_FLIGHT];  // clear + draw sharing one handoff (see vk_begin_frame())
+
+// INTEROP SEMAPHORES (GL imports of the semaphore pair of each frames-in-flight ring slot, see vk_ctx::frames)
+static struct gl_ext_semaphores gl_sem[VK_MAX_FRAMES_IN_FLIGHT];
 static bool vk_sem_has_wait = true;
 static bool vk_sem_has_signal = true;
 
+// TIMELINE SYNC BACKEND (one semaphore pair for all ring slots, see vk_render_settings::timeline_semaphores)
+static bool vk_has_timeline = false;    // created & imported into GL
+static bool vk_use_timeline = false;    // used for the handoffs, otherwise the binary gl_sem / vk_frame::semaphores
+static struct vk_timeline vk_tl;
+static struct gl_ext_semaphores gl_tl_sem;
+
+// INTEROP SETS (see vk_render_settings::interop_sets)
+// the globals above (images, GL textures, framebuffers, pre-recorded command-buffers) always belong to the current set,
+// vk_select_interop_set() swaps them with the stored state of the other sets
+struct vk_interop_set
+{
+    struct vk_image_att color_att;
+    struct vk_image_att depth_att;
+    struct vk_image_att msaa_color_att;
+    struct vk_image_att msaa_depth_att;
+    bool shared_interop;
+    struct vk_interop_alloc interop_mem;
+
+    GLuint gl_color_mem_obj;
+    GLuint gl_color_tex;
+    GLuint gl_depth_mem_obj;
+    GLuint gl_depth_tex;
+
+    VkFramebuffer rnd_fb;
+    VkFramebuffer inst_rnd_fb;
+
+    VkCommandBuffer clear_cmd_buf;
+    VkCommandBuffer draw_cmd_bufs[VK_MAX_FRAMES_IN_FLIGHT];
+    VkCommandBuffer clear_draw_cmd_bufs[VK_MAX_FRAMES_IN_FLIGHT];
+};
+
+// the last submission into a set that GL did not wait for yet (not swapped, it belongs to the set index)
+struct vk_pending_acquire
+{
+    bool pending;
+    uint32_t slot;                  // frames-in-flight ring slot (binary semaphores)
+    uint64_t timeline_value;        // 0 == binary semaphores
+};
+
+static uint32_t vk_num_interop_sets = 1;
+static uint32_t vk_current_set = 0;
+static struct vk_interop_set vk_interop_sets[VK_MAX_INTEROP_SETS];     // the entry of the current set is unused
+static struct vk_pending_acquire vk_pending_acquires[VK_MAX_INTEROP_SETS];
+
+// BATCHED FRAME (see vk_begin_frame())
+static struct vk_frame* vk_batch_frame = nullptr;   // ring slot of the open batch, nullptr outside of a batch
+static bool vk_batch_recording = false;             // the ring slot's command-buffer is being recorded
+static bool vk_batch_has_clear = false;
+static uint32_t vk_batch_num_draws = 0;
+static size_t vk_batch_num_instances = 0;           // instance buffer entries used by the open batch
+
+// GPU TIMESTAMPS (see vk_render_settings::gpu_timestamps)
+// every ring slot owns a range of the query pool, it is read back without waiting when the slot gets acquired again
+#define VK_TIMESTAMPS_PER_SLOT 32       // a begin/end pair per recorded operation
+#define VK_TIMING_HISTORY 16            // app frames whose results can be looked up with vk_get_gpu_timings()
+
+enum vk_gpu_op
+{
+    VK_GPU_OP_CLEAR,
+    VK_GPU_OP_DRAW,
+};
+
+struct vk_slot_timing
+{
+    uint64_t frame;                                 // app frame (see vk_set_frame_index()) of the last submission
+    uint32_t num_timestamps;
+    enum vk_gpu_op ops[VK_TIMESTAMPS_PER_SLOT / 2];
+    bool pending;                                   // submitted, but not read back yet
+};
+
+struct vk_frame_timing
+{
+    uint64_t frame;
+    uint32_t num_submits;                           // submissions with timestamps
+    uint32_t num_read;                              // ... of which the results have been read back
+    struct vk_gpu_timings timings;
+};
+
+static bool vk_gpu_timing = false;
+static struct vk_timestamps vk_ts;
+static struct vk_slot_timing vk_slot_timings[VK_MAX_FRAMES_IN_FLIGHT];
+static struct vk_frame_timing vk_frame_timings[VK_TIMING_HISTORY];
+static uint64_t vk_app_frame = 0;
+
+// SHARED GEOMETRY (see vk_create_shared_vertex_buffer())
+// the vertices live in exported Vulkan memory that GL imports as the storage of a buffer object, both APIs only read them
+struct vk_shared_vbo
+{
+    struct vk_buf bo;
+    GLuint gl_mem_obj;
+    GLuint gl_buf;
+    bool shared;        // false: GL has a copy of its own (the driver can't import the buffer)
+};
+
+static struct vk_shared_vbo vk_cube_vbo;            // drawn by vk_draw_cube() / vk_draw_cubes()
+static std::vector<struct vk_shared_vbo> vk_shared_vbos;
+static bool vk_shared_vbo_supported = true;
+
+// INSTANCED CUBES (see vk_draw_cubes())
+static char* vs_inst_src;
+static unsigned int vs_inst_sz;
+static struct vk_renderer vk_inst_rnd;
+static struct vk_buf vk_inst_buf;                   // one region per frames-in-flight ring slot, each with room for vk_inst_capacity MVPs
+static uint8_t* vk_inst_buf_map = nullptr;          // persistently mapped
+static VkDeviceSize vk_inst_buf_stride = 0;         // byte size of one ring slot region
+static size_t vk_inst_capacity = 0;
+static int vk_inst_buf_last_slot = -1;              // ring slot of the latest batch that uploaded instances, -1: none yet
+
+// a grown instance buffer replaces the old one (and its descriptor set & staging ring) while batches of other ring slots
+// may still read it: the old objects are retired into the slot that used them last and destroyed once that slot is
+// acquired again (vk_acquire_frame() waited for its previous submission and all earlier ones)
+struct vk_retired_inst_buf
+{
+    struct vk_buf buf;
+    VkDescriptorPool desc_pool;
+    struct vk_buf staging_bo;
+};
+
+static std::vector<struct vk_retired_inst_buf> vk_retired_inst_bufs[VK_MAX_FRAMES_IN_FLIGHT];
+
+// STAGING UPLOADS (see vk_render_settings::staging_uploads): vk_inst_buf is device-local, the instance data of a frame is
+// written into the staging ring and copied into the ring slot's region of vk_inst_buf, all copies of a batch are recorded
+// at once with a single barrier: by the slot's upload command-buffer, submitted before the batch's one (the render
+// thread records them into the request's command-buffer before its first operation)
+static bool vk_staging = false;
+static struct vk_staging_ring vk_staging_ring;
+static std::vector<VkBufferCopy> vk_staging_regions;                    // staged, not yet recorded copies
+static VkCommandBuffer vk_upload_cmd_bufs[VK_MAX_FRAMES_IN_FLIGHT];
+
+// PARALLEL RECORDING (see vk_draw_cube_list())
+// the draw list is split into one chunk per recording thread (the calling thread records chunk 0, worker i chunk i),
+// every thread records into a fresh secondary command-buffer of its own command pool per ring slot (a batch can hold
+// several lists), the pool is reset once when the slot is acquired again (vk_acquire_frame() waited for its previous
+// submission); the pools & workers are created by the first draw list
+#define VK_RECORD_MAX_THREADS 32
+#define VK_RECORD_MIN_CHUNK 256         // draws per chunk at least, shorter lists are recorded by fewer threads
+
+struct vk_record_thread
+{
+    VkCommandPool cmd_pools[VK_MAX_FRAMES_IN_FLIGHT];
+    std::vector<VkCommandBuffer> cmd_bufs[VK_MAX_FRAMES_IN_FLIGHT];     // secondary, allocated from cmd_pools[slot]
+    size_t num_used[VK_MAX_FRAMES_IN_FLIGHT];                           // recorded since the slot was acquired
+    VkCommandBuffer job_cmd_buf;                                        // chunk of the current job, VK_NULL_HANDLE on failure
+};
+
+struct vk_record_job
+{
+    uint32_t slot;
+    struct vk_renderer* rnd;
+    const glm::mat4* mvps;
+    size_t count;
+    uint32_t num_chunks;
+    uint32_t w, h;
+};
+
+static uint32_t vk_record_num_threads = 0;                  // including the calling thread, 0 before vk_init()
+static uint32_t vk_record_max_threads = 0;                  // threads per draw list, see vk_benchmark_parallel_recording()
+static bool vk_record_started = false;                      // pools & workers created
+static bool vk_record_start_failed = false;
+static struct vk_record_thread vk_record_threads[VK_RECORD_MAX_THREADS];
+static std::vector<std::thread> vk_record_workers;
+static std::mutex vk_record_mutex;
+static std::condition_variable vk_record_cv;                // a new job for the workers
+static std::condition_variable vk_record_done_cv;           // all workers finished the job
+static struct vk_record_job vk_record_current_job;
+static uint64_t vk_record_job_id = 0;
+static uint32_t vk_record_pending = 0;                      // workers that did not finish the job yet
+static bool vk_record_quit = false;
+
+static_assert(sizeof(glm::mat4) == sizeof(struct vk_push_constants), "the MVPs of a draw list are its push constants");
+
+// RENDER THREAD (see vk_render_settings::render_thread)
+// the main thread fills one request per batch and pushes it in vk_end_frame(), after GL signaled the request's
+// gl_value; the render thread records & submits it, the submission signals vk_value which GL already waits for
+#define VK_RENDER_QUEUE_SIZE 4          // batches the main thread can be ahead of the render thread
+
+enum vk_thread_op_type
+{
+    VK_THREAD_OP_CLEAR,                 // vk_clear_fbo()
+    VK_THREAD_OP_DRAW,                  // vk_draw_cube()
+    VK_THREAD_OP_DRAW_INSTANCED,        // vk_draw_cubes()
+    VK_THREAD_OP_DRAW_LIST,             // vk_draw_cube_list()
+};
+
+struct vk_thread_op
+{
+    enum vk_thread_op_type type;
+    glm::mat4 mvp;                      // VK_THREAD_OP_DRAW
+    size_t first_instance;              // VK_THREAD_OP_DRAW_INSTANCED / _DRAW_LIST: range of vk_thread_request::instances / draw_list
+    size_t count;
+};
+
+// one batch, with a snapshot of the interop set it renders into (the main thread may select another set meanwhile)
+struct vk_thread_request
+{
+    struct vk_image_att color_att;
+    struct vk_image_att depth_att;
+    VkFramebuffer rnd_fb;
+    VkFramebuffer inst_rnd_fb;
+    uint32_t w, h;
+
+    uint64_t gl_value;                  // signaled by GL before the request was pushed (0 == nothing to wait for)
+    uint64_t vk_value;                  // signaled by the submission of the request
+
+    std::vector<struct vk_thread_op> ops;
+    std::vector<glm::mat4> instances;   // MVPs of the VK_THREAD_OP_DRAW_INSTANCED ops
+    std::vector<glm::mat4> draw_list;   // MVPs of the VK_THREAD_OP_DRAW_LIST ops
+};
+
+static bool vk_threaded = false;
+static std::thread vk_thread;
+static spsc_queue<struct vk_thread_request, VK_RENDER_QUEUE_SIZE> vk_thread_queue;
+static struct vk_thread_request* vk_thread_req = nullptr;   // batch filled by the main thread, nullptr outside of a batch
+static uint64_t vk_thread_vk_value = 0;                     // vk_value of the last pushed request
+static uint64_t vk_thread_pushed = 0;
+static std::atomic<uint64_t> vk_thread_done{ 0 };           // requests submitted by the render thread
+static std::atomic<bool> vk_thread_quit{ false };
+
+// the render thread parks on the condition variable while the queue is empty,
+// the main thread while it waits for the render thread to get idle or to free a queue slot
+static std::atomic<bool> vk_thread_parked{ false };
+static std::atomic<bool> vk_thread_waiting{ false };
+static std::mutex vk_thread_mutex;
+static std::condition_variable vk_thread_cv;
+
+// render thread copies of the renderers, only the framebuffer changes per request (interop sets)
+static struct vk_renderer vk_thread_rnd;
+static struct vk_renderer vk_thread_inst_rnd;
+
+// the render thread only touches Vulkan objects (command pool, queue, ring slots) while it works on a request,
+// the main thread has to wait for it before it records or submits anything itself
+static void vk_thread_wait_idle()
+{
+    if (!vk_threaded)
+        return;
+
+    TRACE_ZONE("vk_thread_wait_idle");
+
+    std::unique_lock<std::mutex> lock(vk_thread_mutex);
+    vk_thread_waiting = true;
+    vk_thread_cv.wait(lock, [] { return vk_thread_done.load() == vk_thread_pushed; });
+    vk_thread_waiting = false;
+}
+
+// all submissions have been executed by the GPU
+static void vk_wait_idle()
+{
+    vk_thread_wait_idle();
+    vk_wait_frames_idle(&vk_core);
+}
+
 VkSampleCountFlags vk_max_supported_msaa_samples(VkPhysicalDevice pdev)
 {
     VkPhysicalDeviceProperties physicalDeviceProperties;
@@ -71,246 +362,2426 @@ VkSampleCountFlags vk_max_supported_msaa_samples(VkPhysicalDevice pdev)
     return VK_SAMPLE_COUNT_1_BIT;
 }
 
-bool vk_init(uint32_t width, uint32_t height, int& msaa_samples, bool enable_validation, GLuint* OUT_gl_color_tex_id, GLuint* OUT_gl_depth_tex_id)
+// (re-)records the pre-recorded command-buffers, they reference the current interop images & render area
+static bool vk_record_prerecorded_cmd_bufs()
 {
-    *OUT_gl_color_tex_id = 0;
-    *OUT_gl_depth_tex_id = 0;
+    vk_destroy_cmd_buf(&vk_core, &vk_clear_cmd_buf);
+    for (uint32_t i = 0; i < VK_MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        vk_destroy_cmd_buf(&vk_core, &vk_draw_cmd_bufs[i]);
+        vk_destroy_cmd_buf(&vk_core, &vk_clear_draw_cmd_bufs[i]);
+    }
 
-    w = width;
-    h = height;
+    struct vk_image_att images[] = { vk_color_att, vk_depth_att };
 
-    if (!vk_init_ctx_for_rendering(&vk_core, enable_validation)) {
-        fprintf(stderr, "Failed to create Vulkan context.\n");
+    // CLEAR: identical in every frame, a single command-buffer is enough
+    if ((vk_clear_cmd_buf = vk_create_cmd_buf(&vk_core)) == VK_NULL_HANDLE) {
+        fprintf(stderr, "Failed to create clear command buffer.\n");
         return false;
     }
 
-    std::cout << "requested MSAA sample-count: " << msaa_samples << std::endl;
+    vk_begin_cmd_buf(vk_clear_cmd_buf);
+    vk_record_clear_color(&vk_core, vk_clear_cmd_buf, &vk_rnd, vk_fb_color, 4,
+        images, ARRAY_SIZE(images), true, 0, 0, w, h);
+    vk_record_release_attachments(&vk_core, vk_clear_cmd_buf, images, ARRAY_SIZE(images));
+    if (!vk_end_cmd_buf(vk_clear_cmd_buf))
+        return false;
 
-    VkSampleCountFlags vk_max_msaa_samples = vk_max_supported_msaa_samples(vk_core.pdev);
-    std::cout << "VK max-msaa-samples: " << vk_max_msaa_samples << std::endl;
+    // DRAW: one command-buffer per ring slot, each one reads the MVP from its own slot of the uniform buffer
+    for (uint32_t i = 0; i < vk_core.num_frames_in_flight; ++i)
+    {
+        if ((vk_draw_cmd_bufs[i] = vk_create_cmd_buf(&vk_core)) == VK_NULL_HANDLE) {
+            fprintf(stderr, "Failed to create draw command buffer.\n");
+            return false;
+        }
 
-    GLint gl_max_msaa_samples = 0;
-    glGetIntegerv(GL_MAX_SAMPLES, &gl_max_msaa_samples);
-    std::cout << "GL max-msaa-samples: " << gl_max_msaa_samples << std::endl;
+        vk_begin_cmd_buf(vk_draw_cmd_bufs[i]);
+        vk_record_draw(&vk_core, vk_draw_cmd_bufs[i], &vk_cube_vbo.bo, &vk_rnd, vk_fb_color, 4,
+            nullptr, (uint32_t)(i * vk_mvp_buf_stride), 0, 0, w, h);
+        vk_record_release_attachments(&vk_core, vk_draw_cmd_bufs[i], images, ARRAY_SIZE(images));
+        if (!vk_end_cmd_buf(vk_draw_cmd_bufs[i]))
+            return false;
 
-    const int requested_msaa_samples = msaa_samples;
-    msaa_samples = std::min(std::min(msaa_samples, (int)vk_max_msaa_samples), gl_max_msaa_samples);
+        // CLEAR + DRAW: the whole static frame in one command-buffer with a single release at the end
+        if ((vk_clear_draw_cmd_bufs[i] = vk_create_cmd_buf(&vk_core)) == VK_NULL_HANDLE) {
+            fprintf(stderr, "Failed to create clear+draw command buffer.\n");
+            return false;
+        }
 
-    if (msaa_samples != requested_msaa_samples)
-    {
-        std::cout << "WARNING: MSAA sample-count has been reduced to " << msaa_samples << " samples (because of GPU limits)" << std::endl;
+        vk_begin_cmd_buf(vk_clear_draw_cmd_bufs[i]);
+        vk_record_clear_color(&vk_core, vk_clear_draw_cmd_bufs[i], &vk_rnd, vk_fb_color, 4,
+            images, ARRAY_SIZE(images), true, 0, 0, w, h);
+        vk_record_draw(&vk_core, vk_clear_draw_cmd_bufs[i], &vk_cube_vbo.bo, &vk_rnd, vk_fb_color, 4,
+            nullptr, (uint32_t)(i * vk_mvp_buf_stride), 0, 0, w, h);
+        vk_record_release_attachments(&vk_core, vk_clear_draw_cmd_bufs[i], images, ARRAY_SIZE(images));
+        if (!vk_end_cmd_buf(vk_clear_draw_cmd_bufs[i]))
+            return false;
     }
 
-    if (!vk_check_gl_compatibility(&vk_core)) {
-        fprintf(stderr, "Mismatch in driver/device UUID\n");
-        return false;
-    }
+    return true;
+}
 
-    if (!(vs_src = load_shader("vk_shader.vert.spv", &vs_sz))) {
-        fprintf(stderr, "Failed to load VS source.\n");
-        return false;
-    }
+static bool vk_create_prerecorded_cmd_bufs()
+{
+    VkPhysicalDeviceProperties pdev_props;
+    vkGetPhysicalDeviceProperties(vk_core.pdev, &pdev_props);
 
-    if (!(fs_src = load_shader("vk_shader.frag.spv", &fs_sz))) {
-        fprintf(stderr, "Failed to load FS source.\n");
-        free(vs_src);
-        return false;
-    }
+    // every ring slot gets its own MVP slot, so the CPU never overwrites an MVP that the GPU is still reading
+    const VkDeviceSize align = std::max<VkDeviceSize>(pdev_props.limits.minUniformBufferOffsetAlignment, 1);
+    vk_mvp_buf_stride = (sizeof(struct vk_push_constants) + align - 1) / align * align;
 
-    /* Vulkan interop extensions init */
-    if (!vk_load_interop_functions(vk_core.dev)) {
-        fprintf(stderr, "Failed to initialize Vulkan-GL interop extension functions.\n");
+    if (!vk_create_buffer(&vk_core, false,
+        (uint32_t)(vk_mvp_buf_stride * vk_core.num_frames_in_flight),
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, nullptr, &vk_mvp_buf)) {
+        fprintf(stderr, "Failed to create MVP uniform buffer.\n");
         return false;
     }
 
-    if (!vk_fill_ext_image_props(&vk_core,
-        w, h, d,
-        msaa_samples,
-        num_levels,
-        num_layers,
-        color_format.vk_fmt,
-        color_tiling,
-        color_in_layout,
-        color_end_layout,
-        true,
-        &vk_color_att.props)) {
-        fprintf(stderr, "Unsupported color image properties.\n");
+    void* map = nullptr;
+    if (!vk_map_buffer(&vk_core, &vk_mvp_buf, &map)) {
+        fprintf(stderr, "Failed to map MVP uniform buffer.\n");
         return false;
     }
+    vk_mvp_buf_map = (uint8_t*)map;
 
-    if (!vk_create_ext_image(&vk_core, &vk_color_att.props, &vk_color_att.obj)) {
-        fprintf(stderr, "Failed to create color image.\n");
-        return false;
-    }
+    vk_update_renderer_descriptor(&vk_core, &vk_rnd, &vk_mvp_buf, sizeof(struct vk_push_constants));
 
-    if (!vk_fill_ext_image_props(&vk_core,
-        w, h, d,
-        msaa_samples,
-        num_levels,
-        num_layers,
-        depth_format.vk_fmt,
-        depth_tiling,
-        depth_in_layout,
-        depth_end_layout,
-        true,
-        &vk_depth_att.props)) {
-        fprintf(stderr, "Unsupported depth image properties.\n");
-        return false;
-    }
+    return vk_record_prerecorded_cmd_bufs();
+}
 
-    if (!vk_create_ext_image(&vk_core, &vk_depth_att.props, &vk_depth_att.obj)) {
-        fprintf(stderr, "Failed to create depth image.\n");
-        return false;
+// destroys the objects right away if no batch in flight may use them anymore
+static void vk_retire_inst_buf(struct vk_retired_inst_buf& retired)
+{
+    // the slot that used them last is the one being recorded: its previous submission is done
+    if (vk_inst_buf_last_slot < 0 || (uint32_t)vk_inst_buf_last_slot == vk_core.frame_idx)
+    {
+        vk_destroy_buffer(&vk_core, &retired.buf);
+        vk_destroy_descriptor_pool(&vk_core, &retired.desc_pool);
+        vk_destroy_buffer(&vk_core, &retired.staging_bo);
+        return;
     }
+    vk_retired_inst_bufs[vk_inst_buf_last_slot].push_back(retired);
+}
 
-    if (!vk_create_renderer(&vk_core, vs_src, vs_sz, fs_src, fs_sz,
-        true, false,
-        &vk_color_att, &vk_depth_att, 0, &vk_rnd)) {
-        fprintf(stderr, "Failed to create Vulkan renderer.\n");
-        return false;
+// the slot has been acquired again, nothing retired into it is in use anymore
+static void vk_release_retired_inst_bufs(uint32_t slot)
+{
+    for (struct vk_retired_inst_buf& retired : vk_retired_inst_bufs[slot])
+    {
+        vk_destroy_buffer(&vk_core, &retired.buf);
+        vk_destroy_descriptor_pool(&vk_core, &retired.desc_pool);
+        vk_destroy_buffer(&vk_core, &retired.staging_bo);
     }
+    vk_retired_inst_bufs[slot].clear();
+}
 
-    // INTEROP TEXTURES
-    // COLOR
-    if (!gl_create_mem_obj_from_vk_mem(&vk_core, &vk_color_att.obj.mobj,
-        &gl_color_mem_obj)) {
-        fprintf(stderr, "Failed to create GL memory object from Vulkan memory. (COLOR)\n");
-        return false;
-    }
+// (re-)create the instance buffer with room for at least 'count' MVPs per ring slot
+static bool vk_reserve_instances(size_t count)
+{
+    if (count <= vk_inst_capacity)
+        return true;
 
-    if (!gl_gen_tex_from_mem_obj(&vk_color_att.props,
-        color_format.gl_fmt,
-        gl_color_mem_obj, 0, &gl_color_tex)) {
-        fprintf(stderr, "Failed to create GL texture from Vulkan memory object. (COLOR)\n");
+    VkPhysicalDeviceProperties pdev_props;
+    vkGetPhysicalDeviceProperties(vk_core.pdev, &pdev_props);
+
+    size_t capacity = std::max<size_t>(vk_inst_capacity, 1024);
+    while (capacity < count)
+        capacity *= 2;
+
+    // the ring slot regions are selected via dynamic offsets, so they have to respect the storage buffer offset alignment
+    const VkDeviceSize align = std::max<VkDeviceSize>(pdev_props.limits.minStorageBufferOffsetAlignment, 1);
+    const VkDeviceSize stride = (capacity * sizeof(glm::mat4) + align - 1) / align * align;
+
+    if (stride > pdev_props.limits.maxStorageBufferRange ||
+        stride * vk_core.num_frames_in_flight > UINT32_MAX) {
+        fprintf(stderr, "Too many cube instances (%zu).\n", count);
         return false;
     }
 
-    // DEPTH-STENCIL
-    if (!gl_create_mem_obj_from_vk_mem(&vk_core, &vk_depth_att.obj.mobj,
-        &gl_depth_mem_obj)) {
-        fprintf(stderr, "Failed to create GL memory object from Vulkan memory. (DEPTH)\n");
-        return false;
+    // the old buffer may still be read by frames in flight, it is retired once the new one is in place
+    struct vk_buf buf = {};
+    struct vk_staging_ring ring = vk_staging_ring;
+    uint8_t* buf_map = nullptr;
+
+    if (vk_staging)
+    {
+        // the ring holds the instance data of every frame in flight, plus the end of the ring that is skipped when an
+        // upload would wrap around (a new ring starts empty, the old one is retired along with the old buffer)
+        const VkDeviceSize ring_size = stride * (vk_core.num_frames_in_flight + 1);
+
+        if (!vk_create_device_buffer(&vk_core, stride * vk_core.num_frames_in_flight,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &buf)) {
+            fprintf(stderr, "Failed to create cube instance buffer.\n");
+            return false;
+        }
+        if (vk_staging_ring.size < ring_size &&
+            !vk_create_staging_ring(&vk_core, ring_size, &ring)) {
+            fprintf(stderr, "Failed to create cube instance buffer.\n");
+            vk_destroy_buffer(&vk_core, &buf);
+            return false;
+        }
+    }
+    else
+    {
+        void* map = nullptr;
+        if (!vk_create_buffer(&vk_core, false,
+            (uint32_t)(stride * vk_core.num_frames_in_flight),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, nullptr, &buf) ||
+            !vk_map_buffer(&vk_core, &buf, &map)) {
+            fprintf(stderr, "Failed to create cube instance buffer.\n");
+            vk_destroy_buffer(&vk_core, &buf);
+            return false;
+        }
+        buf_map = (uint8_t*)map;
     }
 
-    if (!gl_gen_tex_from_mem_obj(&vk_depth_att.props,
-        depth_format.gl_fmt,
-        gl_depth_mem_obj, 0, &gl_depth_tex)) {
-        fprintf(stderr, "Failed to create GL texture from Vulkan memory object. (DEPTH)\n");
+    // a new descriptor set, the old one may be bound by command-buffers in flight
+    struct vk_retired_inst_buf retired = { vk_inst_buf, VK_NULL_HANDLE, {} };
+    if (!vk_replace_renderer_descriptor(&vk_core, &vk_inst_rnd, &buf, stride, &retired.desc_pool)) {
+        fprintf(stderr, "Failed to create cube instance buffer.\n");
+        vk_destroy_buffer(&vk_core, &buf);
+        if (ring.bo.buf != vk_staging_ring.bo.buf)
+            vk_destroy_staging_ring(&vk_core, &ring);
         return false;
     }
+    // the render thread's copy of the renderer (it grows the buffer itself in threaded mode)
+    vk_thread_inst_rnd.desc_pool = vk_inst_rnd.desc_pool;
+    vk_thread_inst_rnd.desc_set = vk_inst_rnd.desc_set;
 
-    if (!gl_color_tex || !gl_depth_tex)
+    if (ring.bo.buf != vk_staging_ring.bo.buf)
     {
-        fprintf(stderr, "Uninitialized GL color or depth texture-id\n");
-        return false;
+        ring.slot = vk_staging_ring.slot;
+        retired.staging_bo = vk_staging_ring.bo;
+        vk_staging_ring = ring;
     }
+    vk_retire_inst_buf(retired);
 
-    // INTEROP SEMAPHORES
-    if (!vk_create_semaphores(&vk_core, &vk_sem)) {
-        fprintf(stderr, "Failed to create semaphores.\n");
+    vk_inst_buf = buf;
+    vk_inst_buf_map = buf_map;
+    vk_inst_buf_stride = stride;
+    vk_inst_capacity = capacity;
+
+    return true;
+}
+
+// the staging ring can't hold 'size' more bytes next to the data of the frames in flight: replaces it with a larger one
+// and retires the old one (only before anything of the open batch was staged, the recorded copies would read the old ring)
+static bool vk_grow_staging_ring(VkDeviceSize size)
+{
+    TRACE_ZONE("vk_grow_staging_ring");
+
+    const VkDeviceSize ring_size = std::max(vk_staging_ring.size * 2,
+        (size + VK_STAGING_MAX_ALIGNMENT) * (vk_core.num_frames_in_flight + 1));
+    struct vk_staging_ring ring = {};
+    if (!vk_create_staging_ring(&vk_core, ring_size, &ring)) {
+        fprintf(stderr, "Failed to grow the staging ring.\n");
         return false;
     }
 
-    if (!gl_create_semaphores_from_vk(&vk_core, &vk_sem, &gl_sem)) {
-        fprintf(stderr, "Failed to import semaphores from Vulkan.\n");
-        return false;
+    // only the batches that uploaded instances read the ring
+    struct vk_retired_inst_buf retired = { {}, VK_NULL_HANDLE, vk_staging_ring.bo };
+    ring.slot = vk_staging_ring.slot;
+    vk_staging_ring = ring;
+    vk_retire_inst_buf(retired);
+    return true;
+}
+
+// writes 'count' MVPs at instance 'first' of the ring slot's region of the instance buffer: into the mapped buffer, or into
+// the staging ring plus a copy for vk_record_staged_uploads(); false if the staging ring is full of the open batch's data
+// (the caller submits the batch and retries in the next one) or can't grow
+static bool vk_upload_instances(uint32_t slot, size_t first, const glm::mat4* mvps, size_t count)
+{
+    const VkDeviceSize dst_offset = slot * vk_inst_buf_stride + first * sizeof(glm::mat4);
+    const VkDeviceSize size = count * sizeof(glm::mat4);
+
+    if (!vk_staging)
+    {
+        // vk_acquire_frame() waited for the previous submission of this ring slot, so its region of the instance buffer is free again
+        memcpy(vk_inst_buf_map + dst_offset, mvps, size);
+        return true;
     }
 
-    std::cout << "VK INIT DONE" << std::endl;
+    VkDeviceSize src_offset = 0;
+    void* dst = vk_staging_ring_alloc(&vk_staging_ring, size, alignof(glm::mat4), &src_offset);
+    if (!dst)
+    {
+        if (!vk_staging_regions.empty() || !vk_grow_staging_ring(size))
+            return false;
+        if (!(dst = vk_staging_ring_alloc(&vk_staging_ring, size, alignof(glm::mat4), &src_offset)))
+            return false;
+    }
 
-    *OUT_gl_color_tex_id = gl_color_tex;
-    *OUT_gl_depth_tex_id = gl_depth_tex;
+    memcpy(dst, mvps, size);
 
+    // the draws of a batch append their instances, so the copies are contiguous unless the ring wrapped around
+    if (!vk_staging_regions.empty() &&
+        vk_staging_regions.back().srcOffset + vk_staging_regions.back().size == src_offset &&
+        vk_staging_regions.back().dstOffset + vk_staging_regions.back().size == dst_offset)
+        vk_staging_regions.back().size += size;
+    else
+        vk_staging_regions.push_back({ src_offset, dst_offset, size });
     return true;
 }
 
-void vk_clear_fbo()
+// records the copies of vk_upload_instances() and one barrier before the draws that read them (outside of a render pass)
+static void vk_record_staged_uploads(VkCommandBuffer cmd_buf)
 {
-    GLuint in_layouts[] = {
-        gl_get_layout_from_vk(color_in_layout),
-        gl_get_layout_from_vk(depth_in_layout),
-    };
+    if (vk_staging_regions.empty())
+        return;
 
-    GLuint interop_textures[] = {
-        gl_color_tex,
-        gl_depth_tex,
-    };
+    for (const VkBufferCopy& region : vk_staging_regions)
+        vk_record_upload(cmd_buf, &vk_staging_ring, region.srcOffset, &vk_inst_buf, region.dstOffset, region.size);
+    vk_record_upload_barrier(cmd_buf);
 
-    if (vk_sem_has_wait) {
-        glSignalSemaphoreEXT(gl_sem.gl_frame_ready, 0, 0, 1,
-            interop_textures, in_layouts);
-        glFlush();
+    vk_staging_regions.clear();
+}
+
+// records chunk 'chunk' of the current job into the secondary command-buffer of recording thread 'chunk'
+static void vk_record_chunk(uint32_t chunk)
+{
+    TRACE_ZONE("vk_record_chunk");
+
+    const struct vk_record_job& job = vk_record_current_job;
+    const size_t begin = job.count * chunk / job.num_chunks;
+    const size_t end = job.count * (chunk + 1) / job.num_chunks;
+
+    struct vk_record_thread& thread = vk_record_threads[chunk];
+    std::vector<VkCommandBuffer>& cmd_bufs = thread.cmd_bufs[job.slot];
+    thread.job_cmd_buf = VK_NULL_HANDLE;
+
+    // the frame's command-buffer may already execute the command-buffers of a previous list of this slot
+    if (thread.num_used[job.slot] == cmd_bufs.size())
+    {
+        VkCommandBuffer new_cmd_buf = vk_create_secondary_cmd_buf(&vk_core, thread.cmd_pools[job.slot]);
+        if (new_cmd_buf == VK_NULL_HANDLE) {
+            fprintf(stderr, "Failed to create secondary command buffer.\n");
+            return;
+        }
+        cmd_bufs.push_back(new_cmd_buf);
     }
+    VkCommandBuffer cmd_buf = cmd_bufs[thread.num_used[job.slot]++];
 
-    struct vk_image_att images[] = { vk_color_att, vk_depth_att };
-    static float vk_fb_color[4] = { 0.0, 1.0, 0.0, 1.0 };
+    if (!vk_begin_secondary_cmd_buf(cmd_buf, job.rnd, 0, 0, job.w, job.h))
+        return;
+    vk_record_draw_list(&vk_core, cmd_buf, &vk_cube_vbo.bo, job.rnd,
+        reinterpret_cast<const struct vk_push_constants*>(job.mvps + begin), (uint32_t)(end - begin));
+    if (!vk_end_cmd_buf(cmd_buf))
+        return;
 
-    vk_clear_color(&vk_core, 0, &vk_rnd, vk_fb_color, 4, &vk_sem,
-        vk_sem_has_wait, vk_sem_has_signal, images,
-        ARRAY_SIZE(images), 0, 0, w, h);
+    thread.job_cmd_buf = cmd_buf;
+}
 
-    GLuint end_layouts[] = {
-        gl_get_layout_from_vk(color_end_layout),
-        gl_get_layout_from_vk(depth_end_layout),
-    };
+static void vk_record_worker_main(uint32_t index)
+{
+    trace_set_thread_name("vulkan record");
 
-    if (vk_sem_has_signal) {
-        glWaitSemaphoreEXT(gl_sem.vk_frame_done, 0, 0, 1,
-            interop_textures, end_layouts);
-        glFlush();
+    uint64_t job_id = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(vk_record_mutex);
+            vk_record_cv.wait(lock, [&] { return vk_record_quit || vk_record_job_id != job_id; });
+            if (vk_record_quit)
+                return;
+            job_id = vk_record_job_id;
+        }
+
+        if (index < vk_record_current_job.num_chunks)
+            vk_record_chunk(index);
+
+        std::lock_guard<std::mutex> lock(vk_record_mutex);
+        if (--vk_record_pending == 0)
+            vk_record_done_cv.notify_one();
     }
 }
 
-void vk_draw_cube(const glm::mat4& mvp_matrix)
+// num_threads: recording threads including the calling one (0 == one per hardware thread),
+// nothing is created before the first draw list (vk_record_start())
+static void vk_record_init(uint32_t num_threads)
 {
-    GLuint in_layouts[] = {
-        gl_get_layout_from_vk(color_in_layout),
-        gl_get_layout_from_vk(depth_in_layout),
-    };
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    num_threads = std::min(num_threads, (uint32_t)VK_RECORD_MAX_THREADS);
 
-    GLuint interop_textures[] = {
-        gl_color_tex,
-        gl_depth_tex,
-    };
+    vk_record_num_threads = num_threads;
+    vk_record_max_threads = num_threads;
+    vk_record_started = false;
+    vk_record_start_failed = false;
+}
 
-    if (vk_sem_has_wait) {
-        glSignalSemaphoreEXT(gl_sem.gl_frame_ready, 0, 0, 1,
-            interop_textures, in_layouts);
-        glFlush();
+static void vk_record_shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(vk_record_mutex);
+        vk_record_quit = true;
     }
+    vk_record_cv.notify_all();
+    for (auto& worker : vk_record_workers)
+        worker.join();
+    vk_record_workers.clear();
 
-    struct vk_image_att images[] = { vk_color_att, vk_depth_att };
-    static float vk_fb_color[4] = { 0.0, 1.0, 0.0, 1.0 };
+    // the secondary command-buffers are freed with their pools
+    for (uint32_t t = 0; t < vk_record_num_threads; ++t)
+    {
+        for (uint32_t i = 0; i < VK_MAX_FRAMES_IN_FLIGHT; ++i)
+            vk_destroy_cmd_pool(&vk_core, &vk_record_threads[t].cmd_pools[i]);
+        vk_record_threads[t] = vk_record_thread();
+    }
+    vk_record_started = false;
+    vk_record_num_threads = 0;
+}
+
+// creates the command pools & workers of the recording threads on first use
+static bool vk_record_start()
+{
+    if (vk_record_started)
+        return true;
+    if (vk_record_start_failed)
+        return false;
 
-    struct vk_push_constants pc;
-    memcpy(&pc.mvp_matrix, &mvp_matrix, sizeof(glm::mat4));
+    for (uint32_t t = 0; t < vk_record_num_threads; ++t)
+    {
+        vk_record_threads[t] = vk_record_thread();
+        for (uint32_t i = 0; i < vk_core.num_frames_in_flight; ++i)
+        {
+            if ((vk_record_threads[t].cmd_pools[i] = vk_create_cmd_pool(&vk_core)) == VK_NULL_HANDLE) {
+                fprintf(stderr, "Failed to create the command pools of the recording threads.\n");
+                // vk_record_shutdown() destroys the pools created so far
+                vk_record_start_failed = true;
+                return false;
+            }
+        }
+    }
 
-    vk_draw(&vk_core, 0, &vk_rnd, vk_fb_color, 4, &vk_sem,
-        vk_sem_has_wait, vk_sem_has_signal, images, ARRAY_SIZE(images), &pc, 0, 0, w, h);
+    vk_record_job_id = 0;
+    vk_record_quit = false;
+    for (uint32_t t = 1; t < vk_record_num_threads; ++t)
+        vk_record_workers.emplace_back(vk_record_worker_main, t);
 
-    GLuint end_layouts[] = {
-        gl_get_layout_from_vk(color_end_layout),
-        gl_get_layout_from_vk(depth_end_layout),
-    };
+    vk_record_started = true;
+    return true;
+}
 
-    if (vk_sem_has_signal) {
-        glWaitSemaphoreEXT(gl_sem.vk_frame_done, 0, 0, 1,
-            interop_textures, end_layouts);
-        glFlush();
+// the ring slot was acquired again, the GPU is done with the secondary command-buffers recorded into it
+static void vk_record_begin_frame(uint32_t slot)
+{
+    if (!vk_record_started)
+        return;
+
+    for (uint32_t t = 0; t < vk_record_num_threads; ++t)
+    {
+        struct vk_record_thread& thread = vk_record_threads[t];
+        // a pool that failed to reset keeps its command-buffers, the next lists get new ones
+        if (thread.num_used[slot] > 0 && vk_reset_cmd_pool(&vk_core, thread.cmd_pools[slot]))
+            thread.num_used[slot] = 0;
     }
 }
 
-void vk_shutdown()
+// records the draw list into secondary command-buffers with up to vk_record_max_threads threads
+// and executes them from cmd_buf (one draw render pass), the ring slot must be acquired already;
+// false if nothing was recorded into cmd_buf
+static bool vk_record_cube_list(VkCommandBuffer cmd_buf, uint32_t slot, struct vk_renderer* rnd,
+    const glm::mat4* mvps, size_t count, uint32_t width, uint32_t height)
 {
-    vk_destroy_ext_image(&vk_core, &vk_color_att.obj);
-    vk_destroy_ext_image(&vk_core, &vk_depth_att.obj);
+    TRACE_ZONE("vk_record_cube_list");
 
-    vk_destroy_semaphores(&vk_core, &vk_sem);
+    if (!vk_record_start())
+        return false;
 
-    vk_destroy_renderer(&vk_core, &vk_rnd);
+    const size_t max_chunks = std::max<size_t>((count + VK_RECORD_MIN_CHUNK - 1) / VK_RECORD_MIN_CHUNK, 1);
+    const uint32_t num_chunks = (uint32_t)std::min<size_t>(std::min(vk_record_max_threads, vk_record_num_threads), max_chunks);
 
-    free(vs_src);
-    free(fs_src);
+    vk_record_current_job = { slot, rnd, mvps, count, num_chunks, width, height };
 
-    vk_cleanup_ctx(&vk_core);
-}
\ No newline at end of file
+    if (num_chunks > 1)
+    {
+        {
+            std::lock_guard<std::mutex> lock(vk_record_mutex);
+            ++vk_record_job_id;
+            vk_record_pending = (uint32_t)vk_record_workers.size();
+        }
+        vk_record_cv.notify_all();
+    }
+
+    vk_record_chunk(0);
+
+    if (num_chunks > 1)
+    {
+        TRACE_ZONE("vk_record_wait");
+        std::unique_lock<std::mutex> lock(vk_record_mutex);
+        vk_record_done_cv.wait(lock, [] { return vk_record_pending == 0; });
+    }
+
+    VkCommandBuffer secondary_cmd_bufs[VK_RECORD_MAX_THREADS];
+    for (uint32_t i = 0; i < num_chunks; ++i)
+    {
+        if ((secondary_cmd_bufs[i] = vk_record_threads[i].job_cmd_buf) == VK_NULL_HANDLE)
+            return false;
+    }
+
+    vk_record_execute_secondary(&vk_core, cmd_buf, rnd, vk_fb_color, 4, secondary_cmd_bufs, num_chunks,
+        0, 0, width, height);
+    return true;
+}
+
+// uploads the vertices once into exported Vulkan memory and imports it into GL,
+// falls back to a private Vulkan buffer + a GL copy if the import fails
+static bool vk_create_shared_vbo(const float* vertices, uint32_t num_vertices, struct vk_shared_vbo& vbo)
+{
+    const uint32_t size = num_vertices * VK_VERTEX_FLOATS * sizeof(float);
+
+    memset(&vbo, 0, sizeof(vbo));
+
+    if (vk_shared_vbo_supported)
+    {
+        vbo.shared =
+            vk_create_ext_buffer(&vk_core, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vbo.bo) &&
+            vk_update_buffer_data(&vk_core, (void*)vertices, size, &vbo.bo) &&
+            gl_create_mem_obj_from_vk_mem(&vk_core, &vbo.bo.mobj, &vbo.gl_mem_obj) &&
+            gl_gen_buf_from_mem_obj(vbo.gl_mem_obj, GL_ARRAY_BUFFER, size, 0, &vbo.gl_buf);
+
+        if (vbo.shared)
+            return true;
+
+        glDeleteBuffers(1, &vbo.gl_buf);
+        glDeleteMemoryObjectsEXT(1, &vbo.gl_mem_obj);
+        vk_destroy_ext_bo(&vk_core, &vbo.bo);
+        vbo.gl_buf = vbo.gl_mem_obj = 0;
+
+        // the driver's answer won't change, the next meshes go straight to the fallback
+        std::cout << "WARNING: GL can't import the Vulkan vertex buffers, using a separate copy per API" << std::endl;
+        vk_shared_vbo_supported = false;
+    }
+
+    if (!vk_create_buffer(&vk_core, false, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, nullptr, &vbo.bo) ||
+        !vk_update_buffer_data(&vk_core, (void*)vertices, size, &vbo.bo)) {
+        fprintf(stderr, "Failed to create vertex buffer.\n");
+        return false;
+    }
+
+    glGenBuffers(1, &vbo.gl_buf);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo.gl_buf);
+    glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return true;
+}
+
+static void vk_destroy_shared_vbo(struct vk_shared_vbo& vbo)
+{
+    glDeleteBuffers(1, &vbo.gl_buf);
+    if (vbo.gl_mem_obj)
+        glDeleteMemoryObjectsEXT(1, &vbo.gl_mem_obj);
+    vbo.gl_buf = vbo.gl_mem_obj = 0;
+
+    if (vbo.shared)
+        vk_destroy_ext_bo(&vk_core, &vbo.bo);
+    else
+        vk_destroy_buffer(&vk_core, &vbo.bo);
+}
+
+GLuint vk_create_shared_vertex_buffer(const float* vertices, uint32_t num_vertices)
+{
+    // the upload uses the command pool & queue of the render thread
+    vk_thread_wait_idle();
+
+    struct vk_shared_vbo vbo;
+    if (!vk_create_shared_vbo(vertices, num_vertices, vbo))
+        return 0;
+
+    vk_shared_vbos.push_back(vbo);
+    return vbo.gl_buf;
+}
+
+GLuint vk_get_cube_vertex_buffer()
+{
+    return vk_cube_vbo.gl_buf;
+}
+
+// packs the color & depth interop images into one exported allocation (fails if the driver wants dedicated allocations)
+static bool vk_create_shared_interop_images()
+{
+    vk_interop_alloc_begin(&vk_core, &vk_interop_mem);
+
+    if (!vk_interop_alloc_image(&vk_core, &vk_interop_mem, &vk_color_att.props, &vk_color_att.obj) ||
+        !vk_interop_alloc_image(&vk_core, &vk_interop_mem, &vk_depth_att.props, &vk_depth_att.obj) ||
+        !vk_interop_alloc_finish(&vk_core, &vk_interop_mem))
+    {
+        vk_destroy_ext_image(&vk_core, &vk_color_att.obj);
+        vk_destroy_ext_image(&vk_core, &vk_depth_att.obj);
+        vk_interop_alloc_destroy(&vk_core, &vk_interop_mem);
+        return false;
+    }
+
+    return true;
+}
+
+// color & depth interop images of img_w x img_h, plus the private multisampled images in resolve mode
+// (the render area w x h may be smaller, see vk_resize())
+static bool vk_create_interop_images(uint32_t img_w, uint32_t img_h)
+{
+    // only the single-sample resolve targets are shared with GL in resolve mode
+    const uint32_t interop_samples = vk_resolve ? 1 : vk_msaa_samples;
+
+    if (!vk_fill_ext_image_props(&vk_core,
+        img_w, img_h, d,
+        interop_samples,
+        num_levels,
+        num_layers,
+        color_format.vk_fmt,
+        color_tiling,
+        color_in_layout,
+        color_end_layout,
+        true,
+        &vk_color_att.props)) {
+        fprintf(stderr, "Unsupported color image properties.\n");
+        return false;
+    }
+
+    if (!vk_fill_ext_image_props(&vk_core,
+        img_w, img_h, d,
+        interop_samples,
+        num_levels,
+        num_layers,
+        depth_format.vk_fmt,
+        depth_tiling,
+        depth_in_layout,
+        depth_end_layout,
+        true,
+        &vk_depth_att.props)) {
+        fprintf(stderr, "Unsupported depth image properties.\n");
+        return false;
+    }
+
+    vk_shared_interop = vk_shared_interop_requested && vk_create_shared_interop_images();
+
+    // the driver's answer won't change, later resizes go straight to the dedicated allocations
+    if (vk_shared_interop_requested && !vk_shared_interop)
+    {
+        std::cout << "WARNING: the interop images can't share one allocation, using one dedicated allocation per image" << std::endl;
+        vk_shared_interop_requested = false;
+    }
+
+    if (!vk_shared_interop)
+    {
+        if (!vk_create_ext_image(&vk_core, &vk_color_att.props, &vk_color_att.obj)) {
+            fprintf(stderr, "Failed to create color image.\n");
+            return false;
+        }
+
+        if (!vk_create_ext_image(&vk_core, &vk_depth_att.props, &vk_depth_att.obj)) {
+            fprintf(stderr, "Failed to create depth image.\n");
+            return false;
+        }
+    }
+
+    if (vk_resolve)
+    {
+        if (!vk_fill_ext_image_props(&vk_core, img_w, img_h, d, vk_msaa_samples, num_levels, num_layers,
+                color_format.vk_fmt, color_tiling, color_in_layout, color_end_layout, false,
+                &vk_msaa_color_att.props) ||
+            !vk_create_transient_image(&vk_core, &vk_msaa_color_att.props, &vk_msaa_color_att.obj)) {
+            fprintf(stderr, "Failed to create multisampled color image.\n");
+            return false;
+        }
+
+        if (!vk_fill_ext_image_props(&vk_core, img_w, img_h, d, vk_msaa_samples, num_levels, num_layers,
+                depth_format.vk_fmt, depth_tiling, depth_in_layout, depth_end_layout, false,
+                &vk_msaa_depth_att.props) ||
+            !vk_create_transient_image(&vk_core, &vk_msaa_depth_att.props, &vk_msaa_depth_att.obj)) {
+            fprintf(stderr, "Failed to create multisampled depth image.\n");
+            return false;
+        }
+    }
+
+    vk_img_w = img_w;
+    vk_img_h = img_h;
+
+    return true;
+}
+
+static void vk_destroy_interop_images()
+{
+    vk_destroy_ext_image(&vk_core, &vk_color_att.obj);
+    vk_destroy_ext_image(&vk_core, &vk_depth_att.obj);
+    vk_interop_alloc_destroy(&vk_core, &vk_interop_mem);
+    vk_shared_interop = false;
+    vk_destroy_ext_image(&vk_core, &vk_msaa_color_att.obj);
+    vk_destroy_ext_image(&vk_core, &vk_msaa_depth_att.obj);
+}
+
+// GL textures of the interop images (one GL memory object per Vulkan allocation)
+static bool gl_import_interop_textures()
+{
+    // SHARED ALLOCATION (one exported fd / GL memory object, the textures are created at their offsets)
+    if (vk_shared_interop)
+    {
+        if (!gl_create_mem_obj_from_vk_mem(&vk_core, &vk_interop_mem.mobj,
+            &gl_color_mem_obj)) {
+            fprintf(stderr, "Failed to create GL memory object from Vulkan memory. (COLOR + DEPTH)\n");
+            return false;
+        }
+        gl_depth_mem_obj = gl_color_mem_obj;
+    }
+
+    // COLOR
+    if (!vk_shared_interop && !gl_create_mem_obj_from_vk_mem(&vk_core, &vk_color_att.obj.mobj,
+        &gl_color_mem_obj)) {
+        fprintf(stderr, "Failed to create GL memory object from Vulkan memory. (COLOR)\n");
+        return false;
+    }
+
+    if (!gl_gen_tex_from_mem_obj(&vk_color_att.props,
+        color_format.gl_fmt,
+        gl_color_mem_obj, vk_color_att.obj.mobj.offset, &gl_color_tex)) {
+        fprintf(stderr, "Failed to create GL texture from Vulkan memory object. (COLOR)\n");
+        return false;
+    }
+
+    // DEPTH-STENCIL
+    if (!vk_shared_interop && !gl_create_mem_obj_from_vk_mem(&vk_core, &vk_depth_att.obj.mobj,
+        &gl_depth_mem_obj)) {
+        fprintf(stderr, "Failed to create GL memory object from Vulkan memory. (DEPTH)\n");
+        return false;
+    }
+
+    if (!gl_gen_tex_from_mem_obj(&vk_depth_att.props,
+        depth_format.gl_fmt,
+        gl_depth_mem_obj, vk_depth_att.obj.mobj.offset, &gl_depth_tex)) {
+        fprintf(stderr, "Failed to create GL texture from Vulkan memory object. (DEPTH)\n");
+        return false;
+    }
+
+    if (!gl_color_tex || !gl_depth_tex)
+    {
+        fprintf(stderr, "Uninitialized GL color or depth texture-id\n");
+        return false;
+    }
+
+    return true;
+}
+
+static void gl_delete_interop_textures()
+{
+    glDeleteTextures(1, &gl_color_tex);
+    glDeleteTextures(1, &gl_depth_tex);
+    glDeleteMemoryObjectsEXT(1, &gl_color_mem_obj);
+    if (gl_depth_mem_obj != gl_color_mem_obj)
+        glDeleteMemoryObjectsEXT(1, &gl_depth_mem_obj);
+    gl_color_tex = gl_depth_tex = 0;
+    gl_color_mem_obj = gl_depth_mem_obj = 0;
+}
+
+// exchanges the current set's globals with a stored set
+static void vk_swap_interop_set(struct vk_interop_set& set)
+{
+    std::swap(vk_color_att, set.color_att);
+    std::swap(vk_depth_att, set.depth_att);
+    std::swap(vk_msaa_color_att, set.msaa_color_att);
+    std::swap(vk_msaa_depth_att, set.msaa_depth_att);
+    std::swap(vk_shared_interop, set.shared_interop);
+    std::swap(vk_interop_mem, set.interop_mem);
+
+    std::swap(gl_color_mem_obj, set.gl_color_mem_obj);
+    std::swap(gl_color_tex, set.gl_color_tex);
+    std::swap(gl_depth_mem_obj, set.gl_depth_mem_obj);
+    std::swap(gl_depth_tex, set.gl_depth_tex);
+
+    std::swap(vk_rnd.fb, set.rnd_fb);
+    std::swap(vk_inst_rnd.fb, set.inst_rnd_fb);
+
+    std::swap(vk_clear_cmd_buf, set.clear_cmd_buf);
+    for (uint32_t i = 0; i < VK_MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        std::swap(vk_draw_cmd_bufs[i], set.draw_cmd_bufs[i]);
+        std::swap(vk_clear_draw_cmd_bufs[i], set.clear_draw_cmd_bufs[i]);
+    }
+}
+
+// points the renderers' framebuffers to the current interop images
+static bool vk_recreate_framebuffers()
+{
+    return vk_resolve
+        ? vk_recreate_framebuffer(&vk_core, &vk_msaa_color_att, &vk_msaa_depth_att, &vk_color_att, &vk_depth_att, &vk_rnd) &&
+          vk_recreate_framebuffer(&vk_core, &vk_msaa_color_att, &vk_msaa_depth_att, &vk_color_att, &vk_depth_att, &vk_inst_rnd)
+        : vk_recreate_framebuffer(&vk_core, &vk_color_att, &vk_depth_att, nullptr, nullptr, &vk_rnd) &&
+          vk_recreate_framebuffer(&vk_core, &vk_color_att, &vk_depth_att, nullptr, nullptr, &vk_inst_rnd);
+}
+
+void vk_select_interop_set(uint32_t set)
+{
+    if (set >= vk_num_interop_sets || set == vk_current_set)
+        return;
+
+    // the open batch records into the current set
+    vk_end_frame();
+
+    // park the current set in its (unused) entry, then take over the selected one
+    vk_swap_interop_set(vk_interop_sets[vk_current_set]);
+    vk_swap_interop_set(vk_interop_sets[set]);
+    vk_current_set = set;
+}
+
+uint32_t vk_get_num_interop_sets()
+{
+    return vk_num_interop_sets;
+}
+
+void vk_get_interop_textures(uint32_t set, GLuint* OUT_gl_color_tex_id, GLuint* OUT_gl_depth_tex_id)
+{
+    *OUT_gl_color_tex_id = 0;
+    *OUT_gl_depth_tex_id = 0;
+
+    if (set >= vk_num_interop_sets)
+        return;
+
+    const bool current = (set == vk_current_set);
+    *OUT_gl_color_tex_id = current ? gl_color_tex : vk_interop_sets[set].gl_color_tex;
+    *OUT_gl_depth_tex_id = current ? gl_depth_tex : vk_interop_sets[set].gl_depth_tex;
+}
+
+bool vk_init(uint32_t width, uint32_t height, int& msaa_samples, const vk_render_settings& settings, GLuint* OUT_gl_color_tex_id, GLuint* OUT_gl_depth_tex_id)
+{
+    TRACE_ZONE("vk_init");
+
+    *OUT_gl_color_tex_id = 0;
+    *OUT_gl_depth_tex_id = 0;
+
+    w = width;
+    h = height;
+
+    vk_prerecorded = settings.prerecord_cmd_bufs;
+
+    const int64_t init_start_ns = piglit_time_get_nano();
+
+    vk_core.pipeline_cache_file = settings.pipeline_cache_file;
+
+    // with several ICDs (e.g. lavapipe next to a hardware driver) only the device that drives the GL context can share its memory
+    vk_core.match_uuids = gl_get_device_uuids(vk_core.match_deviceUUID, vk_core.match_driverUUID);
+    vk_core.pdev_override = settings.device;
+    if (!vk_core.match_uuids)
+        std::cout << "WARNING: GL doesn't report its device UUID, selecting the Vulkan device by score" << std::endl;
+
+    if (!vk_init_ctx_for_rendering(&vk_core, settings.enable_validation, settings.frames_in_flight)) {
+        fprintf(stderr, "Failed to create Vulkan context.\n");
+        return false;
+    }
+
+    if (vk_core.pipeline_cache_loaded_size > 0)
+        std::cout << "VK pipeline cache: warm (" << vk_core.pipeline_cache_loaded_size << " bytes loaded from " << vk_core.pipeline_cache_file << ")" << std::endl;
+    else
+        std::cout << "VK pipeline cache: cold" << std::endl;
+
+    std::cout << "VK frames-in-flight: " << vk_core.num_frames_in_flight << std::endl;
+
+    std::cout << "requested MSAA sample-count: " << msaa_samples << std::endl;
+
+    VkSampleCountFlags vk_max_msaa_samples = vk_max_supported_msaa_samples(vk_core.pdev);
+    std::cout << "VK max-msaa-samples: " << vk_max_msaa_samples << std::endl;
+
+    GLint gl_max_msaa_samples = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &gl_max_msaa_samples);
+    std::cout << "GL max-msaa-samples: " << gl_max_msaa_samples << std::endl;
+
+    const int requested_msaa_samples = msaa_samples;
+    msaa_samples = std::min(std::min(msaa_samples, (int)vk_max_msaa_samples), gl_max_msaa_samples);
+
+    if (msaa_samples != requested_msaa_samples)
+    {
+        std::cout << "WARNING: MSAA sample-count has been reduced to " << msaa_samples << " samples (because of GPU limits)" << std::endl;
+    }
+
+    vk_resolve = settings.resolve_msaa && msaa_samples > 1;
+    if (vk_resolve && !vk_core.has_depth_stencil_resolve)
+    {
+        std::cout << "WARNING: VK_KHR_depth_stencil_resolve is not supported, the interop images stay multisampled" << std::endl;
+        vk_resolve = false;
+    }
+
+    std::cout << "VK MSAA resolve: " << (vk_resolve ? "Vulkan render pass" : "GL blit") << std::endl;
+
+    if (!vk_check_gl_compatibility(&vk_core)) {
+        fprintf(stderr, "Mismatch in driver/device UUID\n");
+        return false;
+    }
+
+    // the pre-recorded command-buffers read the MVP from a uniform buffer instead of push constants
+    const char* vs_file = vk_prerecorded ? "vk_shader_ubo.vert.spv" : "vk_shader.vert.spv";
+
+    if (!(vs_src = load_shader(vs_file, &vs_sz))) {
+        fprintf(stderr, "Failed to load VS source.\n");
+        return false;
+    }
+
+    if (!(fs_src = load_shader("vk_shader.frag.spv", &fs_sz))) {
+        fprintf(stderr, "Failed to load FS source.\n");
+        free(vs_src);
+        return false;
+    }
+
+    /* Vulkan interop extensions init */
+    if (!vk_load_interop_functions(vk_core.dev)) {
+        fprintf(stderr, "Failed to initialize Vulkan-GL interop extension functions.\n");
+        return false;
+    }
+
+    // SHARED GEOMETRY: the cube's vertices, read by the Vulkan pipelines below and by GL (vk_get_cube_vertex_buffer())
+    if (!settings.cube_vertices || settings.num_cube_vertices == 0) {
+        fprintf(stderr, "No cube vertices.\n");
+        return false;
+    }
+
+    vk_shared_vbo_supported = true;
+    if (!vk_create_shared_vbo(settings.cube_vertices, settings.num_cube_vertices, vk_cube_vbo))
+        return false;
+
+    std::cout << "VK vertex buffers: " << (vk_cube_vbo.shared ? "shared with GL" : "separate GL copy") << std::endl;
+
+    struct vk_vertex_info cube_vert_info;
+    memset(&cube_vert_info, 0, sizeof(cube_vert_info));
+    cube_vert_info.num_verts = (int)settings.num_cube_vertices;
+    cube_vert_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    cube_vert_info.num_attribs = 2;
+    cube_vert_info.attrib_components[0] = 3;    // position
+    cube_vert_info.attrib_components[1] = 2;    // uv
+
+    vk_msaa_samples = msaa_samples;
+    vk_shared_interop_requested = settings.shared_interop_memory;
+
+    if (!vk_create_interop_images(w, h))
+        return false;
+
+    std::cout << "VK interop memory: " << (vk_shared_interop ? "1 shared allocation" : "2 dedicated allocations") << std::endl;
+
+    // INSTANCED CUBES
+    if (!(vs_inst_src = load_shader("vk_shader_inst.vert.spv", &vs_inst_sz))) {
+        fprintf(stderr, "Failed to load instanced VS source.\n");
+        return false;
+    }
+
+    // pipeline creation dominates the Vulkan startup time when the pipeline cache is cold
+    int64_t pipeline_ns = piglit_time_get_nano();
+
+    const VkDescriptorType rnd_desc_type = vk_prerecorded ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_MAX_ENUM;
+
+    const bool rnd_created = vk_resolve
+        ? vk_create_resolve_renderer(&vk_core, vs_src, vs_sz, fs_src, fs_sz, false,
+            &vk_msaa_color_att, &vk_msaa_depth_att, &vk_color_att, &vk_depth_att, &cube_vert_info,
+            rnd_desc_type, &vk_rnd)
+        : vk_create_renderer(&vk_core, vs_src, vs_sz, fs_src, fs_sz,
+            true, false,
+            &vk_color_att, &vk_depth_att, &cube_vert_info,
+            rnd_desc_type, &vk_rnd);
+
+    if (!rnd_created) {
+        fprintf(stderr, "Failed to create Vulkan renderer.\n");
+        return false;
+    }
+
+    const bool inst_rnd_created = vk_resolve
+        ? vk_create_resolve_renderer(&vk_core, vs_inst_src, vs_inst_sz, fs_src, fs_sz, false,
+            &vk_msaa_color_att, &vk_msaa_depth_att, &vk_color_att, &vk_depth_att, &cube_vert_info,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, &vk_inst_rnd)
+        : vk_create_renderer(&vk_core, vs_inst_src, vs_inst_sz, fs_src, fs_sz,
+            true, false,
+            &vk_color_att, &vk_depth_att, &cube_vert_info,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, &vk_inst_rnd);
+
+    if (!inst_rnd_created) {
+        fprintf(stderr, "Failed to create instanced Vulkan renderer.\n");
+        return false;
+    }
+
+    pipeline_ns = piglit_time_get_nano() - pipeline_ns;
+    std::cout << "VK pipeline creation: " << pipeline_ns / 1000000.0 << " ms" << std::endl;
+
+    if (vk_prerecorded && !vk_create_prerecorded_cmd_bufs()) {
+        fprintf(stderr, "Failed to create pre-recorded command buffers.\n");
+        return false;
+    }
+
+    // the GPU reads the cube instances every frame: on a device with VRAM the CPU can't map (e.g. discrete GPUs), it reads
+    // them over the bus from a host-visible buffer, so they are copied into device-local memory instead
+    vk_staging = settings.staging_uploads && vk_has_host_invisible_vram(&vk_core);
+    std::cout << "VK instance uploads: " << (vk_staging ? "staging ring -> device-local buffer" : "mapped buffer") << std::endl;
+
+    for (uint32_t i = 0; vk_staging && i < vk_core.num_frames_in_flight; ++i)
+    {
+        if ((vk_upload_cmd_bufs[i] = vk_create_cmd_buf(&vk_core)) == VK_NULL_HANDLE) {
+            fprintf(stderr, "Failed to create the upload command buffers.\n");
+            return false;
+        }
+    }
+
+    if (!vk_reserve_instances(1)) {
+        fprintf(stderr, "Failed to create cube instance buffer.\n");
+        return false;
+    }
+
+    // PARALLEL RECORDING
+    vk_record_init(settings.record_threads);
+
+    std::cout << "VK recording threads: " << vk_record_num_threads << std::endl;
+
+    // GPU TIMESTAMPS
+    vk_gpu_timing = settings.gpu_timestamps &&
+        vk_create_timestamps(&vk_core, VK_TIMESTAMPS_PER_SLOT * vk_core.num_frames_in_flight, &vk_ts);
+
+    if (settings.gpu_timestamps && !vk_gpu_timing)
+        std::cout << "WARNING: Vulkan timestamp queries are not supported, no Vulkan GPU timings" << std::endl;
+    else if (vk_gpu_timing && vk_prerecorded)
+        std::cout << "WARNING: the pre-recorded command-buffers contain no timestamp queries, only freshly recorded Vulkan work is timed" << std::endl;
+
+    memset(vk_slot_timings, 0, sizeof(vk_slot_timings));
+    memset(vk_frame_timings, 0, sizeof(vk_frame_timings));
+
+    if (!gl_import_interop_textures())
+        return false;
+
+    // INTEROP SETS: set 0 is complete, the others get their own images, framebuffers, GL textures & pre-recorded command-buffers
+    vk_num_interop_sets = std::min(std::max(settings.interop_sets, 1u), (uint32_t)VK_MAX_INTEROP_SETS);
+    if (vk_num_interop_sets != settings.interop_sets)
+        std::cout << "WARNING: the number of interop sets has been clamped to " << vk_num_interop_sets << std::endl;
+
+    vk_current_set = 0;
+    memset(vk_interop_sets, 0, sizeof(vk_interop_sets));
+    memset(vk_pending_acquires, 0, sizeof(vk_pending_acquires));
+
+    for (uint32_t i = 1; i < vk_num_interop_sets; ++i)
+    {
+        vk_select_interop_set(i);
+
+        if (!vk_create_interop_images(w, h)) {
+            fprintf(stderr, "Failed to create the interop images of set %u.\n", i);
+            return false;
+        }
+
+        if (!vk_recreate_framebuffers()) {
+            fprintf(stderr, "Failed to create the Vulkan framebuffers of set %u.\n", i);
+            return false;
+        }
+
+        if (!gl_import_interop_textures())
+            return false;
+
+        if (vk_prerecorded && !vk_record_prerecorded_cmd_bufs()) {
+            fprintf(stderr, "Failed to create pre-recorded command buffers of set %u.\n", i);
+            return false;
+        }
+    }
+    vk_select_interop_set(0);
+
+    std::cout << "VK interop sets: " << vk_num_interop_sets << std::endl;
+
+    // INTEROP SEMAPHORES
+    for (uint32_t i = 0; i < vk_core.num_frames_in_flight; ++i)
+    {
+        if (!gl_create_semaphores_from_vk(&vk_core, &vk_core.frames[i].semaphores, &gl_sem[i])) {
+            fprintf(stderr, "Failed to import semaphores from Vulkan.\n");
+            return false;
+        }
+    }
+
+    // TIMELINE SYNC BACKEND (the binary semaphores above stay available as the fallback)
+    if (settings.timeline_semaphores)
+    {
+        vk_has_timeline =
+            vk_create_timeline(&vk_core, &vk_tl) &&
+            gl_create_timeline_from_vk(&vk_core, &vk_tl, &gl_tl_sem);
+
+        if (!vk_has_timeline)
+        {
+            std::cout << "WARNING: timeline semaphores are not supported by the Vulkan / GL driver, falling back to binary semaphores" << std::endl;
+            gl_destroy_semaphores(&gl_tl_sem);
+            vk_destroy_timeline(&vk_core, &vk_tl);
+        }
+    }
+    vk_use_timeline = vk_has_timeline;
+
+    std::cout << "VK sync backend: " << (vk_use_timeline ? "timeline semaphores" : "binary semaphores") << std::endl;
+
+    // RENDER THREAD: GL may only wait for a value before Vulkan submitted its signal with timeline semaphores
+    vk_threaded = settings.render_thread && vk_use_timeline && !vk_prerecorded;
+    if (settings.render_thread && !vk_threaded)
+        std::cout << "WARNING: the Vulkan render thread requires timeline semaphores and no pre-recorded command-buffers, recording on the calling thread" << std::endl;
+
+    if (vk_threaded && vk_gpu_timing)
+    {
+        std::cout << "WARNING: no Vulkan GPU timings with the Vulkan render thread" << std::endl;
+        vk_gpu_timing = false;
+    }
+
+    if (vk_threaded)
+        vk_thread_start();
+
+    std::cout << "VK recording: " << (vk_threaded ? "render thread" : "calling thread") << std::endl;
+
+    // internal buffers share VK_MEM_BLOCK_SIZE blocks, exported memory has a block (VkDeviceMemory) of its own
+    vk_print_memory_stats(&vk_core);
+
+    std::cout << "VK INIT DONE (" << (piglit_time_get_nano() - init_start_ns) / 1000000.0 << " ms)" << std::endl;
+
+    *OUT_gl_color_tex_id = gl_color_tex;
+    *OUT_gl_depth_tex_id = gl_depth_tex;
+
+    return true;
+}
+
+// image size for a render size: rounded up to the size bucket, but within the device limits
+static uint32_t vk_bucket_size(uint32_t size, uint32_t max_size)
+{
+    const uint32_t bucket = (size + VK_RESIZE_BUCKET - 1) / VK_RESIZE_BUCKET * VK_RESIZE_BUCKET;
+    return std::max(size, std::min(bucket, max_size));
+}
+
+bool vk_resize(uint32_t width, uint32_t height, GLuint* OUT_gl_color_tex_id, GLuint* OUT_gl_depth_tex_id)
+{
+    TRACE_ZONE("vk_resize");
+
+    *OUT_gl_color_tex_id = gl_color_tex;
+    *OUT_gl_depth_tex_id = gl_depth_tex;
+
+    if (width == 0 || height == 0)
+        return false;
+
+    if (width == w && height == h)
+        return true;
+
+    VkPhysicalDeviceProperties pdev_props;
+    vkGetPhysicalDeviceProperties(vk_core.pdev, &pdev_props);
+
+    const uint32_t bucket_w = vk_bucket_size(width, pdev_props.limits.maxFramebufferWidth);
+    const uint32_t bucket_h = vk_bucket_size(height, pdev_props.limits.maxFramebufferHeight);
+
+    // the images are kept while the render area fits and they are at most one bucket larger than needed
+    // (so growing and shrinking by a few pixels never reallocates)
+    const bool realloc =
+        width > vk_img_w || height > vk_img_h ||
+        vk_img_w > bucket_w + VK_RESIZE_BUCKET || vk_img_h > bucket_h + VK_RESIZE_BUCKET;
+
+    // the batch (and the pre-recorded command-buffers) record the render area, GL and Vulkan must be done with the
+    // old images before they are freed
+    vk_end_frame();
+    for (uint32_t i = 0; i < vk_num_interop_sets; ++i)
+        vk_acquire_interop_set(i);
+    vk_wait_idle();
+
+    w = width;
+    h = height;
+
+    const int64_t realloc_ns = piglit_time_get_nano();
+    if (realloc)
+        glFinish();
+
+    // every interop set is rebuilt the same way, the current one last
+    const uint32_t current_set = vk_current_set;
+    for (uint32_t n = 1; n <= vk_num_interop_sets; ++n)
+    {
+        vk_select_interop_set((current_set + n) % vk_num_interop_sets);
+
+        if (realloc)
+        {
+            gl_delete_interop_textures();
+            vk_destroy_interop_images();
+
+            if (!vk_create_interop_images(bucket_w, bucket_h)) {
+                fprintf(stderr, "Failed to recreate the interop images.\n");
+                return false;
+            }
+
+            if (!vk_recreate_framebuffers()) {
+                fprintf(stderr, "Failed to recreate the Vulkan framebuffers.\n");
+                return false;
+            }
+
+            if (!gl_import_interop_textures())
+                return false;
+        }
+
+        if (vk_prerecorded && !vk_record_prerecorded_cmd_bufs()) {
+            fprintf(stderr, "Failed to re-record pre-recorded command buffers.\n");
+            return false;
+        }
+    }
+
+    if (realloc)
+    {
+        std::cout << "VK resize: " << width << "x" << height << " (interop images reallocated: " << vk_img_w << "x" << vk_img_h
+            << ", " << (piglit_time_get_nano() - realloc_ns) / 1000000.0 << " ms)" << std::endl;
+    }
+
+    *OUT_gl_color_tex_id = gl_color_tex;
+    *OUT_gl_depth_tex_id = gl_depth_tex;
+
+    return true;
+}
+
+// color_tex / depth_tex: the GL textures of the interop set that is handed over
+// timeline_value: value to signal on a timeline semaphore (0 == binary semaphore)
+static void gl_release_to_vk(const struct gl_ext_semaphores& frame_gl_sem, GLuint color_tex, GLuint depth_tex, uint64_t timeline_value = 0)
+{
+    if (!vk_sem_has_wait)
+        return;
+
+    if (timeline_value)
+        glSemaphoreParameterui64vEXT(frame_gl_sem.gl_frame_ready, GL_TIMELINE_SEMAPHORE_VALUE_NV, &timeline_value);
+
+    GLuint in_layouts[] = {
+        gl_get_layout_from_vk(color_in_layout),
+        gl_get_layout_from_vk(depth_in_layout),
+    };
+
+    GLuint interop_textures[] = {
+        color_tex,
+        depth_tex,
+    };
+
+    {
+        TRACE_ZONE("glSignalSemaphoreEXT");
+        glSignalSemaphoreEXT(frame_gl_sem.gl_frame_ready, 0, 0, 1,
+            interop_textures, in_layouts);
+    }
+    {
+        TRACE_ZONE("glFlush");
+        glFlush();
+    }
+}
+
+// color_tex / depth_tex: the GL textures of the interop set that is handed back
+// timeline_value: value to wait for on a timeline semaphore (0 == binary semaphore)
+static void gl_acquire_from_vk(const struct gl_ext_semaphores& frame_gl_sem, GLuint color_tex, GLuint depth_tex, uint64_t timeline_value = 0)
+{
+    if (!vk_sem_has_signal)
+        return;
+
+    if (timeline_value)
+        glSemaphoreParameterui64vEXT(frame_gl_sem.vk_frame_done, GL_TIMELINE_SEMAPHORE_VALUE_NV, &timeline_value);
+
+    GLuint end_layouts[] = {
+        gl_get_layout_from_vk(color_end_layout),
+        gl_get_layout_from_vk(depth_end_layout),
+    };
+
+    GLuint interop_textures[] = {
+        color_tex,
+        depth_tex,
+    };
+
+    {
+        TRACE_ZONE("glWaitSemaphoreEXT");
+        glWaitSemaphoreEXT(frame_gl_sem.vk_frame_done, 0, 0, 1,
+            interop_textures, end_layouts);
+    }
+    {
+        TRACE_ZONE("glFlush");
+        glFlush();
+    }
+}
+
+void vk_acquire_interop_set(uint32_t set)
+{
+    if (set >= vk_num_interop_sets || !vk_pending_acquires[set].pending)
+        return;
+
+    TRACE_ZONE("vk_acquire_interop_set");
+
+    struct vk_pending_acquire& acquire = vk_pending_acquires[set];
+    acquire.pending = false;
+
+    GLuint color_tex = 0, depth_tex = 0;
+    vk_get_interop_textures(set, &color_tex, &depth_tex);
+
+    if (acquire.timeline_value)
+        gl_acquire_from_vk(gl_tl_sem, color_tex, depth_tex, acquire.timeline_value);
+    else
+        gl_acquire_from_vk(gl_sem[acquire.slot], color_tex, depth_tex);
+}
+
+// the ring slot's previous submission has completed (vk_acquire_frame() waited for its fence), collect its timestamps
+static void vk_read_slot_timestamps(uint32_t slot)
+{
+    struct vk_slot_timing& slot_timing = vk_slot_timings[slot];
+    if (!slot_timing.pending)
+        return;
+
+    slot_timing.pending = false;
+
+    struct vk_frame_timing& frame_timing = vk_frame_timings[slot_timing.frame % VK_TIMING_HISTORY];
+    if (frame_timing.frame != slot_timing.frame)
+        return; // too old, the history entry has been reused already
+
+    uint64_t ns[VK_TIMESTAMPS_PER_SLOT];
+    if (vk_get_timestamps_ns(&vk_core, &vk_ts, slot * VK_TIMESTAMPS_PER_SLOT, slot_timing.num_timestamps, ns))
+    {
+        for (uint32_t i = 0; i + 1 < slot_timing.num_timestamps; i += 2)
+        {
+            const double ms = (ns[i + 1] - ns[i]) / 1000000.0;
+            if (slot_timing.ops[i / 2] == VK_GPU_OP_CLEAR)
+                frame_timing.timings.clear_ms += ms;
+            else
+                frame_timing.timings.draw_ms += ms;
+        }
+    }
+
+    ++frame_timing.num_read;
+}
+
+// begin/end pair around an operation recorded into the open batch
+static bool vk_timestamp_begin()
+{
+    if (!vk_gpu_timing || !vk_batch_recording)
+        return false;
+
+    const uint32_t slot = (uint32_t)(vk_batch_frame - vk_core.frames);
+    struct vk_slot_timing& slot_timing = vk_slot_timings[slot];
+    if (slot_timing.num_timestamps + 2 > VK_TIMESTAMPS_PER_SLOT)
+        return false;
+
+    vk_record_timestamp(vk_batch_frame->cmd_buf, &vk_ts, slot * VK_TIMESTAMPS_PER_SLOT + slot_timing.num_timestamps++);
+    return true;
+}
+
+static void vk_timestamp_end(enum vk_gpu_op op)
+{
+    const uint32_t slot = (uint32_t)(vk_batch_frame - vk_core.frames);
+    struct vk_slot_timing& slot_timing = vk_slot_timings[slot];
+
+    slot_timing.ops[slot_timing.num_timestamps / 2] = op;
+    vk_record_timestamp(vk_batch_frame->cmd_buf, &vk_ts, slot * VK_TIMESTAMPS_PER_SLOT + slot_timing.num_timestamps++);
+}
+
+void vk_set_frame_index(uint64_t frame)
+{
+    vk_app_frame = frame;
+}
+
+bool vk_get_gpu_timings(uint64_t frame, vk_gpu_timings& out)
+{
+    const struct vk_frame_timing& frame_timing = vk_frame_timings[frame % VK_TIMING_HISTORY];
+
+    if (frame_timing.frame != frame || frame_timing.num_submits == 0 ||
+        frame_timing.num_read < frame_timing.num_submits)
+        return false;
+
+    out = frame_timing.timings;
+    return true;
+}
+
+// render thread: records & submits one request (always submits, so that GL never waits for a vk_value in vain)
+static void vk_thread_execute(struct vk_thread_request& req)
+{
+    TRACE_ZONE("vk_thread_execute");
+
+    struct vk_frame* frame;
+    {
+        TRACE_ZONE("vk_acquire_frame");
+        frame = vk_acquire_frame(&vk_core);
+    }
+    if (!frame)
+    {
+        // nothing of the request can be submitted, GL already waits for its value
+        vk_signal_timeline(&vk_core, &vk_tl, req.vk_value);
+        return;
+    }
+    const uint32_t slot = (uint32_t)(frame - vk_core.frames);
+    if (vk_staging)
+        vk_staging_ring_begin_frame(&vk_staging_ring, slot);
+    vk_record_begin_frame(slot);
+
+    vk_release_retired_inst_bufs(slot);
+    // growing the instance buffer replaces the descriptor set, nothing of this request is recorded yet
+    bool instances_ok = req.instances.empty() || vk_reserve_instances(req.instances.size());
+
+    vk_thread_rnd.fb = req.rnd_fb;
+    vk_thread_inst_rnd.fb = req.inst_rnd_fb;
+
+    struct vk_image_att images[] = { req.color_att, req.depth_att };
+
+    vk_begin_cmd_buf(frame->cmd_buf);
+    if (instances_ok && !req.instances.empty())
+    {
+        instances_ok = vk_upload_instances(slot, 0, req.instances.data(), req.instances.size());
+        vk_inst_buf_last_slot = (int)slot;
+    }
+    vk_record_staged_uploads(frame->cmd_buf);
+    for (const struct vk_thread_op& op : req.ops)
+    {
+        switch (op.type)
+        {
+        case VK_THREAD_OP_CLEAR:
+            // only the first operation of the request takes the attachments over from GL
+            vk_record_clear_color(&vk_core, frame->cmd_buf, &vk_thread_rnd, vk_fb_color, 4,
+                images, ARRAY_SIZE(images), &op == &req.ops.front(), 0, 0, req.w, req.h);
+            break;
+
+        case VK_THREAD_OP_DRAW:
+        {
+            struct vk_push_constants pc;
+            memcpy(&pc.mvp_matrix, &op.mvp, sizeof(glm::mat4));
+            vk_record_draw(&vk_core, frame->cmd_buf, &vk_cube_vbo.bo, &vk_thread_rnd, vk_fb_color, 4,
+                &pc, 0, 0, 0, req.w, req.h);
+            break;
+        }
+
+        case VK_THREAD_OP_DRAW_LIST:
+            vk_record_cube_list(frame->cmd_buf, slot, &vk_thread_rnd, req.draw_list.data() + op.first_instance, op.count,
+                req.w, req.h);
+            break;
+
+        case VK_THREAD_OP_DRAW_INSTANCED:
+            if (instances_ok)
+            {
+                vk_record_draw_instanced(&vk_core, frame->cmd_buf, &vk_cube_vbo.bo, &vk_thread_inst_rnd, vk_fb_color, 4,
+                    nullptr, (uint32_t)(slot * vk_inst_buf_stride), (uint32_t)op.first_instance, (uint32_t)op.count,
+                    0, 0, req.w, req.h);
+            }
+            break;
+        }
+    }
+    vk_record_release_attachments(&vk_core, frame->cmd_buf, images, ARRAY_SIZE(images));
+    const bool recorded = vk_end_cmd_buf(frame->cmd_buf);
+
+    {
+        TRACE_ZONE("vkQueueSubmit");
+        // the main thread told GL to wait for exactly req.vk_value
+        vk_submit_cmd_bufs_timeline(&vk_core, frame, &frame->cmd_buf, recorded ? 1 : 0, &vk_tl, req.gl_value, req.vk_value);
+    }
+}
+
+static void vk_thread_main()
+{
+    trace_set_thread_name("vulkan render");
+
+    for (;;)
+    {
+        struct vk_thread_request* req = vk_thread_queue.front();
+        if (!req)
+        {
+            std::unique_lock<std::mutex> lock(vk_thread_mutex);
+            vk_thread_parked = true;
+            vk_thread_cv.wait(lock, [] { return !vk_thread_queue.empty() || vk_thread_quit; });
+            vk_thread_parked = false;
+
+            if (vk_thread_quit && vk_thread_queue.empty())
+                return;
+            continue;
+        }
+
+        vk_thread_execute(*req);
+        vk_thread_queue.pop();
+        ++vk_thread_done;
+
+        if (vk_thread_waiting)
+        {
+            std::lock_guard<std::mutex> lock(vk_thread_mutex);
+            vk_thread_cv.notify_all();
+        }
+    }
+}
+
+static void vk_thread_wake()
+{
+    if (vk_thread_parked)
+    {
+        std::lock_guard<std::mutex> lock(vk_thread_mutex);
+        vk_thread_cv.notify_all();
+    }
+}
+
+static void vk_thread_start()
+{
+    vk_thread_rnd = vk_rnd;
+    vk_thread_inst_rnd = vk_inst_rnd;
+    vk_thread_vk_value = vk_tl.vk_value;
+    vk_thread_pushed = 0;
+    vk_thread_done = 0;
+    vk_thread_quit = false;
+
+    vk_thread = std::thread(vk_thread_main);
+}
+
+static void vk_thread_stop()
+{
+    if (!vk_threaded)
+        return;
+
+    vk_thread_wait_idle();
+    {
+        std::lock_guard<std::mutex> lock(vk_thread_mutex);
+        vk_thread_quit = true;
+        vk_thread_cv.notify_all();
+    }
+    vk_thread.join();
+
+    vk_threaded = false;
+}
+
+// main thread: opens a request, waits while the render thread is VK_RENDER_QUEUE_SIZE batches behind
+static void vk_thread_begin_request()
+{
+    if (vk_thread_req)
+        return;
+
+    struct vk_thread_request* req = vk_thread_queue.try_reserve();
+    if (!req)
+    {
+        TRACE_ZONE("vk_thread_queue_full");
+
+        // the render thread increments vk_thread_done after every pop, once the main thread sees the increment
+        // it also sees the freed slot
+        std::unique_lock<std::mutex> lock(vk_thread_mutex);
+        vk_thread_waiting = true;
+        vk_thread_cv.wait(lock, [&] { vk_thread_done.load(); return (req = vk_thread_queue.try_reserve()) != nullptr; });
+        vk_thread_waiting = false;
+    }
+
+    req->ops.clear();
+    req->instances.clear();
+    req->draw_list.clear();
+    vk_thread_req = req;
+}
+
+// main thread: GL hands the current set over, the request is pushed, GL takes the set back (or defers it, see vk_end_frame())
+static void vk_thread_end_request()
+{
+    struct vk_thread_request* req = vk_thread_req;
+    vk_thread_req = nullptr;
+
+    // empty batch: not pushed, the next batch reuses the slot
+    if (req->ops.empty())
+        return;
+
+    vk_acquire_interop_set(vk_current_set);
+
+    req->color_att = vk_color_att;
+    req->depth_att = vk_depth_att;
+    req->rnd_fb = vk_rnd.fb;
+    req->inst_rnd_fb = vk_inst_rnd.fb;
+    req->w = w;
+    req->h = h;
+    req->gl_value = vk_sem_has_wait ? ++vk_tl.gl_value : 0;
+    req->vk_value = ++vk_thread_vk_value;
+
+    gl_release_to_vk(gl_tl_sem, gl_color_tex, gl_depth_tex, req->gl_value);
+
+    // the request belongs to the render thread from here on
+    const uint64_t vk_value = req->vk_value;
+    ++vk_thread_pushed;
+    vk_thread_queue.push();
+    vk_thread_wake();
+
+    // GL's wait is queued before the render thread submitted the signal (timeline semaphores allow wait-before-signal)
+    if (vk_num_interop_sets > 1)
+        vk_pending_acquires[vk_current_set] = { true, 0, vk_value };
+    else
+        gl_acquire_from_vk(gl_tl_sem, gl_color_tex, gl_depth_tex, vk_value);
+}
+
+// main thread: appends an operation to the open request (a batch of its own outside of vk_begin_frame() / vk_end_frame())
+// mvps: op.count MVPs of a VK_THREAD_OP_DRAW_INSTANCED / _DRAW_LIST op
+static void vk_thread_record(struct vk_thread_op op, const glm::mat4* mvps = nullptr)
+{
+    const bool implicit_frame = (vk_thread_req == nullptr);
+    if (implicit_frame)
+        vk_thread_begin_request();
+
+    if (mvps)
+    {
+        std::vector<glm::mat4>& dst = (op.type == VK_THREAD_OP_DRAW_LIST) ? vk_thread_req->draw_list : vk_thread_req->instances;
+        op.first_instance = dst.size();
+        dst.insert(dst.end(), mvps, mvps + op.count);
+    }
+    vk_thread_req->ops.push_back(op);
+
+    if (implicit_frame)
+        vk_thread_end_request();
+}
+
+static void vk_flush_frame()
+{
+    vk_end_frame();
+    vk_begin_frame();
+}
+
+// start recording the ring slot's command-buffer (this is always the case without pre-recorded command-buffers),
+// false if no ring slot could be acquired
+static bool vk_batch_begin_recording()
+{
+    if (!vk_batch_frame)
+        return false;
+    if (vk_batch_recording)
+        return true;
+
+    // pre-recorded command-buffers queued in this batch end with their own release barriers
+    if (vk_batch_has_clear || vk_batch_num_draws)
+        vk_flush_frame();
+    if (!vk_batch_frame)
+        return false;
+
+    vk_begin_cmd_buf(vk_batch_frame->cmd_buf);
+    vk_batch_recording = true;
+
+    if (vk_gpu_timing)
+    {
+        const uint32_t slot = (uint32_t)(vk_batch_frame - vk_core.frames);
+        vk_record_reset_timestamps(vk_batch_frame->cmd_buf, &vk_ts, slot * VK_TIMESTAMPS_PER_SLOT, VK_TIMESTAMPS_PER_SLOT);
+    }
+    return true;
+}
+
+int vk_get_interop_samples()
+{
+    return (int)vk_color_att.props.num_samples;
+}
+
+bool vk_render_thread_enabled()
+{
+    return vk_threaded;
+}
+
+void vk_begin_frame()
+{
+    TRACE_ZONE("vk_begin_frame");
+
+    if (vk_threaded)
+    {
+        vk_thread_begin_request();
+        return;
+    }
+
+    if (vk_batch_frame)
+        return;
+
+    {
+        TRACE_ZONE("vk_acquire_frame");
+        vk_batch_frame = vk_acquire_frame(&vk_core);
+    }
+    // the callers skip their work while vk_batch_frame is nullptr
+    if (!vk_batch_frame)
+        return;
+
+    const uint32_t slot = (uint32_t)(vk_batch_frame - vk_core.frames);
+    if (vk_staging)
+        vk_staging_ring_begin_frame(&vk_staging_ring, slot);
+    vk_record_begin_frame(slot);
+    vk_release_retired_inst_bufs(slot);
+    if (vk_gpu_timing)
+        vk_read_slot_timestamps(slot);
+    vk_slot_timings[slot].num_timestamps = 0;
+
+    vk_batch_has_clear = false;
+    vk_batch_num_draws = 0;
+    vk_batch_num_instances = 0;
+    vk_batch_recording = false;
+    vk_staging_regions.clear();
+
+    if (!vk_prerecorded)
+        vk_batch_begin_recording();
+}
+
+void vk_end_frame()
+{
+    TRACE_ZONE("vk_end_frame");
+
+    if (vk_threaded)
+    {
+        if (vk_thread_req)
+            vk_thread_end_request();
+        return;
+    }
+
+    if (!vk_batch_frame)
+        return;
+
+    struct vk_frame* frame = vk_batch_frame;
+    const uint32_t slot = (uint32_t)(frame - vk_core.frames);
+    vk_batch_frame = nullptr;
+
+    VkCommandBuffer cmd_buf = VK_NULL_HANDLE;
+
+    if (vk_batch_recording)
+    {
+        struct vk_image_att images[] = { vk_color_att, vk_depth_att };
+
+        vk_record_release_attachments(&vk_core, frame->cmd_buf, images, ARRAY_SIZE(images));
+        if (!vk_end_cmd_buf(frame->cmd_buf))
+            return;
+
+        if (vk_batch_has_clear || vk_batch_num_draws)
+            cmd_buf = frame->cmd_buf;
+    }
+    else
+    {
+        // pick the pre-recorded command-buffer that matches the batch (at most one clear and one draw, see vk_draw_cube())
+        if (vk_batch_has_clear && vk_batch_num_draws)
+            cmd_buf = vk_clear_draw_cmd_bufs[slot];
+        else if (vk_batch_has_clear)
+            cmd_buf = vk_clear_cmd_buf;
+        else if (vk_batch_num_draws)
+            cmd_buf = vk_draw_cmd_bufs[slot];
+    }
+
+    // empty batch: the ring slot is handed back untouched (its fence is still signaled)
+    if (cmd_buf == VK_NULL_HANDLE)
+        return;
+
+    // the staged instance copies of the batch execute before its draws
+    VkCommandBuffer cmd_bufs[2];
+    uint32_t num_cmd_bufs = 0;
+    if (!vk_staging_regions.empty())
+    {
+        VkCommandBuffer upload_cmd_buf = vk_upload_cmd_bufs[slot];
+        if (vk_begin_cmd_buf(upload_cmd_buf))
+        {
+            vk_record_staged_uploads(upload_cmd_buf);
+            if (vk_end_cmd_buf(upload_cmd_buf))
+                cmd_bufs[num_cmd_bufs++] = upload_cmd_buf;
+        }
+        vk_staging_regions.clear();
+    }
+    cmd_bufs[num_cmd_bufs++] = cmd_buf;
+
+    // GL has to own the set before it can hand it over again (e.g. a second submission of a flushed batch)
+    vk_acquire_interop_set(vk_current_set);
+
+    // with several interop sets GL waits for the Vulkan work only when it renders into the set (vk_acquire_interop_set()),
+    // so the GL commands of the previous set can execute while Vulkan renders into this one
+    const bool defer_acquire = vk_num_interop_sets > 1;
+
+    if (vk_use_timeline)
+    {
+        // the submission waits for exactly this GL value, no per-slot semaphores, no fence
+        const uint64_t gl_value = vk_sem_has_wait ? ++vk_tl.gl_value : 0;
+
+        gl_release_to_vk(gl_tl_sem, gl_color_tex, gl_depth_tex, gl_value);
+
+        {
+            TRACE_ZONE("vkQueueSubmit");
+            vk_submit_cmd_bufs_timeline(&vk_core, frame, cmd_bufs, num_cmd_bufs, &vk_tl, gl_value, 0);
+        }
+
+        if (defer_acquire)
+            vk_pending_acquires[vk_current_set] = { true, slot, vk_tl.vk_value };
+        else
+            gl_acquire_from_vk(gl_tl_sem, gl_color_tex, gl_depth_tex, vk_tl.vk_value);
+    }
+    else
+    {
+        const struct gl_ext_semaphores& frame_gl_sem = gl_sem[slot];
+
+        // the ring slot's binary 'vk_frame_done' semaphore is signaled again below, GL has to wait for its
+        // previous signal first (only happens when a set stays pending for a whole frames-in-flight cycle)
+        for (uint32_t i = 0; i < vk_num_interop_sets; ++i)
+        {
+            if (vk_pending_acquires[i].pending && vk_pending_acquires[i].slot == slot)
+                vk_acquire_interop_set(i);
+        }
+
+        gl_release_to_vk(frame_gl_sem, gl_color_tex, gl_depth_tex);
+
+        {
+            TRACE_ZONE("vkQueueSubmit");
+            vk_submit_cmd_bufs(&vk_core, frame, cmd_bufs, num_cmd_bufs, &frame->semaphores,
+                vk_sem_has_wait, vk_sem_has_signal);
+        }
+
+        if (defer_acquire)
+            vk_pending_acquires[vk_current_set] = { true, slot, 0 };
+        else
+            gl_acquire_from_vk(frame_gl_sem, gl_color_tex, gl_depth_tex);
+    }
+
+    struct vk_slot_timing& slot_timing = vk_slot_timings[slot];
+    if (vk_gpu_timing && cmd_buf == frame->cmd_buf && slot_timing.num_timestamps > 0)
+    {
+        struct vk_frame_timing& frame_timing = vk_frame_timings[vk_app_frame % VK_TIMING_HISTORY];
+        if (frame_timing.frame != vk_app_frame || frame_timing.num_submits == 0)
+        {
+            frame_timing = vk_frame_timing();
+            frame_timing.frame = vk_app_frame;
+        }
+        ++frame_timing.num_submits;
+
+        slot_timing.frame = vk_app_frame;
+        slot_timing.pending = true;
+    }
+}
+
+void vk_clear_fbo()
+{
+    TRACE_ZONE("vk_clear_fbo");
+
+    if (vk_threaded)
+    {
+        vk_thread_record({ VK_THREAD_OP_CLEAR });
+        return;
+    }
+
+    const bool implicit_frame = (vk_batch_frame == nullptr);
+    if (implicit_frame)
+        vk_begin_frame();
+    if (!vk_batch_frame)
+        return;
+
+    if (vk_prerecorded)
+    {
+        // the pre-recorded clear command-buffer can only be submitted at the start of a handoff
+        if (vk_batch_recording || vk_batch_has_clear || vk_batch_num_draws)
+            vk_flush_frame();
+        if (!vk_batch_frame)
+            return;
+    }
+    else
+    {
+        struct vk_image_att images[] = { vk_color_att, vk_depth_att };
+
+        // the attachments are taken over from GL once per batch, a later clear in the same batch only transitions them
+        const bool acquire = !vk_batch_has_clear && vk_batch_num_draws == 0;
+
+        const bool timed = vk_timestamp_begin();
+        vk_record_clear_color(&vk_core, vk_batch_frame->cmd_buf, &vk_rnd, vk_fb_color, 4,
+            images, ARRAY_SIZE(images), acquire, 0, 0, w, h);
+        if (timed)
+            vk_timestamp_end(VK_GPU_OP_CLEAR);
+    }
+
+    vk_batch_has_clear = true;
+
+    if (implicit_frame)
+        vk_end_frame();
+}
+
+void vk_draw_cube(const glm::mat4& mvp_matrix)
+{
+    TRACE_ZONE("vk_draw_cube");
+
+    if (vk_threaded)
+    {
+        vk_thread_record({ VK_THREAD_OP_DRAW, mvp_matrix });
+        return;
+    }
+
+    const bool implicit_frame = (vk_batch_frame == nullptr);
+    if (implicit_frame)
+        vk_begin_frame();
+    if (!vk_batch_frame)
+        return;
+
+    if (vk_prerecorded)
+    {
+        // every ring slot only has a single MVP slot, so a second cube in the same batch needs its own handoff
+        if (vk_batch_recording || vk_batch_num_draws)
+            vk_flush_frame();
+        if (!vk_batch_frame)
+            return;
+
+        // vk_acquire_frame() waited for the previous submission of this ring slot, so its MVP slot is free again
+        const uint32_t slot = (uint32_t)(vk_batch_frame - vk_core.frames);
+        memcpy(vk_mvp_buf_map + slot * vk_mvp_buf_stride, &mvp_matrix, sizeof(glm::mat4));
+    }
+    else
+    {
+        struct vk_push_constants pc;
+        memcpy(&pc.mvp_matrix, &mvp_matrix, sizeof(glm::mat4));
+
+        const bool timed = vk_timestamp_begin();
+        vk_record_draw(&vk_core, vk_batch_frame->cmd_buf, &vk_cube_vbo.bo, &vk_rnd, vk_fb_color, 4,
+            &pc, 0, 0, 0, w, h);
+        if (timed)
+            vk_timestamp_end(VK_GPU_OP_DRAW);
+    }
+
+    ++vk_batch_num_draws;
+
+    if (implicit_frame)
+        vk_end_frame();
+}
+
+void vk_draw_cubes(const glm::mat4* mvps, size_t count)
+{
+    TRACE_ZONE("vk_draw_cubes");
+
+    if (count == 0)
+        return;
+
+    if (vk_threaded)
+    {
+        vk_thread_record({ VK_THREAD_OP_DRAW_INSTANCED, glm::mat4(1.0f), 0, count }, mvps);
+        return;
+    }
+
+    const bool implicit_frame = (vk_batch_frame == nullptr);
+    if (implicit_frame)
+        vk_begin_frame();
+    if (!vk_batch_frame)
+        return;
+
+    if (!vk_batch_begin_recording())
+        return;
+
+    if (vk_batch_num_instances + count > vk_inst_capacity)
+    {
+        // the staged copies of the open batch target the current buffer, submit them before it is replaced
+        if (vk_batch_num_draws)
+        {
+            vk_flush_frame();
+            if (!vk_batch_begin_recording())
+                return;
+        }
+
+        if (!vk_reserve_instances(count))
+        {
+            if (implicit_frame)
+                vk_end_frame();
+            return;
+        }
+    }
+
+    uint32_t slot = (uint32_t)(vk_batch_frame - vk_core.frames);
+    if (!vk_upload_instances(slot, vk_batch_num_instances, mvps, count))
+    {
+        // the staging ring is full of the instances of this batch: submit it, the instances go into the next one
+        bool uploaded = false;
+        if (!vk_staging_regions.empty())
+        {
+            vk_flush_frame();
+            if (vk_batch_begin_recording())
+            {
+                slot = (uint32_t)(vk_batch_frame - vk_core.frames);
+                uploaded = vk_upload_instances(slot, vk_batch_num_instances, mvps, count);
+            }
+        }
+
+        if (!uploaded)
+        {
+            if (implicit_frame)
+                vk_end_frame();
+            return;
+        }
+    }
+
+    vk_inst_buf_last_slot = (int)slot;
+
+    const bool timed = vk_timestamp_begin();
+    vk_record_draw_instanced(&vk_core, vk_batch_frame->cmd_buf, &vk_cube_vbo.bo, &vk_inst_rnd, vk_fb_color, 4,
+        nullptr, (uint32_t)(slot * vk_inst_buf_stride), (uint32_t)vk_batch_num_instances, (uint32_t)count,
+        0, 0, w, h);
+    if (timed)
+        vk_timestamp_end(VK_GPU_OP_DRAW);
+
+    vk_batch_num_instances += count;
+    ++vk_batch_num_draws;
+
+    if (implicit_frame)
+        vk_end_frame();
+}
+
+void vk_draw_cube_list(const glm::mat4* mvps, size_t count)
+{
+    TRACE_ZONE("vk_draw_cube_list");
+
+    if (count == 0)
+        return;
+
+    if (vk_prerecorded)
+    {
+        static bool warned = false;
+        if (!warned)
+            std::cout << "WARNING: vk_draw_cube_list() is not available with pre-recorded command-buffers" << std::endl;
+        warned = true;
+        return;
+    }
+
+    if (vk_threaded)
+    {
+        vk_thread_record({ VK_THREAD_OP_DRAW_LIST, glm::mat4(1.0f), 0, count }, mvps);
+        return;
+    }
+
+    const bool implicit_frame = (vk_batch_frame == nullptr);
+    if (implicit_frame)
+        vk_begin_frame();
+    if (!vk_batch_frame)
+        return;
+
+    if (!vk_batch_begin_recording())
+        return;
+
+    const uint32_t slot = (uint32_t)(vk_batch_frame - vk_core.frames);
+    const bool timed = vk_timestamp_begin();
+    const bool recorded = vk_record_cube_list(vk_batch_frame->cmd_buf, slot, &vk_rnd, mvps, count, w, h);
+    if (timed)
+        vk_timestamp_end(VK_GPU_OP_DRAW);
+
+    if (recorded)
+        ++vk_batch_num_draws;
+
+    if (implicit_frame)
+        vk_end_frame();
+}
+
+void vk_shutdown()
+{
+    vk_end_frame();
+    vk_thread_stop();
+
+    // GL waits for the submissions it did not render into yet (the binary semaphores must not stay signaled)
+    for (uint32_t i = 0; i < vk_num_interop_sets; ++i)
+        vk_acquire_interop_set(i);
+
+    // frames may still be in flight on the GPU
+    vk_wait_frames_idle(&vk_core);
+
+    vk_record_shutdown();
+
+    vk_destroy_buffer(&vk_core, &vk_mvp_buf);
+    vk_mvp_buf_map = nullptr;
+
+    vk_destroy_buffer(&vk_core, &vk_inst_buf);
+    vk_inst_buf_map = nullptr;
+    vk_inst_capacity = 0;
+    vk_inst_buf_last_slot = -1;
+    for (uint32_t i = 0; i < VK_MAX_FRAMES_IN_FLIGHT; ++i)
+        vk_release_retired_inst_bufs(i);
+    vk_destroy_staging_ring(&vk_core, &vk_staging_ring);
+    for (uint32_t i = 0; i < VK_MAX_FRAMES_IN_FLIGHT; ++i)
+        vk_destroy_cmd_buf(&vk_core, &vk_upload_cmd_bufs[i]);
+
+    // every interop set, set 0 is the current one afterwards (its framebuffers go with the renderers)
+    for (uint32_t n = 1; n <= vk_num_interop_sets; ++n)
+    {
+        const uint32_t set = n % vk_num_interop_sets;
+        vk_select_interop_set(set);
+
+        vk_destroy_cmd_buf(&vk_core, &vk_clear_cmd_buf);
+        for (uint32_t i = 0; i < VK_MAX_FRAMES_IN_FLIGHT; ++i)
+        {
+            vk_destroy_cmd_buf(&vk_core, &vk_draw_cmd_bufs[i]);
+            vk_destroy_cmd_buf(&vk_core, &vk_clear_draw_cmd_bufs[i]);
+        }
+
+        // the GL imports first, they reference the Vulkan memory
+        gl_delete_interop_textures();
+        vk_destroy_interop_images();
+
+        if (set != 0)
+        {
+            vkDestroyFramebuffer(vk_core.dev, vk_rnd.fb, 0);
+            vkDestroyFramebuffer(vk_core.dev, vk_inst_rnd.fb, 0);
+            vk_rnd.fb = VK_NULL_HANDLE;
+            vk_inst_rnd.fb = VK_NULL_HANDLE;
+        }
+    }
+    vk_num_interop_sets = 1;
+    vk_resolve = false;
+
+    vk_destroy_shared_vbo(vk_cube_vbo);
+    for (struct vk_shared_vbo& vbo : vk_shared_vbos)
+        vk_destroy_shared_vbo(vbo);
+    vk_shared_vbos.clear();
+
+    vk_destroy_renderer(&vk_core, &vk_rnd);
+    vk_destroy_renderer(&vk_core, &vk_inst_rnd);
+
+    vk_destroy_timestamps(&vk_core, &vk_ts);
+    vk_gpu_timing = false;
+
+    if (vk_has_timeline)
+    {
+        gl_destroy_semaphores(&gl_tl_sem);
+        vk_destroy_timeline(&vk_core, &vk_tl);
+        vk_has_timeline = false;
+        vk_use_timeline = false;
+    }
+
+    free(vs_src);
+    free(vs_inst_src);
+    free(fs_src);
+
+    vk_cleanup_ctx(&vk_core);
+}
+
+void vk_benchmark_cmd_recording(uint32_t iterations)
+{
+    if (!vk_prerecorded || iterations == 0)
+    {
+        std::cout << "WARNING: vk_benchmark_cmd_recording() requires pre-recorded command buffers" << std::endl;
+        return;
+    }
+
+    struct vk_image_att images[] = { vk_color_att, vk_depth_att };
+    const glm::mat4 mvp_matrix(1.0f);
+
+    // only the CPU time between acquiring a ring slot and returning from vkQueueSubmit() is measured,
+    // time spent waiting for the GPU in vk_acquire_frame() is excluded
+    int64_t record_ns = 0;
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        struct vk_frame* frame = vk_acquire_frame(&vk_core);
+        if (!frame)
+            break;
+        const uint32_t slot = (uint32_t)(frame - vk_core.frames);
+
+        const int64_t t0 = piglit_time_get_nano();
+        memcpy(vk_mvp_buf_map + slot * vk_mvp_buf_stride, &mvp_matrix, sizeof(glm::mat4));
+
+        vk_begin_cmd_buf(frame->cmd_buf);
+        vk_record_draw(&vk_core, frame->cmd_buf, &vk_cube_vbo.bo, &vk_rnd, vk_fb_color, 4,
+            nullptr, (uint32_t)(slot * vk_mvp_buf_stride), 0, 0, w, h);
+        vk_record_release_attachments(&vk_core, frame->cmd_buf, images, ARRAY_SIZE(images));
+        vk_end_cmd_buf(frame->cmd_buf);
+
+        vk_submit_cmd_bufs(&vk_core, frame, &frame->cmd_buf, 1, nullptr, false, false);
+        record_ns += piglit_time_get_nano() - t0;
+    }
+    vk_wait_frames_idle(&vk_core);
+
+    int64_t submit_ns = 0;
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        struct vk_frame* frame = vk_acquire_frame(&vk_core);
+        if (!frame)
+            break;
+        const uint32_t slot = (uint32_t)(frame - vk_core.frames);
+
+        const int64_t t0 = piglit_time_get_nano();
+        memcpy(vk_mvp_buf_map + slot * vk_mvp_buf_stride, &mvp_matrix, sizeof(glm::mat4));
+
+        vk_submit_cmd_bufs(&vk_core, frame, &vk_draw_cmd_bufs[slot], 1, nullptr, false, false);
+        submit_ns += piglit_time_get_nano() - t0;
+    }
+    vk_wait_frames_idle(&vk_core);
+
+    const double record_us = record_ns / 1000.0 / iterations;
+    const double submit_us = submit_ns / 1000.0 / iterations;
+
+    std::cout << "cmd-buffer recording benchmark (" << iterations << " iterations):" << std::endl;
+    std::cout << "  record + submit: " << record_us << " us/frame" << std::endl;
+    std::cout << "  submit only:     " << submit_us << " us/frame" << std::endl;
+    std::cout << "  speedup:         " << (submit_us > 0.0 ? record_us / submit_us : 0.0) << "x" << std::endl;
+}
+
+void vk_benchmark_instancing(size_t max_instances, uint32_t num_frames)
+{
+    if (max_instances == 0 || num_frames == 0)
+        return;
+
+    // 1, 10, 100, ... up to max_instances (which is always measured as the last step)
+    std::vector<size_t> steps;
+    for (size_t count = 1; count < max_instances; count *= 10)
+        steps.push_back(count);
+    steps.push_back(max_instances);
+
+    std::vector<glm::mat4> mvps(max_instances);
+
+    std::cout << "instancing benchmark (" << num_frames << " frames per step):" << std::endl;
+    std::cout << "  instances, frame-time (ms), CPU submit (us/frame), CPU submit (ns/instance)" << std::endl;
+
+    for (const size_t count : steps)
+    {
+        // a square grid of small cubes covering the viewport
+        const size_t grid = (size_t)std::ceil(std::sqrt((double)count));
+        const float cell = 2.0f / grid;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const glm::vec3 pos(
+                -1.0f + cell * (0.5f + (float)(i % grid)),
+                -1.0f + cell * (0.5f + (float)(i / grid)),
+                0.5f);
+            mvps[i] = glm::scale(glm::translate(glm::mat4(1.0f), pos), glm::vec3(cell * 0.5f, cell * 0.5f, 0.01f));
+        }
+
+        // warm-up, so that growing the instance buffer is not part of the measurement
+        vk_draw_cubes(mvps.data(), count);
+        vk_wait_idle();
+
+        // CPU submit cost: everything between acquiring a ring slot and returning from the GL / VK submission,
+        // time spent waiting for the GPU in vk_begin_frame() is excluded
+        // (with the render thread: the cost on the calling thread, recording & submitting happens on the render thread)
+        int64_t submit_ns = 0;
+        const int64_t start_ns = piglit_time_get_nano();
+        for (uint32_t i = 0; i < num_frames; ++i)
+        {
+            vk_begin_frame();
+
+            const int64_t t0 = piglit_time_get_nano();
+            vk_clear_fbo();
+            vk_draw_cubes(mvps.data(), count);
+            vk_end_frame();
+            submit_ns += piglit_time_get_nano() - t0;
+        }
+        vk_wait_idle();
+        const int64_t total_ns = piglit_time_get_nano() - start_ns;
+
+        std::cout << "  " << count
+            << ", " << total_ns / 1000000.0 / num_frames
+            << ", " << submit_ns / 1000.0 / num_frames
+            << ", " << (double)submit_ns / num_frames / count
+            << std::endl;
+    }
+}
+
+void vk_benchmark_handoff(uint32_t iterations)
+{
+    if (iterations == 0)
+        return;
+
+    const bool use_timeline = vk_use_timeline;
+
+    std::cout << "handoff benchmark (" << iterations << " handoffs per backend, frames-in-flight: " << vk_core.num_frames_in_flight << "):" << std::endl;
+    std::cout << "  backend, latency (us/handoff), throughput (us/handoff)" << std::endl;
+
+    for (const bool timeline : { false, true })
+    {
+        if (timeline && !vk_has_timeline)
+        {
+            std::cout << "  timeline, not supported" << std::endl;
+            continue;
+        }
+
+        // the render thread always submits with the timeline backend
+        if (!timeline && vk_threaded)
+        {
+            std::cout << "  binary, not available with the render thread" << std::endl;
+            continue;
+        }
+
+        // switch backends only while nothing is in flight
+        vk_end_frame();
+        vk_acquire_interop_set(vk_current_set);
+        glFinish();
+        vk_wait_idle();
+        vk_use_timeline = timeline;
+
+        // latency: GL -> VK -> GL round trip of a single handoff, nothing else is queued
+        int64_t latency_ns = 0;
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            const int64_t t0 = piglit_time_get_nano();
+            vk_clear_fbo();
+            vk_acquire_interop_set(vk_current_set);   // no-op with a single interop set
+            glFinish();
+            latency_ns += piglit_time_get_nano() - t0;
+        }
+
+        // throughput: handoffs queue up, only limited by the frames-in-flight ring
+        const int64_t start_ns = piglit_time_get_nano();
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            vk_clear_fbo();
+            vk_acquire_interop_set(vk_current_set);
+        }
+        glFinish();
+        vk_wait_idle();
+        const int64_t throughput_ns = piglit_time_get_nano() - start_ns;
+
+        std::cout << "  " << (timeline ? "timeline" : "binary")
+            << ", " << latency_ns / 1000.0 / iterations
+            << ", " << throughput_ns / 1000.0 / iterations
+            << std::endl;
+    }
+
+    vk_use_timeline = use_timeline;
+}
+
+void vk_benchmark_parallel_recording(size_t num_objects, uint32_t iterations)
+{
+    if (num_objects == 0 || iterations == 0)
+        return;
+
+    if (vk_prerecorded)
+    {
+        std::cout << "WARNING: vk_benchmark_parallel_recording() requires freshly recorded command buffers (no -prerecord)" << std::endl;
+        return;
+    }
+
+    // the recording is measured on the calling thread
+    if (vk_threaded)
+    {
+        std::cout << "WARNING: vk_benchmark_parallel_recording() is not available with the render thread" << std::endl;
+        return;
+    }
+
+    vk_end_frame();
+    vk_wait_idle();
+
+    // a grid of small cubes covering the viewport, one draw each
+    std::vector<glm::mat4> mvps(num_objects);
+    const size_t grid = (size_t)std::ceil(std::sqrt((double)num_objects));
+    const float cell = 2.0f / grid;
+    for (size_t i = 0; i < num_objects; ++i)
+    {
+        const glm::vec3 pos(
+            -1.0f + cell * (0.5f + (float)(i % grid)),
+            -1.0f + cell * (0.5f + (float)(i / grid)),
+            0.5f);
+        mvps[i] = glm::scale(glm::translate(glm::mat4(1.0f), pos), glm::vec3(cell * 0.5f, cell * 0.5f, 0.01f));
+    }
+
+    // 1, 2, 4, ... recording threads, the last step always uses all of them
+    std::vector<uint32_t> steps;
+    for (uint32_t threads = 1; threads < vk_record_num_threads; threads *= 2)
+        steps.push_back(threads);
+    steps.push_back(vk_record_num_threads);
+
+    std::cout << "parallel recording benchmark (" << num_objects << " draws, " << iterations << " frames per step):" << std::endl;
+    std::cout << "  threads, recording (ms/frame), speedup, draws/ms" << std::endl;
+
+    double single_thread_ms = 0.0;
+    for (const uint32_t threads : steps)
+    {
+        // every frame draws the list with vk_draw_cube_list(), only that call is measured (secondary command-buffers
+        // + executing them from the primary one), time spent waiting for the GPU in vk_acquire_frame() and the
+        // submission are excluded
+        vk_record_max_threads = threads;
+        int64_t record_ns = 0;
+        for (uint32_t i = 0; i <= iterations; ++i)
+        {
+            vk_begin_frame();
+            const int64_t t0 = piglit_time_get_nano();
+            vk_draw_cube_list(mvps.data(), num_objects);
+            // the first frame warms up the command pools
+            if (i > 0)
+                record_ns += piglit_time_get_nano() - t0;
+            vk_end_frame();
+        }
+        vk_wait_idle();
+
+        const double record_ms = record_ns / 1000000.0 / iterations;
+        if (threads == 1)
+            single_thread_ms = record_ms;
+
+        std::cout << "  " << threads
+            << ", " << record_ms
+            << ", " << (record_ms > 0.0 ? single_thread_ms / record_ms : 0.0) << "x"
+            << ", " << (record_ms > 0.0 ? num_objects / record_ms : 0.0)
+            << std::endl;
+    }
+
+    vk_record_max_threads = vk_record_num_threads;
+}
+
+void vk_benchmark_uploads(uint32_t iterations)
+{
+    if (iterations == 0)
+        return;
+
+    // the benchmark records & submits on the calling thread
+    vk_end_frame();
+    vk_wait_idle();
+
+    const VkDeviceSize frame_bytes = 4u << 20;
+    const VkDeviceSize update_sizes[] = { 64, 1u << 10, 16u << 10, 256u << 10, 4u << 20 };
+
+    struct vk_buf host_buf = {};
+    struct vk_buf device_buf = {};
+    struct vk_staging_ring ring = {};
+    void* host_map = nullptr;
+
+    // the mapped buffer has a region per ring slot, the GPU may still read the previous frames
+    if (!vk_create_buffer(&vk_core, false, (uint32_t)(frame_bytes * vk_core.num_frames_in_flight),
+            (VkBufferUsageFlagBits)(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT), nullptr, &host_buf) ||
+        !vk_map_buffer(&vk_core, &host_buf, &host_map) ||
+        !vk_create_device_buffer(&vk_core, frame_bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &device_buf) ||
+        !vk_create_staging_ring(&vk_core, frame_bytes * (vk_core.num_frames_in_flight + 1), &ring))
+    {
+        fprintf(stderr, "Failed to create the upload benchmark buffers.\n");
+        vk_destroy_staging_ring(&vk_core, &ring);
+        vk_destroy_buffer(&vk_core, &device_buf);
+        vk_destroy_buffer(&vk_core, &host_buf);
+        return;
+    }
+
+    std::vector<uint8_t> src(frame_bytes, 0x5a);
+
+    std::cout << "upload benchmark (" << (frame_bytes >> 20) << " MiB per frame, " << iterations << " frames per step, "
+        << (vk_has_host_invisible_vram(&vk_core) ? "VRAM not host-visible" : "device-local memory host-visible") << "):" << std::endl;
+    std::cout << "  update size (bytes), mapped (ns/update), mapped (MB/s), staging (ns/update), staging (MB/s)" << std::endl;
+
+    for (const VkDeviceSize size : update_sizes)
+    {
+        const VkDeviceSize updates = frame_bytes / size;
+
+        // mapped: memcpy() straight into the persistently mapped buffer per update (the CPU cost), the GPU reads the frame
+        // from there with one copy into the device-local buffer, like a draw reads it over the bus; the throughput
+        // includes the GPU reads (until vk_wait_frames_idle() returned)
+        int64_t mapped_cpu_ns = 0;
+        const int64_t mapped_start_ns = piglit_time_get_nano();
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            struct vk_frame* frame = vk_acquire_frame(&vk_core);
+            if (!frame)
+                break;
+            const VkDeviceSize region = (VkDeviceSize)(frame - vk_core.frames) * frame_bytes;
+            vk_begin_cmd_buf(frame->cmd_buf);
+
+            const int64_t t0 = piglit_time_get_nano();
+            for (VkDeviceSize u = 0; u < updates; ++u)
+                memcpy((uint8_t*)host_map + region + u * size, src.data() + u * size, size);
+            mapped_cpu_ns += piglit_time_get_nano() - t0;
+
+            vk_record_copy_buffer(frame->cmd_buf, &host_buf, region, &device_buf, 0, frame_bytes);
+            vk_record_upload_barrier(frame->cmd_buf);
+            vk_end_cmd_buf(frame->cmd_buf);
+            vk_submit_cmd_bufs(&vk_core, frame, &frame->cmd_buf, 1, nullptr, false, false);
+        }
+        vk_wait_frames_idle(&vk_core);
+        const int64_t mapped_ns = piglit_time_get_nano() - mapped_start_ns;
+
+        // staging: ring allocation, memcpy() & vkCmdCopyBuffer() per update (the CPU cost), one barrier & submission per frame,
+        // the throughput includes the GPU copies (until vk_wait_frames_idle() returned)
+        int64_t staging_cpu_ns = 0;
+        VkDeviceSize staging_updates = 0;
+        VkDeviceSize dropped_updates = 0;
+        const int64_t staging_start_ns = piglit_time_get_nano();
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            struct vk_frame* frame = vk_acquire_frame(&vk_core);
+            if (!frame)
+                break;
+            vk_staging_ring_begin_frame(&ring, (uint32_t)(frame - vk_core.frames));
+            vk_begin_cmd_buf(frame->cmd_buf);
+
+            const int64_t t0 = piglit_time_get_nano();
+            for (VkDeviceSize u = 0; u < updates; ++u)
+            {
+                VkDeviceSize src_offset = 0;
+                void* dst = vk_staging_ring_alloc(&ring, size, 16, &src_offset);
+                if (!dst)
+                {
+                    dropped_updates += updates - u;
+                    break;
+                }
+                memcpy(dst, src.data() + u * size, size);
+                vk_record_upload(frame->cmd_buf, &ring, src_offset, &device_buf, u * size, size);
+                ++staging_updates;
+            }
+            staging_cpu_ns += piglit_time_get_nano() - t0;
+
+            vk_record_upload_barrier(frame->cmd_buf);
+            vk_end_cmd_buf(frame->cmd_buf);
+            vk_submit_cmd_bufs(&vk_core, frame, &frame->cmd_buf, 1, nullptr, false, false);
+        }
+        vk_wait_frames_idle(&vk_core);
+        const int64_t staging_ns = piglit_time_get_nano() - staging_start_ns;
+
+        const double total_bytes = (double)frame_bytes * iterations;
+        const double total_updates = (double)updates * iterations;
+        const double staging_bytes = (double)(staging_updates * size);
+
+        std::cout << "  " << size
+            << ", " << mapped_cpu_ns / total_updates
+            << ", " << (mapped_ns > 0 ? total_bytes * 1000.0 / mapped_ns : 0.0)
+            << ", " << (staging_updates > 0 ? staging_cpu_ns / (double)staging_updates : 0.0)
+            << ", " << (staging_ns > 0 ? staging_bytes * 1000.0 / staging_ns : 0.0)
+            << std::endl;
+
+        if (dropped_updates > 0)
+            std::cout << "WARNING: staging ring full, " << dropped_updates << " of " << total_updates
+                << " updates of " << size << " bytes dropped (not included above)" << std::endl;
+    }
+
+    vk_destroy_staging_ring(&vk_core, &ring);
+    vk_destroy_buffer(&vk_core, &device_buf);
+    vk_destroy_buffer(&vk_core, &host_buf);
+}
@@ -31,7 +31,157 @@
 		}                                                           \
 	} while (0)
 
-bool vk_init(uint32_t width, uint32_t height, int& msaa_samples, bool enable_validation, GLuint* OUT_gl_color_tex_id, GLuint* OUT_gl_depth_tex_id);
+#define VK_MAX_INTEROP_SETS 3
+
+// vertex layout of the shared vertex buffers: interleaved vec3 position + vec2 uv (see vk_shader.vert)
+#define VK_VERTEX_FLOATS 5
+
+struct vk_render_settings
+{
+    // number of Vulkan submissions that may be in flight before the CPU waits for the GPU ('1' == wait after every submit)
+    uint32_t frames_in_flight = 2;
+
+    // record the clear & cube command-buffers once in vk_init(), per frame only the MVP matrix is written to a mapped uniform buffer
+    bool prerecord_cmd_bufs = false;
+
+    // GL <-> VK handoff via one exported timeline semaphore pair with increasing values (VK_KHR_timeline_semaphore +
+    // GL_NV_timeline_semaphore) instead of a binary semaphore pair + fence per frames-in-flight slot,
+    // falls back to the binary semaphores if the driver lacks support
+    bool timeline_semaphores = true;
+
+    // MSAA: Vulkan renders into private multisampled images and resolves them in its render pass (depth: sample 0,
+    // requires VK_KHR_depth_stencil_resolve), GL only sees single-sample interop textures (see vk_get_interop_samples()).
+    // All Vulkan work of a frame must happen before GL renders into the interop textures, each resolve overwrites them.
+    bool resolve_msaa = false;
+
+    // sub-allocate the color & depth interop images from one exported allocation (one fd & one GL memory object instead of
+    // one per image), falls back to dedicated allocations if the driver requires them for the images
+    bool shared_interop_memory = true;
+
+    // the cube drawn by vk_draw_cube() / vk_draw_cubes(): num_cube_vertices * VK_VERTEX_FLOATS floats (triangle list), uploaded once
+    // into exported Vulkan memory that GL imports as well (see vk_get_cube_vertex_buffer()), required
+    const float* cube_vertices = nullptr;
+    uint32_t num_cube_vertices = 0;
+
+    // number of interop color & depth image sets (1 .. VK_MAX_INTEROP_SETS), each with its own GL textures, Vulkan framebuffers
+    // and pre-recorded command-buffers. With more than one set the GL side of a handoff is deferred until
+    // vk_acquire_interop_set(), so GL can render into one set while Vulkan renders into another (see vk_select_interop_set())
+    uint32_t interop_sets = 1;
+
+    // record & submit the Vulkan work on a render thread: vk_clear_fbo() / vk_draw_cube() / vk_draw_cubes() only store
+    // the operation, vk_end_frame() pushes the batch into a lock-free queue (the GL release & acquire of the handoff stay
+    // on the calling thread, the GPU-side order comes from the timeline semaphores, GL queues its wait before the render
+    // thread submitted). The calling thread never waits for a ring slot, only when it is a few batches ahead of the render thread.
+    // Requires the timeline backend and no pre-recorded command-buffers, disables the Vulkan GPU timestamps.
+    bool render_thread = false;
+
+    // upload the instance data of vk_draw_cubes() through a persistently mapped staging ring into a device-local buffer
+    // (vkCmdCopyBuffer() in the frame's command-buffer), only on devices whose VRAM isn't host-visible (vk_has_host_invisible_vram()),
+    // otherwise the GPU reads the mapped buffer as fast
+    bool staging_uploads = true;
+
+    // threads that record the draws of vk_draw_cube_list() in parallel, including the calling one (0 == one per hardware thread)
+    uint32_t record_threads = 0;
+
+    // write Vulkan timestamp queries around every recorded operation, see vk_get_gpu_timings()
+    bool gpu_timestamps = false;
+
+    // Vulkan device: nullptr == the one whose device & driver UUID match the current GL context (best scored device otherwise),
+    // else its index in vkEnumeratePhysicalDevices() or a substring of its name (the candidates are logged by vk_init())
+    const char* device = nullptr;
+
+    // compiled pipelines are loaded from / stored to this file to speed up the next start (nullptr == no on-disk cache)
+    const char* pipeline_cache_file = "vk_pipeline_cache.bin";
+
+    // NOTE: only enable this when running on systems where you have a Vulkan SDK installed !!!
+    bool enable_validation = false;
+};
+
+bool vk_init(uint32_t width, uint32_t height, int& msaa_samples, const vk_render_settings& settings, GLuint* OUT_gl_color_tex_id, GLuint* OUT_gl_depth_tex_id);
+
+// sample-count of the interop textures returned by vk_init() (1 with vk_render_settings::resolve_msaa)
+int vk_get_interop_samples();
+
+// vk_render_settings::render_thread is in use
+bool vk_render_thread_enabled();
+
+// Changes the render area to width x height (must not be called inside of a vk_begin_frame() / vk_end_frame() batch).
+// The interop images are allocated in size buckets, they are only recreated (together with the Vulkan framebuffers
+// and the GL textures) when the new size leaves the bucket, otherwise only the render area changes.
+// The GL textures may be larger than width x height, GL has to render into / blit from the (0, 0, width, height) region.
+// All interop sets are resized, GL's pending acquires (see vk_acquire_interop_set()) are waited for first.
+// OUT_*: the interop textures of the current set (re-attach them if they changed, the other sets: vk_get_interop_textures()),
+// returns false for a 0 size or on failure
+bool vk_resize(uint32_t width, uint32_t height, GLuint* OUT_gl_color_tex_id, GLuint* OUT_gl_depth_tex_id);
+
+// INTEROP SETS (vk_render_settings::interop_sets): all Vulkan work is recorded into the current set, which is selected
+// outside of a vk_begin_frame() / vk_end_frame() batch (an open batch is ended). vk_init() returns the textures of set 0.
+// With more than one set GL only waits for the Vulkan work of a set in vk_acquire_interop_set(), which has to be called
+// before GL touches the set's textures (no-op if nothing is pending, always the case with a single set).
+uint32_t vk_get_num_interop_sets();
+void vk_select_interop_set(uint32_t set);
+void vk_get_interop_textures(uint32_t set, GLuint* OUT_gl_color_tex_id, GLuint* OUT_gl_depth_tex_id);
+void vk_acquire_interop_set(uint32_t set);
+
+// SHARED GEOMETRY: one copy of the vertices for both APIs, in exported Vulkan memory that GL imports as the storage of a
+// buffer object (falls back to a separate GL copy if the driver can't import it). The GL buffers can back a GL_ARRAY_BUFFER
+// binding of a VAO, they are read-only and deleted by vk_shutdown().
+// the GL buffer of vk_render_settings::cube_vertices
+GLuint vk_get_cube_vertex_buffer();
+// num_vertices * VK_VERTEX_FLOATS floats, returns the GL buffer (0 on failure)
+GLuint vk_create_shared_vertex_buffer(const float* vertices, uint32_t num_vertices);
+
+// Batched frame: all vk_clear_fbo() / vk_draw_cube() calls between vk_begin_frame() and vk_end_frame()
+// are recorded into one command-buffer and share a single GL -> VK -> GL semaphore handoff.
+// The Vulkan work only executes in vk_end_frame(), so GL must not render into the interop images in between.
+// Outside of a batch every vk_* call is a batch of its own (one handoff per call).
+void vk_begin_frame();
+void vk_end_frame();
+
 void vk_clear_fbo();
 void vk_draw_cube(const glm::mat4 & mvp_matrix);
+
+// draws 'count' cubes with a single instanced draw call, the MVP matrices are uploaded into a per-instance storage buffer
+void vk_draw_cubes(const glm::mat4* mvps, size_t count);
+
+// draws 'count' cubes with one draw call each (the MVP as push constants), the list is split into chunks that the recording
+// threads (vk_render_settings::record_threads, started by the first list) record in parallel into secondary command-buffers
+// of their own command pools, executed from the frame's command-buffer in one render pass (not available with pre-recorded
+// command-buffers)
+void vk_draw_cube_list(const glm::mat4* mvps, size_t count);
 void vk_shutdown();
+
+// GPU time of the Vulkan work of one app frame (requires vk_render_settings::gpu_timestamps)
+struct vk_gpu_timings
+{
+    double clear_ms = 0.0;      // vk_clear_fbo()
+    double draw_ms = 0.0;       // vk_draw_cube() + vk_draw_cubes()
+};
+
+// tags all following Vulkan submissions with the app's frame index
+void vk_set_frame_index(uint64_t frame);
+
+// the timestamps of a submission are read back (without waiting) when its frames-in-flight ring slot is reused,
+// i.e. the results of a frame become available a few frames later; returns false until then
+bool vk_get_gpu_timings(uint64_t frame, vk_gpu_timings& out);
+
+// CPU-side microbenchmark: re-recording the cube command-buffer every frame vs. only submitting the pre-recorded one
+// (requires vk_render_settings::prerecord_cmd_bufs)
+void vk_benchmark_cmd_recording(uint32_t iterations);
+
+// scaling benchmark for vk_draw_cubes(): 1, 10, 100, ... max_instances cubes, each step renders num_frames frames
+// and reports the average frame-time and CPU submit cost
+void vk_benchmark_instancing(size_t max_instances, uint32_t num_frames);
+
+// scaling benchmark for vk_draw_cube_list(): recording time of num_objects draws with 1, 2, 4, ... recording threads
+// (requires freshly recorded command-buffers on the calling thread, no render thread)
+void vk_benchmark_parallel_recording(size_t num_objects, uint32_t iterations);
+
+// per-frame upload cost (4 MiB per frame in updates of 64 bytes .. 4 MiB): memcpy() into a mapped buffer vs. the staging ring
+// (allocation, memcpy() & vkCmdCopyBuffer() into a device-local buffer), CPU ns per update and MB/s until the GPU read the
+// data (the mapped buffer is read by one copy per frame)
+void vk_benchmark_uploads(uint32_t iterations);
+
+// GL -> VK -> GL handoff latency (one clear per handoff, glFinish() after each) and throughput (no glFinish() in between)
+// of the binary semaphore backend vs. the timeline semaphore backend (if supported)
+void vk_benchmark_handoff(uint32_t iterations);
@@ -1,106 +1,35 @@
 #version 430
 #extension GL_ARB_separate_shader_objects : enable
 
+// MVP_FROM_UNIFORM_BUFFER: variant for pre-recorded command-buffers (the MVP is updated in a mapped buffer instead of re-recording push constants)
+// MVP_FROM_INSTANCE_BUFFER: variant for instanced drawing (one MVP per instance, see vk_draw_cubes())
+#if defined(MVP_FROM_INSTANCE_BUFFER)
+layout(std430, set = 0, binding = 0) readonly buffer _instances {
+    mat4 mvp_matrix[];
+} instances;
+#   define MVP_MATRIX instances.mvp_matrix[gl_InstanceIndex]
+#elif defined(MVP_FROM_UNIFORM_BUFFER)
+layout(set = 0, binding = 0) uniform _ubo {
+    mat4 mvp_matrix;
+} ubo;
+#   define MVP_MATRIX ubo.mvp_matrix
+#else
 layout(push_constant) uniform _pc {
     mat4 mvp_matrix;
 } pc;
+#   define MVP_MATRIX pc.mvp_matrix
+#endif
 
-// cube vertex positions
-const vec3 pos[] = vec3[] (
-    vec3(-0.5, -0.5, -0.5),
-    vec3( 0.5, -0.5, -0.5),
-    vec3( 0.5,  0.5, -0.5),
-    vec3( 0.5,  0.5, -0.5),
-    vec3(-0.5,  0.5, -0.5),
-    vec3(-0.5, -0.5, -0.5),
-
-    vec3(-0.5, -0.5,  0.5),
-    vec3( 0.5, -0.5,  0.5),
-    vec3( 0.5,  0.5,  0.5),
-    vec3( 0.5,  0.5,  0.5),
-    vec3(-0.5,  0.5,  0.5),
-    vec3(-0.5, -0.5,  0.5),
-
-    vec3(-0.5,  0.5,  0.5),
-    vec3(-0.5,  0.5, -0.5),
-    vec3(-0.5, -0.5, -0.5),
-    vec3(-0.5, -0.5, -0.5),
-    vec3(-0.5, -0.5,  0.5),
-    vec3(-0.5,  0.5,  0.5),
-
-    vec3( 0.5,  0.5,  0.5),
-    vec3( 0.5,  0.5, -0.5),
-    vec3( 0.5, -0.5, -0.5),
-    vec3( 0.5, -0.5, -0.5),
-    vec3( 0.5, -0.5,  0.5),
-    vec3( 0.5,  0.5,  0.5),
-
-    vec3(-0.5, -0.5, -0.5),
-    vec3( 0.5, -0.5, -0.5),
-    vec3( 0.5, -0.5,  0.5),
-    vec3( 0.5, -0.5,  0.5),
-    vec3(-0.5, -0.5,  0.5),
-    vec3(-0.5, -0.5, -0.5),
-
-    vec3(-0.5,  0.5, -0.5),
-    vec3( 0.5,  0.5, -0.5),
-    vec3( 0.5,  0.5,  0.5),
-    vec3( 0.5,  0.5,  0.5),
-    vec3(-0.5,  0.5,  0.5),
-    vec3(-0.5,  0.5, -0.5)
-);
-
-// cube uv-coordinates
-const vec2 uv[] = vec2[] (
-    vec2(0.0, 0.0),
-    vec2(1.0, 0.0),
-    vec2(1.0, 1.0),
-    vec2(1.0, 1.0),
-    vec2(0.0, 1.0),
-    vec2(0.0, 0.0),
-
-    vec2(0.0, 0.0),
-    vec2(1.0, 0.0),
-    vec2(1.0, 1.0),
-    vec2(1.0, 1.0),
-    vec2(0.0, 1.0),
-    vec2(0.0, 0.0),
-
-    vec2(1.0, 0.0),
-    vec2(1.0, 1.0),
-    vec2(0.0, 1.0),
-    vec2(0.0, 1.0),
-    vec2(0.0, 0.0),
-    vec2(1.0, 0.0),
-
-    vec2(1.0, 0.0),
-    vec2(1.0, 1.0),
-    vec2(0.0, 1.0),
-    vec2(0.0, 1.0),
-    vec2(0.0, 0.0),
-    vec2(1.0, 0.0),
-
-    vec2(0.0, 1.0),
-    vec2(1.0, 1.0),
-    vec2(1.0, 0.0),
-    vec2(1.0, 0.0),
-    vec2(0.0, 0.0),
-    vec2(0.0, 1.0),
-
-    vec2(0.0, 1.0),
-    vec2(1.0, 1.0),
-    vec2(1.0, 0.0),
-    vec2(1.0, 0.0),
-    vec2(0.0, 0.0),
-    vec2(0.0, 1.0)
-);
+// interleaved vertices from the shared vertex buffer (the GL VAO reads the same memory, see vk_render_settings::cube_vertices)
+layout(location = 0) in vec3 in_pos;
+layout(location = 1) in vec2 in_uv;
 
 layout(location = 0) out vec2 uv_coord;
 
 void main()
 {
-	gl_Position = pc.mvp_matrix * vec4(pos[gl_VertexIndex], 1.0);
-    uv_coord = uv[gl_VertexIndex];
+	gl_Position = MVP_MATRIX * vec4(in_pos, 1.0);
+    uv_coord = in_uv;
 
     // see: https://matthewwellings.com/blog/the-new-vulkan-coordinate-system/
     // NOTE: this is only needed if we don't pre-multiply the correction matrix in the C++ code already
@@ -0,0 +1,182 @@
+#include "vkgl-bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+static const char* bench_phase_names[BENCH_PHASE_COUNT] = {
+    "vk_begin_frame",
+    "vk_clear_fbo",
+    "vk_draw_cube",
+    "vk_end_frame",
+    "gl_draw",
+    "blit",
+    "swap",
+    "frame",
+};
+
+using bench_clock = std::chrono::steady_clock;
+
+static bench_config bench_cfg;
+static bool bench_active = false;
+static uint32_t bench_frame_index = 0;
+
+static bench_clock::time_point bench_frame_start;
+static bench_clock::time_point bench_last_mark;
+static bench_clock::time_point bench_measure_start;
+static bench_clock::time_point bench_measure_end;
+
+static double bench_frame_ms[BENCH_PHASE_COUNT];
+static std::vector<double> bench_samples_ms[BENCH_PHASE_COUNT];
+
+void bench_init(const bench_config& config)
+{
+    bench_cfg = config;
+    bench_active = true;
+    bench_frame_index = 0;
+
+    for (auto& samples : bench_samples_ms)
+    {
+        samples.clear();
+        samples.reserve(config.frames);
+    }
+}
+
+uint32_t bench_total_frames()
+{
+    return bench_cfg.warmup_frames + bench_cfg.frames;
+}
+
+Camera bench_camera(uint32_t frame_index)
+{
+    // orbit through the interactive start position (see 'camera' in vkgl-test.cpp), always looking at the scene center
+    const float radius = 6.73f;
+    const float height = 0.96f;
+    const float pitch = -15.1f;
+
+    const uint32_t measured_index = frame_index > bench_cfg.warmup_frames ? frame_index - bench_cfg.warmup_frames : 0;
+    const float t = bench_cfg.frames > 0 ? (float)measured_index / (float)bench_cfg.frames : 0.0f;
+    const float angle = 45.0f + 360.0f * t;
+
+    const glm::vec3 position(
+        radius * std::cos(glm::radians(angle)),
+        height,
+        radius * std::sin(glm::radians(angle)));
+
+    return Camera(position, glm::vec3(0, 1, 0), angle - 180.0f, pitch);
+}
+
+void bench_frame_begin()
+{
+    if (!bench_active)
+        return;
+
+    bench_frame_start = bench_clock::now();
+    bench_last_mark = bench_frame_start;
+
+    if (bench_frame_index == bench_cfg.warmup_frames)
+        bench_measure_start = bench_frame_start;
+
+    std::fill(std::begin(bench_frame_ms), std::end(bench_frame_ms), 0.0);
+}
+
+void bench_mark(bench_phase phase)
+{
+    if (!bench_active)
+        return;
+
+    const auto now = bench_clock::now();
+    bench_frame_ms[phase] += std::chrono::duration<double, std::milli>(now - bench_last_mark).count();
+    bench_last_mark = now;
+}
+
+void bench_frame_end()
+{
+    if (!bench_active)
+        return;
+
+    const auto now = bench_clock::now();
+    bench_frame_ms[BENCH_PHASE_FRAME] = std::chrono::duration<double, std::milli>(now - bench_frame_start).count();
+
+    if (bench_frame_index >= bench_cfg.warmup_frames)
+    {
+        for (int i = 0; i < BENCH_PHASE_COUNT; ++i)
+            bench_samples_ms[i].push_back(bench_frame_ms[i]);
+
+        bench_measure_end = now;
+    }
+
+    ++bench_frame_index;
+}
+
+// nearest-rank percentile of sorted samples
+static double bench_percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+
+    const size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+static std::string bench_json_escape(const std::string& str)
+{
+    std::string escaped;
+    for (const char c : str)
+    {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        if ((unsigned char)c >= 0x20)
+            escaped += c;
+    }
+    return escaped;
+}
+
+void bench_write_json(std::ostream& out)
+{
+    const size_t measured_frames = bench_samples_ms[BENCH_PHASE_FRAME].size();
+    const double measured_seconds = measured_frames > 0
+        ? std::chrono::duration<double>(bench_measure_end - bench_measure_start).count()
+        : 0.0;
+
+    out << "{\n";
+    out << "  \"config\": {\n";
+    out << "    \"frames\": " << bench_cfg.frames << ",\n";
+    out << "    \"warmup_frames\": " << bench_cfg.warmup_frames << ",\n";
+    out << "    \"width\": " << bench_cfg.width << ",\n";
+    out << "    \"height\": " << bench_cfg.height << ",\n";
+    out << "    \"msaa_samples\": " << bench_cfg.msaa_samples << ",\n";
+    out << "    \"resolve_msaa\": " << (bench_cfg.resolve_msaa ? "true" : "false") << ",\n";
+    out << "    \"frames_in_flight\": " << bench_cfg.frames_in_flight << ",\n";
+    out << "    \"batch_vk_frame\": " << (bench_cfg.batch_vk_frame ? "true" : "false") << ",\n";
+    out << "    \"prerecord_cmd_bufs\": " << (bench_cfg.prerecord_cmd_bufs ? "true" : "false") << ",\n";
+    out << "    \"vk_render_thread\": " << (bench_cfg.vk_render_thread ? "true" : "false") << ",\n";
+    out << "    \"interop_sets\": " << bench_cfg.interop_sets << ",\n";
+    out << "    \"headless\": " << (bench_cfg.headless ? "true" : "false") << ",\n";
+    out << "    \"gl_renderer\": \"" << bench_json_escape(bench_cfg.gl_renderer) << "\"\n";
+    out << "  },\n";
+    out << "  \"throughput\": {\n";
+    out << "    \"measured_frames\": " << measured_frames << ",\n";
+    out << "    \"seconds\": " << measured_seconds << ",\n";
+    out << "    \"fps\": " << (measured_seconds > 0.0 ? measured_frames / measured_seconds : 0.0) << "\n";
+    out << "  },\n";
+    out << "  \"phases_ms\": {\n";
+
+    for (int i = 0; i < BENCH_PHASE_COUNT; ++i)
+    {
+        std::vector<double> sorted = bench_samples_ms[i];
+        std::sort(sorted.begin(), sorted.end());
+
+        out << "    \"" << bench_phase_names[i] << "\": {"
+            << " \"min\": " << (sorted.empty() ? 0.0 : sorted.front())
+            << ", \"p50\": " << bench_percentile(sorted, 50.0)
+            << ", \"p95\": " << bench_percentile(sorted, 95.0)
+            << ", \"p99\": " << bench_percentile(sorted, 99.0)
+            << ", \"max\": " << (sorted.empty() ? 0.0 : sorted.back())
+            << " }" << (i + 1 < BENCH_PHASE_COUNT ? "," : "") << "\n";
+    }
+
+    out << "  }\n";
+    out << "}\n";
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <learnopengl/camera.h>
+
+#include <stdint.h>
+#include <iostream>
+#include <string>
+
+// Deterministic frame-time benchmark (vkgl-bench target, or vkgl-test -bench N):
+// the camera follows a scripted path that only depends on the frame index, every frame is split into phases
+// that are timed on the CPU, and the min/p50/p95/p99/max per phase plus the throughput are reported as JSON.
+
+enum bench_phase
+{
+    BENCH_PHASE_VK_BEGIN_FRAME,     // includes waiting for a free frames-in-flight ring slot
+    BENCH_PHASE_VK_CLEAR_FBO,
+    BENCH_PHASE_VK_DRAW_CUBE,
+    BENCH_PHASE_VK_END_FRAME,       // GL -> VK -> GL handoff of a batched frame
+    BENCH_PHASE_GL_DRAW,
+    BENCH_PHASE_BLIT,
+    BENCH_PHASE_SWAP,
+    BENCH_PHASE_FRAME,              // whole frame, from bench_frame_begin() to bench_frame_end()
+
+    BENCH_PHASE_COUNT
+};
+
+struct bench_config
+{
+    uint32_t frames = 0;
+    uint32_t warmup_frames = 10;    // rendered before the measurement starts, not part of the report
+    uint32_t width = 0;
+    uint32_t height = 0;
+    int msaa_samples = 1;
+    bool resolve_msaa = false;      // MSAA resolved in the Vulkan render pass instead of the GL blit
+    uint32_t frames_in_flight = 0;
+    bool batch_vk_frame = false;
+    bool prerecord_cmd_bufs = false;
+    bool vk_render_thread = false;  // Vulkan recorded & submitted on a render thread, the vk_* phases are only the queueing
+    uint32_t interop_sets = 1;      // > 1: GL composites the previous frame's set while Vulkan renders the next one
+    bool headless = false;
+    std::string gl_renderer;
+};
+
+void bench_init(const bench_config& config);
+
+// total number of frames to render (warm-up + measured)
+uint32_t bench_total_frames();
+
+// the scripted camera for a frame: one full orbit around the scene over all measured frames
+Camera bench_camera(uint32_t frame_index);
+
+// bench_mark() adds the time since the previous mark (or since bench_frame_begin()) to a phase of the current frame,
+// so a phase that is split into several parts (e.g. GL draws before & after a Vulkan call) accumulates
+// (all three are no-ops until bench_init() was called)
+void bench_frame_begin();
+void bench_mark(bench_phase phase);
+void bench_frame_end();
+
+void bench_write_json(std::ostream& out);
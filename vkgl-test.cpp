@@ -18,14 +18,30 @@
 #include <learnopengl/camera.h>
 
 #include <vk-render.h>
-
+#include <gl-headless.h>
+#include <vkgl-bench.h>
+#include <frame-stats.h>
+#include <gl-batch.h>
+#include <texture-cache.h>
+#include <texture-loader.h>
+#include <trace.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <vector>
 
 #include "vkgl_options.h"
 
 void resize_window(int width, int height);
+void attach_interop_textures(GLuint framebuffer, GLuint color_tex, GLuint depth_tex);
 void update_window_title(GLFWwindow* window);
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -56,13 +72,46 @@ bool firstMouse = true;
 
 glm::mat4 projection;
 
+// current framebuffer size (the interop textures may be larger, see vk_resize()), updated by resize_window()
+uint32_t fb_width = 0;
+uint32_t fb_height = 0;
+
+// GL FBOs with the interop textures of each interop set attached (re-attached by resize_window())
+GLuint vkgl_framebuffers[VK_MAX_INTEROP_SETS] = {};
+uint32_t num_interop_sets = 1;
+
+// the interop sets that Vulkan rendered a frame into which GL did not composite yet, with the view of that frame
+// (reset by resize_window(), the render area changed)
+bool interop_set_pending[VK_MAX_INTEROP_SETS] = {};
+glm::mat4 interop_set_view[VK_MAX_INTEROP_SETS];
+
+// view matrix of the GL draws (the camera's, or the one of the frame that is composited)
+glm::mat4 gl_view_matrix;
+
+// std140 'PerView' uniform block of 5.1.framebuffers.vs, written once per frame by gl_update_per_view()
+#define GL_PER_VIEW_UBO_BINDING 0
+
+struct gl_per_view
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+};
+
+GLuint gl_per_view_ubo = 0;
+
+// location of the per-draw 'model' uniform, resolved once after linking
+GLint gl_model_location = -1;
+
 // timing
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+void gl_update_per_view();
 void gl_draw_mesh(GLuint vao_id, GLuint num_vertices, const glm::mat4& mvp_matrix, const Shader& shader, GLuint texture_id);
+void gl_benchmark_draws(uint32_t draws_per_frame, uint32_t frames, GLuint framebuffer, GLuint vao_id, const Shader& shader, GLuint texture_id, uint32_t batch_mesh);
 void print_gl_default_framebuffer_info();
 bool check_gl_capability();
+void shutdown_subsystems();
 
 std::tm get_time_now()
 {
@@ -75,9 +124,45 @@ int msaa_sample_count = 0; // global variable, so we can show it in window title
 
 int main(int argc, char* argv[])
 {
+    // time-to-first-frame is measured from here
+    const auto app_launch_time = std::chrono::steady_clock::now();
+
     VkGlAppOptions options;
 
     bool msaa_enabled = options.enable_msaa; // start with default value
+    bool resolve_msaa = options.resolve_msaa;
+    uint32_t width = options.width;
+    uint32_t height = options.height;
+    uint32_t frames_in_flight = options.frames_in_flight;
+    bool prerecord_cmd_bufs = options.prerecord_cmd_bufs;
+    bool vk_render_thread = options.vk_render_thread;
+    bool batch_vk_frame = options.batch_vk_frame;
+    const char* pipeline_cache_file = options.pipeline_cache_file;
+    const char* shader_cache_dir = options.shader_cache_dir;
+    uint32_t bench_cmd_recording_iterations = 0;
+    size_t bench_instancing_max = 0;
+    size_t bench_vk_recording_objects = 0;
+    uint32_t vk_record_threads = options.vk_record_threads;
+    bool vk_staging_uploads = options.vk_staging_uploads;
+    uint32_t bench_vk_upload_frames = 0;
+    const char* vk_device = options.vk_device;
+    uint32_t bench_handoff_iterations = 0;
+    uint32_t bench_texture_count = 0;
+    uint32_t bench_gl_draws = 0;
+    bool gl_batch = options.gl_batch;
+    bool async_textures = options.async_textures;
+    const char* texture_cache_dir = options.texture_cache_dir;
+    bool texture_cache_compress = options.texture_cache_compress;
+    bool timeline_semaphores = options.timeline_semaphores;
+    bool shared_interop_memory = options.shared_interop_memory;
+    uint32_t interop_sets = options.interop_sets;
+    bool headless = options.headless;
+    uint32_t headless_frames = options.headless_frames;
+    uint32_t bench_frames = options.bench_frames;
+    const char* bench_json_file = nullptr;
+    bool gpu_timers = options.gpu_timers;
+    const char* gpu_timers_csv_file = nullptr;
+    const char* trace_file = options.trace_file;
 
     for (int i = 1; i < argc; ++i)
     {
@@ -87,6 +172,86 @@ int main(int argc, char* argv[])
             msaa_enabled = true;
         else if (arg == "-no-msaa")
             msaa_enabled = false;
+        else if (arg == "-resolve-msaa")
+            resolve_msaa = true;
+        else if (arg == "-size" && i + 1 < argc)
+        {
+            unsigned int size_w = 0, size_h = 0;
+            if (std::sscanf(argv[++i], "%ux%u", &size_w, &size_h) == 2 && size_w > 0 && size_h > 0)
+            {
+                width = size_w;
+                height = size_h;
+            }
+        }
+        else if (arg == "-frames-in-flight" && i + 1 < argc)
+            frames_in_flight = (uint32_t)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "-prerecord")
+            prerecord_cmd_bufs = true;
+        else if (arg == "-vk-render-thread")
+            vk_render_thread = true;
+        else if (arg == "-vk-device" && i + 1 < argc)
+            vk_device = argv[++i];
+        else if (arg == "-no-batch")
+            batch_vk_frame = false;
+        else if (arg == "-no-pipeline-cache")
+            pipeline_cache_file = nullptr;
+        else if (arg == "-no-shader-cache")
+            shader_cache_dir = nullptr;
+        else if (arg == "-bench-cmd-recording" && i + 1 < argc)
+        {
+            bench_cmd_recording_iterations = (uint32_t)std::max(1, std::atoi(argv[++i]));
+            prerecord_cmd_bufs = true; // the benchmark compares against the pre-recorded command-buffers
+        }
+        else if (arg == "-bench-instancing" && i + 1 < argc)
+            bench_instancing_max = (size_t)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "-bench-vk-recording" && i + 1 < argc)
+            bench_vk_recording_objects = (size_t)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "-vk-record-threads" && i + 1 < argc)
+            vk_record_threads = (uint32_t)std::max(0, std::atoi(argv[++i]));
+        else if (arg == "-no-vk-staging")
+            vk_staging_uploads = false;
+        else if (arg == "-bench-vk-uploads" && i + 1 < argc)
+            bench_vk_upload_frames = (uint32_t)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "-bench-handoff" && i + 1 < argc)
+            bench_handoff_iterations = (uint32_t)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "-async-textures")
+            async_textures = true;
+        else if (arg == "-bench-textures" && i + 1 < argc)
+            bench_texture_count = (uint32_t)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "-no-texture-cache")
+            texture_cache_dir = nullptr;
+        else if (arg == "-texture-cache-s3tc")
+            texture_cache_compress = true;
+        else if (arg == "-gl-batch")
+            gl_batch = true;
+        else if (arg == "-bench-gl-draws" && i + 1 < argc)
+            bench_gl_draws = (uint32_t)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "-no-timeline")
+            timeline_semaphores = false;
+        else if (arg == "-no-shared-interop-mem")
+            shared_interop_memory = false;
+        else if (arg == "-interop-sets" && i + 1 < argc)
+            interop_sets = (uint32_t)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "-headless")
+        {
+            headless = true;
+            // optional frame count
+            if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0]))
+                headless_frames = (uint32_t)std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "-bench" && i + 1 < argc)
+            bench_frames = (uint32_t)std::max(0, std::atoi(argv[++i]));
+        else if (arg == "-bench-json" && i + 1 < argc)
+            bench_json_file = argv[++i];
+        else if (arg == "-gpu-timers")
+            gpu_timers = true;
+        else if (arg == "-gpu-timers-csv" && i + 1 < argc)
+        {
+            gpu_timers = true;
+            gpu_timers_csv_file = argv[++i];
+        }
+        else if (arg == "-trace" && i + 1 < argc)
+            trace_file = argv[++i];
     }
 
     // IMPORTANT: MSAA sample-count must be a power-of-two number !!!
@@ -104,6 +269,13 @@ int main(int argc, char* argv[])
         std::abort();
     }
 
+    // scoped zones of the main thread (and vk_init()) are recorded from here on, written at shutdown (see trace.h)
+    if (trace_file)
+    {
+        trace_init(trace_file);
+        trace_set_thread_name("main");
+    }
+
     auto start_time = get_time_now();
 
     auto& logger = std::cout;
@@ -111,43 +283,82 @@ int main(int argc, char* argv[])
     logger << " APP START - " << std::put_time(&start_time, "%a %b %d %H:%M:%S %Y") << std::endl;
     logger << "--------------------------------------------------------------------------------" << std::endl;
 
-    lastX = (float)options.width / 2.0;
-    lastY = (float)options.height / 2.0;
+    // the Vulkan resolve overwrites the interop textures, so all Vulkan work of a frame has to come before the GL draws
+    if (resolve_msaa && !batch_vk_frame)
+    {
+        logger << "WARNING: -resolve-msaa requires batched Vulkan frames, ignoring -no-batch" << std::endl;
+        batch_vk_frame = true;
+    }
 
-    // glfw: initialize and configure
-    // ------------------------------
-    glfwInit();
-    //glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    //glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-    //glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); // we do not handle window resizing in this prototype -> disable GLFW window resize/maximize
+    // GL composites the previous frame's set, an unbatched Vulkan cube in between the GL draws would end up in the wrong one
+    if (interop_sets > 1 && !batch_vk_frame)
+    {
+        logger << "WARNING: -interop-sets requires batched Vulkan frames, ignoring -no-batch" << std::endl;
+        batch_vk_frame = true;
+    }
 
-    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_USE_DEBUG_CONTEXT);
+    lastX = (float)width / 2.0;
+    lastY = (float)height / 2.0;
 
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
+    // headless: offscreen EGL context, a fixed number of frames, no window / swapchain / input
+    // bench: scripted camera path, per-phase timings reported as JSON (see vkgl-bench.h)
+    const bool bench = bench_frames > 0;
 
-    // glfw window creation
-    GLFWwindow* window = glfwCreateWindow(options.width, options.height, "Vulkan-GL Interop", NULL, NULL);
-    if (window == NULL)
+    GLFWwindow* window = NULL;
+
+    if (headless)
     {
-        logger << "ERROR: Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        if (!gl_headless_init(GL_USE_DEBUG_CONTEXT))
+        {
+            logger << "ERROR: Failed to create headless GL context" << std::endl;
+            gl_headless_shutdown();
+            return -1;
+        }
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetKeyCallback(window, key_callback);
+    else
+    {
+        // glfw: initialize and configure
+        // ------------------------------
+        glfwInit();
+        //glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        //glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+        //glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        // resizing recreates the interop images (see vk_resize()), the benchmark keeps its fixed size
+        glfwWindowHint(GLFW_RESIZABLE, bench ? GLFW_FALSE : GLFW_TRUE);
+
+        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_USE_DEBUG_CONTEXT);
 
-    // tell GLFW to not capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+        // glfw window creation
+        window = glfwCreateWindow(width, height, "Vulkan-GL Interop", NULL, NULL);
+        if (window == NULL)
+        {
+            logger << "ERROR: Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback(window, key_callback);
+
+        // tell GLFW to not capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+        // the benchmark measures throughput, it must not be limited by vsync
+        if (bench)
+            glfwSwapInterval(0);
+    }
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
-    const int glad_init_result = gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    const int glad_init_result = gladLoadGLLoader(headless
+        ? (GLADloadproc)gl_headless_get_proc_address
+        : (GLADloadproc)glfwGetProcAddress);
 
     if (!glad_init_result)
     {
@@ -161,7 +372,9 @@ int main(int argc, char* argv[])
         return -1;
     }
 
-    print_gl_default_framebuffer_info();
+    // there is no default framebuffer in headless mode
+    if (!headless)
+        print_gl_default_framebuffer_info();
 
     logger << "Enabling GL Debug Output..." << std::endl;
     if (!gl_enable_debug_output())
@@ -169,31 +382,7 @@ int main(int argc, char* argv[])
         logger << "ERROR: Failed to initialize GL DEBUG OUTPUT" << std::endl;
     }
 
-    GLuint gl_color_tex = 0, gl_depth_tex = 0;
-
-    // initialize vulkan & interop
-    if (!vk_init(
-        options.width,
-        options.height,
-        msaa_sample_count, // NOTE: this value will be modified, if the GPU capabilities do not support the desired sample-count
-        options.ENABLE_VULKAN_VALIDATION_LAYER,
-        &gl_color_tex,
-        &gl_depth_tex
-    ))
-    {
-        vk_shutdown();
-        return -1;
-    }
-
-    // configure global opengl state
-    // -----------------------------
-    glEnable(GL_DEPTH_TEST);
-
-    // build and compile shaders
-    // -------------------------
-    Shader shader("5.1.framebuffers.vs", "5.1.framebuffers.fs");
-
-    // set up vertex data (and buffer(s)) and configure vertex attributes
+    // set up vertex data (uploaded once into Vulkan memory that is shared with GL, see vk_create_shared_vertex_buffer())
     // ------------------------------------------------------------------
     float cubeVertices[] = {
         // positions          // texture Coords
@@ -249,157 +438,498 @@ int main(int argc, char* argv[])
         -5.0f, -0.5f, -5.0f,  0.0f, 2.0f,
          5.0f, -0.5f, -5.0f,  2.0f, 2.0f
     };
-    // cube VAO
-    GLuint cubeVAO = 0, cubeVBO = 0;
+
+    GLuint gl_color_tex = 0, gl_depth_tex = 0;
+
+    vk_render_settings vk_settings;
+    vk_settings.frames_in_flight = frames_in_flight;
+    vk_settings.prerecord_cmd_bufs = prerecord_cmd_bufs;
+    vk_settings.render_thread = vk_render_thread;
+    vk_settings.record_threads = vk_record_threads;
+    vk_settings.staging_uploads = vk_staging_uploads;
+    vk_settings.device = vk_device;
+    vk_settings.enable_validation = options.ENABLE_VULKAN_VALIDATION_LAYER;
+    vk_settings.pipeline_cache_file = pipeline_cache_file;
+    vk_settings.gpu_timestamps = gpu_timers;
+    vk_settings.timeline_semaphores = timeline_semaphores;
+    vk_settings.shared_interop_memory = shared_interop_memory;
+    vk_settings.resolve_msaa = resolve_msaa;
+    vk_settings.interop_sets = interop_sets;
+    vk_settings.cube_vertices = cubeVertices;
+    vk_settings.num_cube_vertices = sizeof(cubeVertices) / (VK_VERTEX_FLOATS * sizeof(float));
+
+    // build and compile shaders
+    // (only issued here, the driver compiles / loads the program binary while vk_init() runs, see shader_binary_cache.h)
+    // -------------------------
+    ShaderBinaryCache::setDirectory(shader_cache_dir);
+    if (GLAD_GL_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    else if (GLAD_GL_ARB_parallel_shader_compile)
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    const auto shader_start_time = std::chrono::high_resolution_clock::now();
+    Shader shader("5.1.framebuffers.vs", "5.1.framebuffers.fs", true);
+
+    // initialize vulkan & interop
+    if (!vk_init(
+        width,
+        height,
+        msaa_sample_count, // NOTE: this value will be modified, if the GPU capabilities do not support the desired sample-count
+        vk_settings,
+        &gl_color_tex,
+        &gl_depth_tex
+    ))
+    {
+        vk_shutdown();
+        return -1;
+    }
+
+    if (bench_cmd_recording_iterations > 0)
+    {
+        vk_benchmark_cmd_recording(bench_cmd_recording_iterations);
+        shutdown_subsystems();
+        return 0;
+    }
+
+    if (bench_instancing_max > 0)
+    {
+        vk_benchmark_instancing(bench_instancing_max, 100);
+        shutdown_subsystems();
+        return 0;
+    }
+
+    if (bench_vk_recording_objects > 0)
+    {
+        vk_benchmark_parallel_recording(bench_vk_recording_objects, 20);
+        shutdown_subsystems();
+        return 0;
+    }
+
+    if (bench_vk_upload_frames > 0)
+    {
+        vk_benchmark_uploads(bench_vk_upload_frames);
+        shutdown_subsystems();
+        return 0;
+    }
+
+    if (bench_handoff_iterations > 0)
+    {
+        vk_benchmark_handoff(bench_handoff_iterations);
+        shutdown_subsystems();
+        return 0;
+    }
+
+    if (bench_texture_count > 0)
+    {
+        const std::string texture_files[] = {
+            FileSystem::getPath("resources/textures/container.jpg"),
+            FileSystem::getPath("resources/textures/metal.png"),
+        };
+        const char* texture_paths[] = { texture_files[0].c_str(), texture_files[1].c_str() };
+
+        tex_loader_init(0);
+        tex_loader_benchmark(texture_paths, 2, bench_texture_count, loadTexture);
+        tex_loader_shutdown();
+        shutdown_subsystems();
+        return 0;
+    }
+
+    // configure global opengl state
+    // -----------------------------
+    glEnable(GL_DEPTH_TEST);
+
+    shader.finishLink();
+    std::cout << "GL program: " << (shader.loadedFromBinary() ? "cached binary" : "compiled") << ", ready "
+        << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - shader_start_time).count()
+        << " ms after it was issued (vk_init() in between)" << std::endl;
+    shader.bindUniformBlock("PerView", GL_PER_VIEW_UBO_BINDING);
+    gl_model_location = shader.getUniformLocation("model");
+
+    // the binding point keeps the per-view uniform buffer bound for all draws
+    glGenBuffers(1, &gl_per_view_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, gl_per_view_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(gl_per_view), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, GL_PER_VIEW_UBO_BINDING, gl_per_view_ubo);
+
+    // cube VAO (the same vertex buffer the Vulkan cube is drawn from)
+    GLuint cubeVAO = 0;
+    const GLuint cubeVBO = vk_get_cube_vertex_buffer();
     glGenVertexArrays(1, &cubeVAO);
-    glGenBuffers(1, &cubeVBO);
     glBindVertexArray(cubeVAO);
     glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), &cubeVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     glBindVertexArray(0);
     // plane VAO
-    GLuint planeVAO = 0, planeVBO = 0;
+    GLuint planeVAO = 0;
+    const GLuint planeVBO = vk_create_shared_vertex_buffer(planeVertices, sizeof(planeVertices) / (VK_VERTEX_FLOATS * sizeof(float)));
+    if (!planeVBO)
+    {
+        logger << "ERROR: Failed to create the plane vertex buffer" << std::endl;
+        return 1;
+    }
     glGenVertexArrays(1, &planeVAO);
-    glGenBuffers(1, &planeVBO);
     glBindVertexArray(planeVAO);
     glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), &planeVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     glBindVertexArray(0);
 
-    // load textures
+    // batch renderer: the same meshes merged into one vertex buffer, all GL draws in one multi-draw (see gl-batch.h)
+    uint32_t cube_batch_mesh = 0, plane_batch_mesh = 0;
+    if ((gl_batch || bench_gl_draws > 0) && gl_batch_init(std::max(1024u, bench_gl_draws), GL_PER_VIEW_UBO_BINDING))
+    {
+        cube_batch_mesh = gl_batch_add_mesh(cubeVertices, vk_settings.num_cube_vertices);
+        plane_batch_mesh = gl_batch_add_mesh(planeVertices, sizeof(planeVertices) / (VK_VERTEX_FLOATS * sizeof(float)));
+    }
+    gl_batch = gl_batch && gl_batch_enabled();
+
+    // load textures (async: with a placeholder image until tex_loader_update() uploaded them, see texture-loader.h)
+    // (cached mip chains are uploaded without decoding, see texture-cache.h)
     // -------------
-    unsigned int cubeTexture = loadTexture(FileSystem::getPath("resources/textures/container.jpg").c_str());
-    unsigned int floorTexture = loadTexture(FileSystem::getPath("resources/textures/metal.png").c_str());
+    tex_cache_init(texture_cache_dir, texture_cache_compress);
+    if (async_textures)
+        tex_loader_init(0);
+    auto load_texture = async_textures ? tex_loader_load : loadTexture;
+    unsigned int cubeTexture = load_texture(FileSystem::getPath("resources/textures/container.jpg").c_str());
+    unsigned int floorTexture = load_texture(FileSystem::getPath("resources/textures/metal.png").c_str());
+    gl_batch_set_texture(0, cubeTexture);
+    gl_batch_set_texture(1, floorTexture);
 
     // shader configuration
     // --------------------
     shader.use();
     shader.setInt("texture1", 0);
 
-    // framebuffer configuration
+    // framebuffer configuration (one FBO per interop set)
     // -------------------------
-    GLuint vkgl_framebuffer;
-    glGenFramebuffers(1, &vkgl_framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, vkgl_framebuffer);
+    num_interop_sets = vk_get_num_interop_sets();
+    glGenFramebuffers(num_interop_sets, vkgl_framebuffers);
+    for (uint32_t i = 0; i < num_interop_sets; ++i)
+    {
+        vk_get_interop_textures(i, &gl_color_tex, &gl_depth_tex);
+        attach_interop_textures(vkgl_framebuffers[i], gl_color_tex, gl_depth_tex);
 
-    const auto target = msaa_sample_count > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+        // now that we actually created the framebuffer and added all attachments we want to check if it is actually complete now
+        glBindFramebuffer(GL_FRAMEBUFFER, vkgl_framebuffers[i]);
+        const auto fbo_state = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (fbo_state != GL_FRAMEBUFFER_COMPLETE)
+        {
+            logger << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
+            return 1;
+        }
+    }
 
-    // attach interop COLOR render-texture to GL FBO
-    GL_CHECK(glBindTexture(target, gl_color_tex));
-    GL_CHECK(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target, gl_color_tex, 0));
-    //GL_CHECK(glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-    //GL_CHECK(glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-    GL_CHECK(glBindTexture(target, 0));
+    // headless: there is no window framebuffer, the blit (and with it the GL MSAA resolve) goes into an offscreen
+    // renderbuffer instead, so that headless benchmarks still measure it
+    GLuint present_framebuffer = 0, present_renderbuffer = 0;
+    if (headless)
+    {
+        glGenRenderbuffers(1, &present_renderbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, present_renderbuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &present_framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, present_framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, present_renderbuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
 
-    // attach interop DEPTH render-texture to GL FBO
-    GL_CHECK(glBindTexture(target, gl_depth_tex));
-    GL_CHECK(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, target, gl_depth_tex, 0));
-    GL_CHECK(glBindTexture(target, 0));
+    // Call resize_window() manually once, to set up the camera projection matrix & GL viewport dimensions
+    // (the window framebuffer can be larger than requested on high-DPI displays)
+    int initial_fb_width = (int)width, initial_fb_height = (int)height;
+    if (!headless)
+        glfwGetFramebufferSize(window, &initial_fb_width, &initial_fb_height);
+    resize_window(initial_fb_width, initial_fb_height);
+    if (!headless)
+        update_window_title(window);
+
+    if (bench_gl_draws > 0)
+    {
+        gl_benchmark_draws(bench_gl_draws, 100, vkgl_framebuffers[0], cubeVAO, shader, cubeTexture, cube_batch_mesh);
+        gl_batch_shutdown();
+        glDeleteBuffers(1, &gl_per_view_ubo);
+        tex_loader_shutdown();
+        tex_cache_shutdown();
+        shutdown_subsystems();
+        return 0;
+    }
 
-    // now that we actually created the framebuffer and added all attachments we want to check if it is actually complete now
-    const auto fbo_state = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    if (fbo_state != GL_FRAMEBUFFER_COMPLETE)
+    if (bench)
     {
-        logger << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
-        return 1;
+        bench_config config;
+        config.frames = bench_frames;
+        config.width = width;
+        config.height = height;
+        config.msaa_samples = msaa_sample_count;
+        config.resolve_msaa = vk_get_interop_samples() < msaa_sample_count;
+        config.frames_in_flight = frames_in_flight;
+        config.batch_vk_frame = batch_vk_frame;
+        config.prerecord_cmd_bufs = prerecord_cmd_bufs;
+        config.vk_render_thread = vk_render_thread_enabled();
+        config.interop_sets = num_interop_sets;
+        config.headless = headless;
+        config.gl_renderer = (const char*)glGetString(GL_RENDERER);
+        bench_init(config);
     }
 
-    // Call resize_window() manually once, to set up the camera projection matrix & GL viewport dimensions
-    resize_window(options.width, options.height);
-    update_window_title(window);
+    // GL & VK timestamp queries, read back a few frames later (see frame-stats.h)
+    if (gpu_timers && !frame_stats_init(gpu_timers_csv_file, !prerecord_cmd_bufs && !vk_render_thread_enabled()))
+        gpu_timers = false;
+
+    // frame-time statistics (printed at shutdown, used to compare e.g. different frames-in-flight settings)
+    uint64_t stats_frame_count = 0;
+    double stats_frame_time_sum = 0.0;
+    double stats_frame_time_min = std::numeric_limits<double>::max();
+    double stats_frame_time_max = 0.0;
+
+    // steady clock instead of glfwGetTime(), GLFW is not initialized in headless mode
+    const auto app_clock_start = std::chrono::steady_clock::now();
+
+    // fixed number of frames in headless & benchmark mode, otherwise until the window gets closed
+    const uint32_t max_frames = bench ? bench_total_frames() : (headless ? headless_frames : 0);
 
     // render loop
     // -----------
-    while (!glfwWindowShouldClose(window))
+    while (max_frames > 0 ? stats_frame_count < max_frames : !glfwWindowShouldClose(window))
     {
+        TRACE_ZONE("frame");
+
+        bench_frame_begin();
+        frame_stats_begin_frame(stats_frame_count);
+
+        // swap in the textures that finished decoding since the last frame
+        tex_loader_update();
+
         // clear the window framebuffer RED, just for potential debugging purposes
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClearColor(1.0, 0.0, 0.0, 1.0);
-        glClear(GL_COLOR_BUFFER_BIT);
+        if (!headless)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glClearColor(1.0, 0.0, 0.0, 1.0);
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
+
+        // the benchmark camera only depends on the frame index, so every run renders the same frames
+        if (bench)
+            camera = bench_camera((uint32_t)stats_frame_count);
 
         // per-frame time logic
         // --------------------
-        float currentFrame = static_cast<float>(glfwGetTime());
+        float currentFrame = std::chrono::duration<float>(std::chrono::steady_clock::now() - app_clock_start).count();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
+        // skip the first frame, its delta contains all of the startup time
+        if (stats_frame_count++ > 0)
+        {
+            stats_frame_time_sum += deltaTime;
+            stats_frame_time_min = std::min(stats_frame_time_min, (double)deltaTime);
+            stats_frame_time_max = std::max(stats_frame_time_max, (double)deltaTime);
+        }
+
         // input
         // -----
-        processInput(window);
-
-        // clear color & depth via vulkan
-        vk_clear_fbo();
+        if (!headless && !bench)
+            processInput(window);
 
-        // render
-        // ------
-        // bind vkgl interop framebuffer and draw scene as we normally would
-        GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, vkgl_framebuffer));
+        // Vulkan part of the scene
+        const glm::mat4 vk_mvp_mat =
+            vk_ndc_to_gl_ndc *
+            projection *
+            camera.GetViewMatrix() *
+            glm::translate(glm::mat4(1), vk_cube_position)
+            ;
 
-        // clear color & depth via GL (this is just for testing)
-        //glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
-        //glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        bench_mark(BENCH_PHASE_GL_DRAW);
 
-        // draw some GL
-        gl_draw_mesh(cubeVAO, 36, glm::translate(glm::mat4(1.0f), glm::vec3(-3.0f, 0.0f, -3.0f)), shader, cubeTexture);
-        gl_draw_mesh(cubeVAO, 36, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 0.0f)), shader, cubeTexture);
+        // INTEROP SETS: Vulkan renders this frame into its own set, GL composites the set of the previous frame meanwhile
+        // (with a single set both are the same and GL waits for the Vulkan work of this frame)
+        const uint32_t vk_set = (uint32_t)((stats_frame_count - 1) % num_interop_sets);
+        const uint32_t gl_set = (vk_set + num_interop_sets - 1) % num_interop_sets;
 
-        // then draw some VK
+        if (batch_vk_frame)
         {
-            glm::mat4 view = camera.GetViewMatrix();
-            const auto vk_mvp_mat =
-                vk_ndc_to_gl_ndc *
-                projection *
-                view *
-                glm::translate(glm::mat4(1), vk_cube_position)
-                ;
+            // clear + cube share a single GL -> VK -> GL handoff,
+            // the GL meshes below are depth-tested against the VK cube afterwards
+            vk_select_interop_set(vk_set);
+            vk_begin_frame();
+            bench_mark(BENCH_PHASE_VK_BEGIN_FRAME);
+            vk_clear_fbo();
+            bench_mark(BENCH_PHASE_VK_CLEAR_FBO);
             vk_draw_cube(vk_mvp_mat);
+            bench_mark(BENCH_PHASE_VK_DRAW_CUBE);
+            vk_end_frame();
+            bench_mark(BENCH_PHASE_VK_END_FRAME);
+        }
+        else
+        {
+            // clear color & depth via vulkan
+            vk_clear_fbo();
+            bench_mark(BENCH_PHASE_VK_CLEAR_FBO);
         }
 
-        // then draw some GL again
-        gl_draw_mesh(cubeVAO, 36, glm::translate(glm::mat4(1.0f), glm::vec3(+3.0f, 0.0f, +3.0f)), shader, cubeTexture);
-        gl_draw_mesh(planeVAO, 6, glm::mat4(1.0f), shader, floorTexture);
+        interop_set_pending[vk_set] = true;
+        interop_set_view[vk_set] = camera.GetViewMatrix();
 
-        // now copy the VK-GL FBO results to the GLFW window framebuffer
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, vkgl_framebuffer);   // vkgl interop FBO
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);                  // window swapchain framebuffer
+        // nothing to composite yet in the first frame (and after a resize) with several sets
+        if (interop_set_pending[gl_set])
+        {
+            interop_set_pending[gl_set] = false;
+            gl_view_matrix = interop_set_view[gl_set];
+            gl_update_per_view();
+
+            // GL waits for the Vulkan work of the set here (no-op with a single set, vk_end_frame() did already)
+            vk_acquire_interop_set(gl_set);
+
+            // render
+            // ------
+            // bind vkgl interop framebuffer and draw scene as we normally would
+            GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, vkgl_framebuffers[gl_set]));
+
+            // clear color & depth via GL (this is just for testing)
+            //glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+            //glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            // draw some GL (batched: all GL meshes in one multi-draw after the Vulkan cube, the depth test keeps the result the same)
+            if (!gl_batch)
+            {
+                gl_draw_mesh(cubeVAO, 36, glm::translate(glm::mat4(1.0f), glm::vec3(-3.0f, 0.0f, -3.0f)), shader, cubeTexture);
+                gl_draw_mesh(cubeVAO, 36, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 0.0f)), shader, cubeTexture);
+            }
+
+            // then draw some VK (unbatched: a handoff of its own)
+            if (!batch_vk_frame)
+            {
+                bench_mark(BENCH_PHASE_GL_DRAW);
+                vk_draw_cube(vk_mvp_mat);
+                bench_mark(BENCH_PHASE_VK_DRAW_CUBE);
+            }
+
+            // then draw some GL again
+            if (gl_batch)
+            {
+                gl_batch_draw(cube_batch_mesh, glm::translate(glm::mat4(1.0f), glm::vec3(-3.0f, 0.0f, -3.0f)), 0);
+                gl_batch_draw(cube_batch_mesh, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 0.0f)), 0);
+                gl_batch_draw(cube_batch_mesh, glm::translate(glm::mat4(1.0f), glm::vec3(+3.0f, 0.0f, +3.0f)), 0);
+                gl_batch_draw(plane_batch_mesh, glm::mat4(1.0f), 1);
+                gl_batch_submit();
+            }
+            else
+            {
+                gl_draw_mesh(cubeVAO, 36, glm::translate(glm::mat4(1.0f), glm::vec3(+3.0f, 0.0f, +3.0f)), shader, cubeTexture);
+                gl_draw_mesh(planeVAO, 6, glm::mat4(1.0f), shader, floorTexture);
+            }
+
+            bench_mark(BENCH_PHASE_GL_DRAW);
+
+            // now copy the VK-GL FBO results to the GLFW window framebuffer (headless: to the offscreen present FBO)
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, vkgl_framebuffers[gl_set]);     // vkgl interop FBO
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, present_framebuffer);            // window swapchain framebuffer / offscreen present FBO
+
+            // IMPORTANT: resolving MSAA Depth + Stencil buffer attachments can only work if the Vulkan and OpenGL formats for depth & stencil do match EXACTLY !!!
+            // (otherwise you will get an OpenGL error here)
+            // Currently the only generally available Depth-Stencil format for all IHVs [NVidia, AMD, Intel] might be VK_FORMAT_D32_SFLOAT_S8_UINT.
+            // see also: https://github.com/KhronosGroup/Vulkan-Guide/blob/main/chapters/depth.adoc#depth-formats
+            {
+                TRACE_ZONE("glBlitFramebuffer");
+                gl_timer_begin(GL_TIMER_BLIT);
+                GL_CHECK(glBlitFramebuffer(0, 0, fb_width, fb_height, 0, 0, fb_width, fb_height,
+                    //GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT,
+                    GL_COLOR_BUFFER_BIT,
+                    GL_NEAREST
+                ));
+                gl_timer_end(GL_TIMER_BLIT);
+            }
+
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            bench_mark(BENCH_PHASE_BLIT);
+        }
 
-        // IMPORTANT: resolving MSAA Depth + Stencil buffer attachments can only work if the Vulkan and OpenGL formats for depth & stencil do match EXACTLY !!!
-        // (otherwise you will get an OpenGL error here)
-        // Currently the only generally available Depth-Stencil format for all IHVs [NVidia, AMD, Intel] might be VK_FORMAT_D32_SFLOAT_S8_UINT.
-        // see also: https://github.com/KhronosGroup/Vulkan-Guide/blob/main/chapters/depth.adoc#depth-formats
-        GL_CHECK(glBlitFramebuffer(0, 0, options.width, options.height, 0, 0, options.width, options.height,
-            //GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT,
-            GL_COLOR_BUFFER_BIT,
-            GL_NEAREST
-        ));
+        if (!headless)
+        {
+            // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+            // -------------------------------------------------------------------------------
+            {
+                TRACE_ZONE("glfwSwapBuffers");
+                glfwSwapBuffers(window);
+            }
+            {
+                TRACE_ZONE("glfwPollEvents");
+                glfwPollEvents();
+            }
+
+            bench_mark(BENCH_PHASE_SWAP);
+        }
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (stats_frame_count == 1)
+        {
+            logger << "time to first frame: "
+                << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - app_launch_time).count() << " ms"
+                << (async_textures ? " (async textures)" : "") << std::endl;
+        }
+
+        frame_stats_end_frame();
+        bench_frame_end();
+    }
+
+    // wait until the GPU actually finished all frames
+    if (headless || bench || gpu_timers)
+        glFinish();
+
+    frame_stats_shutdown();
+
+    if (headless || bench)
+    {
 
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        const double total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - app_clock_start).count();
+        logger << "rendered " << stats_frame_count << " frames in " << total_seconds << " s"
+            << " (" << stats_frame_count / total_seconds << " fps)" << std::endl;
+    }
+
+    if (bench)
+    {
+        if (bench_json_file)
+        {
+            std::ofstream json(bench_json_file);
+            bench_write_json(json);
+            logger << "benchmark results written to " << bench_json_file << std::endl;
+        }
+        else
+        {
+            bench_write_json(std::cout);
+        }
     }
 
     // de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
     glDeleteVertexArrays(1, &cubeVAO);
     glDeleteVertexArrays(1, &planeVAO);
-    glDeleteBuffers(1, &cubeVBO);
-    glDeleteBuffers(1, &planeVBO);
-    glDeleteFramebuffers(1, &vkgl_framebuffer);
-
-    vk_shutdown();
-
-    glfwTerminate();
+    glDeleteBuffers(1, &gl_per_view_ubo);
+    gl_batch_shutdown();
+    // the vertex buffers are deleted by vk_shutdown()
+    tex_loader_shutdown();
+    tex_cache_shutdown();
+    glDeleteFramebuffers(num_interop_sets, vkgl_framebuffers);
+    glDeleteFramebuffers(1, &present_framebuffer);
+    glDeleteRenderbuffers(1, &present_renderbuffer);
+
+    shutdown_subsystems();
+
+    if (stats_frame_count > 1)
+    {
+        const double avg_frame_time = stats_frame_time_sum / (double)(stats_frame_count - 1);
+        logger << "frame-time stats (frames-in-flight: " << frames_in_flight << ", frames: " << stats_frame_count - 1 << ")"
+            << " avg: " << avg_frame_time * 1000.0 << " ms"
+            << " min: " << stats_frame_time_min * 1000.0 << " ms"
+            << " max: " << stats_frame_time_max * 1000.0 << " ms"
+            << " (" << 1.0 / avg_frame_time << " fps)" << std::endl;
+    }
 
     auto shutdown_time = get_time_now();
 
@@ -410,8 +940,43 @@ int main(int argc, char* argv[])
     return 0;
 }
 
+// shuts Vulkan, the window / headless context & the tracing down, shared by the normal exit and the benchmark exits
+// (the GL resources are deleted by the callers)
+void shutdown_subsystems()
+{
+    vk_shutdown();
+    glfwTerminate();
+    gl_headless_shutdown();
+    trace_shutdown();
+}
+
 void resize_window(int width, int height)
 {
+    // minimized window
+    if (width <= 0 || height <= 0)
+        return;
+
+    // the interop textures are only recreated when the size leaves their size bucket
+    if (vkgl_framebuffers[0])
+    {
+        GLuint gl_color_tex = 0, gl_depth_tex = 0;
+        if (!vk_resize((uint32_t)width, (uint32_t)height, &gl_color_tex, &gl_depth_tex))
+        {
+            std::cout << "ERROR: Failed to resize the interop textures to " << width << "x" << height << std::endl;
+            return;
+        }
+
+        for (uint32_t i = 0; i < num_interop_sets; ++i)
+        {
+            vk_get_interop_textures(i, &gl_color_tex, &gl_depth_tex);
+            attach_interop_textures(vkgl_framebuffers[i], gl_color_tex, gl_depth_tex);
+            interop_set_pending[i] = false;
+        }
+    }
+
+    fb_width = (uint32_t)width;
+    fb_height = (uint32_t)height;
+
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
@@ -419,6 +984,28 @@ void resize_window(int width, int height)
     projection = glm::perspective(glm::radians(camera.Zoom), (float)width / (float)height, 0.1f, 100.0f);
 }
 
+void attach_interop_textures(GLuint framebuffer, GLuint color_tex, GLuint depth_tex)
+{
+    // single-sample when Vulkan resolves the MSAA images itself
+    const auto target = vk_get_interop_samples() > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+
+    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer));
+
+    // attach interop COLOR render-texture to GL FBO
+    GL_CHECK(glBindTexture(target, color_tex));
+    GL_CHECK(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target, color_tex, 0));
+    //GL_CHECK(glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    //GL_CHECK(glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    GL_CHECK(glBindTexture(target, 0));
+
+    // attach interop DEPTH render-texture to GL FBO
+    GL_CHECK(glBindTexture(target, depth_tex));
+    GL_CHECK(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, target, depth_tex, 0));
+    GL_CHECK(glBindTexture(target, 0));
+
+    GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+}
+
 void processInput(GLFWwindow* window)
 {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
@@ -491,6 +1078,10 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 // ---------------------------------------------------
 unsigned int loadTexture(char const* path)
 {
+    // pre-baked mip chain, no decode & no glGenerateMipmap() (see texture-cache.h)
+    if (GLuint cachedTextureID = tex_cache_load(path))
+        return cachedTextureID;
+
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
@@ -515,6 +1106,9 @@ unsigned int loadTexture(char const* path)
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
+        // cache miss: bake the mip chain for the next launch
+        tex_cache_store(path, textureID, nrComponents);
+
         stbi_image_free(data);
     }
     else
@@ -545,18 +1139,132 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     }
 }
 
+void gl_update_per_view()
+{
+    const gl_per_view per_view = { gl_view_matrix, projection };
+
+    glBindBuffer(GL_UNIFORM_BUFFER, gl_per_view_ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(per_view), &per_view);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void gl_benchmark_draws(uint32_t draws_per_frame, uint32_t frames, GLuint framebuffer, GLuint vao_id, const Shader& shader, GLuint texture_id, uint32_t batch_mesh)
+{
+    using clock = std::chrono::steady_clock;
+
+    // a grid of small cubes in front of the camera, one model matrix per draw
+    const uint32_t grid = (uint32_t)std::ceil(std::sqrt((double)draws_per_frame));
+    std::vector<glm::mat4> models(draws_per_frame);
+    for (uint32_t i = 0; i < draws_per_frame; ++i)
+    {
+        const glm::vec3 pos((float)(i % grid) - grid * 0.5f, 0.0f, -(float)(i / grid));
+        models[i] = glm::scale(glm::translate(glm::mat4(1.0f), pos * 0.25f), glm::vec3(0.2f));
+    }
+
+    gl_view_matrix = camera.GetViewMatrix();
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    // the previous gl_draw_mesh(): view, projection & model are default-block uniforms of the program,
+    // each one looked up by name and uploaded with every draw
+    Shader uniforms_shader("gl_bench_uniforms.vs", "5.1.framebuffers.fs");
+    uniforms_shader.use();
+    uniforms_shader.setInt("texture1", 0);
+
+    auto draw_uncached = [&](const glm::mat4& model) {
+        uniforms_shader.use();
+        glUniformMatrix4fv(glGetUniformLocation(uniforms_shader.ID, "view"), 1, GL_FALSE, &gl_view_matrix[0][0]);
+        glUniformMatrix4fv(glGetUniformLocation(uniforms_shader.ID, "projection"), 1, GL_FALSE, &projection[0][0]);
+        glUniformMatrix4fv(glGetUniformLocation(uniforms_shader.ID, "model"), 1, GL_FALSE, &model[0][0]);
+
+        glBindVertexArray(vao_id);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+        glDrawArrays(GL_TRIANGLES, 0, 36);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindVertexArray(0);
+    };
+
+    enum draw_mode { DRAW_UNCACHED, DRAW_CACHED, DRAW_BATCH };
+
+    // CPU time of issuing the draws & of the whole frame including the GPU work (glFinish(), on llvmpipe the GPU is the CPU)
+    struct run_result { double cpu_ms; double frame_ms; };
+
+    auto run = [&](draw_mode mode) {
+        run_result result = { 0.0, 0.0 };
+        const uint32_t warmup_frames = 10;
+        for (uint32_t frame = 0; frame < warmup_frames + frames; ++frame)
+        {
+            const auto begin = clock::now();
+
+            if (mode == DRAW_UNCACHED)
+            {
+                for (const glm::mat4& model : models)
+                    draw_uncached(model);
+            }
+            else if (mode == DRAW_CACHED)
+            {
+                gl_update_per_view();
+                for (const glm::mat4& model : models)
+                    gl_draw_mesh(vao_id, 36, model, shader, texture_id);
+            }
+            else
+            {
+                gl_update_per_view();
+                for (const glm::mat4& model : models)
+                    gl_batch_draw(batch_mesh, model, 0);
+                gl_batch_submit();
+            }
+
+            const auto issued = clock::now();
+            glFinish();
+
+            if (frame >= warmup_frames)
+            {
+                result.cpu_ms += std::chrono::duration<double, std::milli>(issued - begin).count();
+                result.frame_ms += std::chrono::duration<double, std::milli>(clock::now() - begin).count();
+            }
+        }
+        result.cpu_ms /= frames;
+        result.frame_ms /= frames;
+        return result;
+    };
+
+    auto print = [&](const char* name, const run_result& r, const run_result& baseline) {
+        std::cout << "  " << name << ": cpu " << r.cpu_ms << " ms (" << r.cpu_ms * 1000000.0 / draws_per_frame << " ns per draw, "
+            << baseline.cpu_ms / r.cpu_ms << "x), frame " << r.frame_ms << " ms (" << baseline.frame_ms / r.frame_ms << "x)" << std::endl;
+    };
+
+    std::cout << "GL draw benchmark (" << draws_per_frame << " draws per frame, " << frames << " frames, "
+        << (const char*)glGetString(GL_RENDERER) << "):" << std::endl;
+
+    const run_result uncached = run(DRAW_UNCACHED);
+    print("uniform lookup + view/projection per draw", uncached, uncached);
+    print("cached uniform locations + per-frame UBO ", run(DRAW_CACHED), uncached);
+
+    if (gl_batch_enabled())
+    {
+        gl_batch_set_texture(0, texture_id);
+        print("one glMultiDrawArraysIndirect (gl-batch) ", run(DRAW_BATCH), uncached);
+    }
+
+    glDeleteProgram(uniforms_shader.ID);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
 void gl_draw_mesh(GLuint vao_id, GLuint num_vertices, const glm::mat4& mvp_matrix, const Shader& shader, GLuint texture_id)
 {
+    TRACE_ZONE("gl_draw_mesh");
+
+    // view & projection come from the per-view uniform buffer
     shader.use();
-    glm::mat4 view = camera.GetViewMatrix();
-    shader.setMat4("view", view);
-    shader.setMat4("projection", projection);
-    shader.setMat4("model", mvp_matrix);
+    shader.setMat4(gl_model_location, mvp_matrix);
 
     glBindVertexArray(vao_id);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, texture_id);
+    gl_timer_begin(GL_TIMER_DRAW);
     glDrawArrays(GL_TRIANGLES, 0, num_vertices);
+    gl_timer_end(GL_TIMER_DRAW);
     glBindTexture(GL_TEXTURE_2D, 0);
     glBindVertexArray(0);
 }
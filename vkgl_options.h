@@ -7,6 +7,77 @@ struct VkGlAppOptions
 
     const bool enable_msaa = true;
 
+    // resolve MSAA in the Vulkan render pass into single-sample interop textures, instead of in the GL blit to the window
+    const bool resolve_msaa = false;
+
+    // number of Vulkan submissions that may be in flight before the CPU waits for the GPU ('1' == wait after every submit)
+    const uint32_t frames_in_flight = 2;
+
+    // record the static Vulkan clear & cube command-buffers once at startup instead of every frame
+    const bool prerecord_cmd_bufs = false;
+
+    // record & submit the Vulkan work on a dedicated render thread, the main thread only queues the batches (see vk_render_settings::render_thread)
+    const bool vk_render_thread = false;
+
+    // copy the per-frame Vulkan instance data into device-local memory through a staging ring (when the VRAM isn't host-visible)
+    const bool vk_staging_uploads = true;
+
+    // threads that record large Vulkan draw lists in parallel (secondary command-buffers), 0 == one per hardware thread
+    const uint32_t vk_record_threads = 0;
+
+    // Vulkan device (index or name substring), nullptr == the one whose UUIDs match the GL context
+    const char* vk_device = nullptr;
+
+    // put all Vulkan work of a frame into one vk_begin_frame() / vk_end_frame() batch (one GL-VK handoff instead of one per call)
+    const bool batch_vk_frame = true;
+
+    // GL-VK handoff via timeline semaphores (falls back to binary semaphores if the driver lacks support)
+    const bool timeline_semaphores = true;
+
+    // sub-allocate the color & depth interop images from one exported Vulkan allocation (one fd / GL memory object for both)
+    const bool shared_interop_memory = true;
+
+    // interop color & depth sets (1 .. VK_MAX_INTEROP_SETS): with more than one, Vulkan renders frame N into set N % sets while
+    // GL renders its meshes into & presents frame N - 1 (one frame of latency, requires batched Vulkan frames)
+    const uint32_t interop_sets = 1;
+
+    // submit all GL meshes of a frame with one glMultiDrawArraysIndirect() instead of a draw call per mesh (see gl-batch.h)
+    const bool gl_batch = false;
+
+    // decode the textures on worker threads & upload them through a persistently mapped pixel-unpack ring,
+    // the meshes are drawn with a placeholder texture until then (see texture-loader.h)
+    const bool async_textures = false;
+
+    // directory of the pre-baked mip chains of the textures, written on the first run (nullptr == always decode the images)
+    const char* texture_cache_dir = "texture_cache";
+
+    // let the GL driver compress the cached mip chains into S3TC blocks (lossy, needs GL_EXT_texture_compression_s3tc)
+    const bool texture_cache_compress = false;
+
+    // directory of the linked GL program binaries, reused across app launches (nullptr == always compile the GLSL sources)
+    const char* shader_cache_dir = "shader_cache";
+
+    // Vulkan pipeline cache file, reused across app launches (nullptr == always compile the pipelines from scratch)
+    const char* pipeline_cache_file = "vk_pipeline_cache.bin";
+
+    // render into an offscreen EGL context (no window, no vsync, no input) and exit after 'headless_frames' frames
+    const bool headless = false;
+    const uint32_t headless_frames = 1000;
+
+    // > 0: benchmark mode, render this many frames along a scripted camera path and report per-phase timings as JSON
+    // (the vkgl-bench target is vkgl-test with benchmark mode enabled by default)
+#if VKGL_BENCH
+    const uint32_t bench_frames = 1000;
+#else
+    const uint32_t bench_frames = 0;
+#endif
+
+    // GL & Vulkan GPU timestamp queries per frame, averages are printed at shutdown (see frame-stats.h)
+    const bool gpu_timers = false;
+
+    // Chrome trace-event JSON file of the CPU timeline (scoped zones), written at shutdown (nullptr == tracing disabled)
+    const char* trace_file = nullptr;
+
     // NOTE: only enable this when running on systems where you have a Vulkan SDK installed !!!
     const bool ENABLE_VULKAN_VALIDATION_LAYER = false;
 };